@@ -0,0 +1,508 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "docset.h"
+#include "fixture.h"
+#include "bench_iter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Allocations are counted by interposing the glibc allocator, it
+ * doesn't work together with sanitizers, which have their own. */
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) \
+    && !defined(__SANITIZE_THREAD__)
+#define COUNT_ALLOCS 1
+#endif
+
+enum { NUM_LOOKUP_IDS = 500, NUM_BULK_IDS = 20000, TOP_K = 20 };
+
+#define RESULT_CACHE_SIZE (64UL * 1024 * 1024)
+#define ARENA_BLOCK_SIZE (1UL << 20)
+
+/* The document of the open_document cases, its anchor is at the end. */
+#define DOCUMENT_FILE "file0.html"
+#define DOCUMENT_ANCHOR "anchor49"
+#define DOCUMENT_PARAGRAPHS 40000
+
+typedef struct {
+    DocSetKind kind;
+    unsigned num_entries;
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *docset;
+    /* The same docset with the result cache enabled. */
+    DocSet *cached_docset;
+    /* Reset after every operation, like a per-request arena. */
+    DocSetArena *arena;
+    void *cpp_docset;
+    DocSetEntryId ids[NUM_BULK_IDS];
+} BenchContext;
+
+typedef struct {
+    const char *name;
+    /* Runs a single operation, returns the number of rows produced. */
+    size_t (*run)(BenchContext *ctx);
+} BenchCase;
+
+typedef struct {
+    unsigned long allocs;
+    unsigned long bytes;
+} AllocStats;
+
+static AllocStats alloc_stats;
+
+#ifdef COUNT_ALLOCS
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void __libc_free(void *);
+
+void *malloc(size_t n)
+{
+    alloc_stats.allocs++;
+    alloc_stats.bytes += n;
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    alloc_stats.allocs++;
+    alloc_stats.bytes += n * size;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t n)
+{
+    alloc_stats.allocs++;
+    alloc_stats.bytes += n;
+    return __libc_realloc(p, n);
+}
+
+void free(void *p)
+{
+    __libc_free(p);
+}
+#endif
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t n, double p)
+{
+    return sorted[(size_t)(p * (double)(n - 1) + 0.5)];
+}
+
+/* Traverses the cursor reading the entry names like a real client. */
+static size_t drain(DocSetCursor *cursor)
+{
+    size_t n = 0;
+
+    while (docset_cursor_step(cursor)) {
+        n += docset_entry_name(docset_cursor_entry(cursor)) != NULL;
+    }
+    docset_cursor_dispose(cursor);
+    return n;
+}
+
+static size_t bench_open(BenchContext *ctx)
+{
+    DocSet *docset;
+
+    if (docset_try_open(&docset, ctx->dir) != DOCSET_OK) {
+        return 0;
+    }
+    docset_close(docset);
+    return 1;
+}
+
+static size_t bench_open_immutable(BenchContext *ctx)
+{
+    DocSetOpenOptions options;
+    DocSet *docset;
+    size_t n;
+
+    docset_open_options_init(&options);
+    options.flags = DOCSET_OPEN_IMMUTABLE | DOCSET_OPEN_NO_MUTEX;
+    options.mmap_size = 256UL * 1024 * 1024;
+
+    if (docset_open_ex(&docset, ctx->dir, &options) != DOCSET_OK) {
+        return 0;
+    }
+    n = docset_count(docset);
+    docset_close(docset);
+    return n;
+}
+
+static size_t bench_count(BenchContext *ctx)
+{
+    return docset_count(ctx->docset);
+}
+
+static size_t bench_find_prefix(BenchContext *ctx)
+{
+    return drain(docset_find(ctx->docset, "print%"));
+}
+
+static size_t bench_find_suffix(BenchContext *ctx)
+{
+    return drain(docset_find(ctx->docset, "%Copy"));
+}
+
+static size_t bench_find_infix(BenchContext *ctx)
+{
+    return drain(docset_find(ctx->docset, "%Size%"));
+}
+
+static size_t bench_find_infix_cached(BenchContext *ctx)
+{
+    return drain(docset_find(ctx->cached_docset, "%Size%"));
+}
+
+static size_t bench_find_infix_arena(BenchContext *ctx)
+{
+    DocSetCursor *c = docset_find(ctx->cached_docset, "%Size%");
+    size_t n;
+
+    docset_cursor_materialize(c, ctx->arena);
+    n = drain(c);
+    docset_arena_reset(ctx->arena);
+    return n;
+}
+
+/* Reads the document and finds its anchor the way clients without
+ * docset_open_document() do. */
+static size_t bench_read_document(BenchContext *ctx)
+{
+    char path[FIXTURE_PATH_MAX + 64];
+    char *data = NULL;
+    size_t n = 0;
+    long size;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/Contents/Resources/Documents/%s",
+             ctx->dir, DOCUMENT_FILE);
+    if (!(f = fopen(path, "rb"))) {
+        return 0;
+    }
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0
+        && fseek(f, 0, SEEK_SET) == 0
+        && (data = (char *) malloc((size_t)size + 1))
+        && fread(data, 1, (size_t)size, f) == (size_t)size) {
+        data[size] = '\0';
+        n = strstr(data, "\"" DOCUMENT_ANCHOR "\"") != NULL;
+    }
+    fclose(f);
+    free(data);
+    return n;
+}
+
+static size_t bench_open_document(BenchContext *ctx)
+{
+    DocSetDocument doc;
+    size_t n;
+
+    if (docset_open_document_path(ctx->docset,
+                                  DOCUMENT_FILE "#" DOCUMENT_ANCHOR,
+                                  &doc) != DOCSET_OK) {
+        return 0;
+    }
+    n = doc.anchor_offset != DOCSET_NO_ANCHOR;
+    docset_close_document(&doc);
+    return n;
+}
+
+static size_t bench_find_typed(BenchContext *ctx)
+{
+    DocSetTypeMask types;
+
+    docset_type_mask_clear(&types);
+    docset_type_mask_add(&types, DOCSET_TYPE_FUNCTION);
+    docset_type_mask_add(&types, DOCSET_TYPE_MACRO);
+    return drain(docset_find_typed(ctx->docset, "%Size%", &types));
+}
+
+static size_t bench_list_entries(BenchContext *ctx)
+{
+    return drain(docset_list_entries(ctx->docset));
+}
+
+static size_t bench_find_by_ids(BenchContext *ctx)
+{
+    return drain(docset_find_by_ids(ctx->docset, ctx->ids, NUM_LOOKUP_IDS));
+}
+
+static size_t bench_find_by_ids_bulk(BenchContext *ctx)
+{
+    return drain(docset_find_by_ids(ctx->docset, ctx->ids, NUM_BULK_IDS));
+}
+
+static size_t bench_find_top(BenchContext *ctx)
+{
+    return drain(docset_find_top(ctx->docset, "%print%", TOP_K));
+}
+
+static size_t bench_fuzzy_find(BenchContext *ctx)
+{
+    return drain(docset_fuzzy_find(ctx->docset, "vecpb", TOP_K));
+}
+
+/* Patterns of a user typing "print" into a search box. */
+static const char *KEYSTROKES[] = { "p%", "pr%", "pri%", "prin%", "print%" };
+
+static size_t bench_type_ahead_find(BenchContext *ctx)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < ARRAY_SIZE(KEYSTROKES); ++i) {
+        n += drain(docset_find(ctx->docset, KEYSTROKES[i]));
+    }
+    return n;
+}
+
+static size_t bench_type_ahead_session(BenchContext *ctx)
+{
+    DocSetSearchSession *session;
+    size_t i, n = 0;
+
+    if (docset_session_create(&session, ctx->docset) != DOCSET_OK) {
+        return 0;
+    }
+    for (i = 0; i < ARRAY_SIZE(KEYSTROKES); ++i) {
+        n += drain(docset_session_find(session, KEYSTROKES[i]));
+    }
+    docset_session_close(session);
+    return n;
+}
+
+static size_t bench_cpp_find_infix(BenchContext *ctx)
+{
+    return bench_cpp_find(ctx->cpp_docset, "%Size%");
+}
+
+static size_t bench_cpp_list_entries(BenchContext *ctx)
+{
+    return bench_cpp_find(ctx->cpp_docset, "%");
+}
+
+static size_t bench_cpp_list_views(BenchContext *ctx)
+{
+    return bench_cpp_find_views(ctx->cpp_docset, "%");
+}
+
+static const BenchCase CASES[] = {
+    { "open", bench_open },
+    { "open_immutable", bench_open_immutable },
+    { "count", bench_count },
+    { "find_prefix", bench_find_prefix },
+    { "find_suffix", bench_find_suffix },
+    { "find_infix", bench_find_infix },
+    { "find_infix_cached", bench_find_infix_cached },
+    { "find_infix_arena", bench_find_infix_arena },
+    { "read_document", bench_read_document },
+    { "open_document", bench_open_document },
+    { "find_typed", bench_find_typed },
+    { "list_entries", bench_list_entries },
+    { "find_by_ids", bench_find_by_ids },
+    { "find_by_ids_bulk", bench_find_by_ids_bulk },
+    { "find_top", bench_find_top },
+    { "fuzzy_find", bench_fuzzy_find },
+    { "type_ahead_find", bench_type_ahead_find },
+    { "type_ahead_session", bench_type_ahead_session },
+    { "cpp_find_infix", bench_cpp_find_infix },
+    { "cpp_list_entries", bench_cpp_list_entries },
+    { "cpp_list_views", bench_cpp_list_views }
+};
+
+static void run_case(BenchContext *ctx, const BenchCase *bc,
+                     unsigned iterations, double *latencies, int first)
+{
+    AllocStats before;
+    double start, total = 0;
+    size_t rows = 0;
+    unsigned i;
+
+    /* Warm up caches, lazy indexes and prepared statements. */
+    bc->run(ctx);
+
+    before = alloc_stats;
+    for (i = 0; i < iterations; ++i) {
+        start = now();
+        rows += bc->run(ctx);
+        latencies[i] = now() - start;
+        total += latencies[i];
+    }
+
+    qsort(latencies, iterations, sizeof(*latencies), compare_doubles);
+
+    printf("%s    {\"kind\": \"%s\", \"entries\": %u, \"name\": \"%s\", "
+           "\"iterations\": %u, \"ops_per_sec\": %.1f, "
+           "\"p50_us\": %.1f, \"p99_us\": %.1f, \"rows_per_op\": %.1f, ",
+           first ? "" : ",\n",
+           docset_kind_name(ctx->kind), ctx->num_entries, bc->name,
+           iterations, total > 0 ? iterations / total : 0.0,
+           percentile(latencies, iterations, 0.5) * 1e6,
+           percentile(latencies, iterations, 0.99) * 1e6,
+           (double)rows / iterations);
+#ifdef COUNT_ALLOCS
+    printf("\"allocs_per_op\": %.1f, \"alloc_bytes_per_op\": %.1f}",
+           (double)(alloc_stats.allocs - before.allocs) / iterations,
+           (double)(alloc_stats.bytes - before.bytes) / iterations);
+#else
+    (void)before;
+    printf("\"allocs_per_op\": null, \"alloc_bytes_per_op\": null}");
+#endif
+}
+
+/* Writes a large document with the anchor at its end. */
+static int write_document(const char *dir)
+{
+    char path[FIXTURE_PATH_MAX + 64];
+    unsigned i;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/Contents/Resources/Documents/%s",
+             dir, DOCUMENT_FILE);
+    if (!(f = fopen(path, "w"))) {
+        return 0;
+    }
+    fprintf(f, "<html><body>\n");
+    for (i = 0; i < DOCUMENT_PARAGRAPHS; ++i) {
+        fprintf(f, "<p id=\"p%u\">Lorem ipsum dolor sit amet, "
+                "<a href=\"#p%u\">see also</a>.</p>\n", i, i / 2);
+    }
+    fprintf(f, "<a name=\"%s\"></a>\n</body></html>\n", DOCUMENT_ANCHOR);
+    return fclose(f) == 0;
+}
+
+static int run_kind(DocSetKind kind, unsigned num_entries,
+                    unsigned iterations, int name_index, int flat,
+                    int *first)
+{
+    BenchContext ctx;
+    double *latencies;
+    unsigned long seed = 12345;
+    size_t i;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.kind = kind;
+    ctx.num_entries = num_entries;
+
+    /* The ids are pseudo-random but the same for every run. */
+    for (i = 0; i < NUM_BULK_IDS; ++i) {
+        seed = (seed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+        ctx.ids[i] = (DocSetEntryId)(seed % num_entries) + 1;
+    }
+
+    fprintf(stderr, "Generating %s docset with %u entries\n",
+            docset_kind_name(kind), num_entries);
+    if (!fixture_create(kind, num_entries, ctx.dir)
+        || !write_document(ctx.dir)) {
+        fprintf(stderr, "Can't create the docset\n");
+        return 0;
+    }
+
+    latencies = (double *) malloc(iterations * sizeof(*latencies));
+    ctx.docset = docset_open(ctx.dir);
+    ctx.cached_docset = docset_open(ctx.dir);
+    ctx.arena = docset_arena_create(ARENA_BLOCK_SIZE);
+    ctx.cpp_docset = bench_cpp_open(ctx.dir);
+
+    if (latencies && ctx.docset && ctx.cached_docset && ctx.arena
+        && ctx.cpp_docset) {
+        docset_set_name_index(ctx.docset, name_index);
+        docset_set_result_cache(ctx.cached_docset, RESULT_CACHE_SIZE);
+        if (flat && docset_flatten(ctx.docset) != DOCSET_OK) {
+            fprintf(stderr, "Can't flatten the docset\n");
+        }
+        for (i = 0; i < ARRAY_SIZE(CASES); ++i) {
+            fprintf(stderr, "  %s\n", CASES[i].name);
+            run_case(&ctx, CASES + i, iterations, latencies, *first);
+            *first = 0;
+        }
+    }
+
+    if (ctx.cpp_docset) {
+        bench_cpp_close(ctx.cpp_docset);
+    }
+    docset_close(ctx.docset);
+    docset_close(ctx.cached_docset);
+    docset_arena_destroy(ctx.arena);
+    free(latencies);
+    fixture_remove(ctx.dir);
+    return latencies && ctx.docset && ctx.cached_docset && ctx.arena
+           && ctx.cpp_docset;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n ENTRIES] [-i ITERATIONS] [-k dash|zdash|all] "
+            "[-x] [-f]\n"
+            "  -n  number of entries in generated docsets (100000)\n"
+            "  -i  number of timed iterations of every benchmark (20)\n"
+            "  -k  docset kinds to benchmark (all)\n"
+            "  -x  enable the in-memory name index\n"
+            "  -f  flatten ZDASH docsets in memory\n"
+            "Results are printed to stdout as JSON.\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned num_entries = 100000;
+    unsigned iterations = 20;
+    int dash = 1, zdash = 1;
+    int name_index = 0;
+    int flat = 0;
+    int first = 1;
+    int ok = 1;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            num_entries = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            iterations = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            ++i;
+            dash = strcmp(argv[i], "zdash") != 0;
+            zdash = strcmp(argv[i], "dash") != 0;
+        } else if (strcmp(argv[i], "-x") == 0) {
+            name_index = 1;
+        } else if (strcmp(argv[i], "-f") == 0) {
+            flat = 1;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (num_entries == 0 || iterations == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("{\"benchmark\": \"libdocset\", \"name_index\": %s, "
+           "\"flat\": %s, \"results\": [\n",
+           name_index ? "true" : "false", flat ? "true" : "false");
+    ok = (!dash || run_kind(DOCSET_KIND_DASH, num_entries, iterations,
+                            name_index, flat, &first))
+         && (!zdash || run_kind(DOCSET_KIND_ZDASH, num_entries, iterations,
+                                name_index, flat, &first));
+    printf("\n]}\n");
+
+    return !ok;
+}
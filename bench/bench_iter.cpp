@@ -0,0 +1,39 @@
+#include "bench_iter.h"
+
+#include <docset.hpp>
+
+void *bench_cpp_open(const char *dir)
+{
+    try {
+        return new docset::doc_set(dir);
+    } catch (const docset::error &) {
+        return nullptr;
+    }
+}
+
+size_t bench_cpp_find(void *handle, const char *pattern)
+{
+    const docset::doc_set &ds = *static_cast<docset::doc_set *>(handle);
+    size_t n = 0;
+
+    for (const auto &e : ds.find(pattern)) {
+        n += !e.name().empty();
+    }
+    return n;
+}
+
+size_t bench_cpp_find_views(void *handle, const char *pattern)
+{
+    const docset::doc_set &ds = *static_cast<docset::doc_set *>(handle);
+    size_t n = 0;
+
+    for (const auto &e : ds.find(pattern).views()) {
+        n += !e.name().empty();
+    }
+    return n;
+}
+
+void bench_cpp_close(void *handle)
+{
+    delete static_cast<docset::doc_set *>(handle);
+}
@@ -0,0 +1,51 @@
+/**
+ * @file
+ *
+ * This file provides benchmarks of the C++ bindings callable from the
+ * C benchmark driver.
+ */
+#ifndef DOCSET_BENCH_ITER_H
+#define DOCSET_BENCH_ITER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opens the docset in @p dir using the C++ bindings.
+ * @return opaque handle or NULL on error.
+ */
+void *
+bench_cpp_open(const char *dir);
+
+/**
+ * @brief Traverses entries matching the @p pattern with the C++
+ * iterators.
+ * @return number of entries traversed.
+ */
+size_t
+bench_cpp_find(void       *handle,
+               const char *pattern);
+
+/**
+ * @brief Traverses entries matching the @p pattern with the C++ entry
+ * views.
+ * @return number of entries traversed.
+ */
+size_t
+bench_cpp_find_views(void       *handle,
+                     const char *pattern);
+
+/**
+ * @brief Closes the handle returned by bench_cpp_open().
+ */
+void
+bench_cpp_close(void *handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,7 +5,7 @@
 
 static void usage(const char *progname)
 {
-    fprintf(stderr, "%s: QUERY DOCSET_PATH\n", progname);
+    fprintf(stderr, "%s: QUERY DOCSET_PATH...\n", progname);
 }
 
 static void print_error(void *ctx, const char *msg)
@@ -15,12 +15,13 @@ static void print_error(void *ctx, const char *msg)
 
 int main(int argc, const char *argv[])
 {
-    DocSet       *docset;
-    DocSetCursor *cursor;
-    DocSetEntry  *entry;
-    const char   *query;
-    const char  **path;
-    const char  **end;
+    DocSetLibrary *library;
+    DocSetCursor  *cursor;
+    DocSetEntry   *entry;
+    DocSetError    err;
+    const char    *query;
+    const char   **path;
+    const char   **end;
 
     if (argc < 3) {
         usage(argv[0]);
@@ -29,42 +30,47 @@ int main(int argc, const char *argv[])
 
     query = argv[1];
 
+    if ((err = docset_library_create(&library, 0)) != DOCSET_OK) {
+        fprintf(stderr, "%s\n", docset_error_string(err));
+        return 1;
+    }
+
     for (path = argv + 2, end = argv + argc;
          path != end;
          ++path) {
 
-        docset = docset_open(*path);
-        if (!docset) {
+        if ((err = docset_library_add(library, *path)) != DOCSET_OK) {
             fprintf(stderr,
-                    "Unable to create a docset %s\n",
-                    *path);
+                    "Unable to create a docset %s: %s\n",
+                    *path, docset_error_string(err));
             continue;
         }
 
-        docset_set_error_handler(docset, print_error, (void*)*path);
-
-        cursor = docset_find(docset, query);
-        if (!cursor) {
-            fprintf(stderr,
-                    "%s: Unable to create a cursor\n",
-                    *path);
-            docset_close(docset);
-            continue;
-        }
+        docset_set_error_handler(
+            docset_library_docset(library, docset_library_size(library) - 1),
+            print_error,
+            (void*)*path);
+    }
 
-        while (docset_cursor_step(cursor)) {
-            entry = docset_cursor_entry(cursor);
-            printf("%10s: (%c) %-25s: %s\n",
-                   docset_name(docset),
-                   docset_entry_canonical_type(entry)[0],
-                   docset_entry_name(entry),
-                   docset_entry_path(entry)
-                   );
-        }
+    cursor = docset_library_find(library, query, DOCSET_ORDER_BY_RANK);
+    if (!cursor) {
+        fprintf(stderr, "Unable to create a cursor\n");
+        docset_library_close(library);
+        return 1;
+    }
 
-        docset_cursor_dispose(cursor);
-        docset_close(docset);
+    while (docset_cursor_step(cursor)) {
+        entry = docset_cursor_entry(cursor);
+        printf("%10s: (%c) %-25s: %s\n",
+               docset_name(docset_cursor_docset(cursor)),
+               docset_entry_canonical_type(entry)[0],
+               docset_entry_name(entry),
+               docset_entry_path(entry)
+               );
     }
 
+    docset_cursor_dispose(cursor);
+    docset_library_close(library);
+
     return 0;
 }
@@ -28,8 +28,7 @@ int main(int argc, const char *argv[])
                           << "(" << e.canonical_type_name()[0] << ") "
                           << std::left << std::setw(25) << e.name()
                           << ": "
-                          << "file://" << ds.basedir()
-                          << "/Contents/Resources/Documents/" << e.path()
+                          << "file://" << ds.documents_path() << e.path()
                           << "\n";
             }
         } catch (const docset::error &e) {
@@ -0,0 +1,87 @@
+#include "docset.h"
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void *default_allocate(void *context, size_t size);
+
+static void *default_reallocate(void *context, void *ptr, size_t size);
+
+static void default_deallocate(void *context, void *ptr);
+
+static const DocSetAllocator DEFAULT_ALLOCATOR = {
+    default_allocate,
+    default_reallocate,
+    default_deallocate,
+    NULL
+};
+
+static DocSetAllocator allocator = {
+    default_allocate,
+    default_reallocate,
+    default_deallocate,
+    NULL
+};
+
+static void *default_allocate(void *context, size_t size)
+{
+    (void)context;
+    return malloc(size);
+}
+
+static void *default_reallocate(void *context, void *ptr, size_t size)
+{
+    (void)context;
+    return realloc(ptr, size);
+}
+
+static void default_deallocate(void *context, void *ptr)
+{
+    (void)context;
+    free(ptr);
+}
+
+DocSetError docset_set_allocator(const DocSetAllocator *alloc)
+{
+    if (!alloc) {
+        allocator = DEFAULT_ALLOCATOR;
+        return DOCSET_OK;
+    }
+    if (!alloc->allocate || !alloc->reallocate || !alloc->deallocate) {
+        return DOCSET_BAD_CALL;
+    }
+    allocator = *alloc;
+    return DOCSET_OK;
+}
+
+void *docset_malloc(size_t size)
+{
+    return allocator.allocate(allocator.context, size);
+}
+
+void *docset_calloc(size_t n, size_t size)
+{
+    void *p;
+
+    if (size && n > (size_t)-1 / size) {
+        return NULL;
+    }
+    p = allocator.allocate(allocator.context, n * size);
+    if (p) {
+        memset(p, 0, n * size);
+    }
+    return p;
+}
+
+void *docset_realloc(void *ptr, size_t size)
+{
+    return allocator.reallocate(allocator.context, ptr, size);
+}
+
+void docset_free(void *ptr)
+{
+    if (ptr) {
+        allocator.deallocate(allocator.context, ptr);
+    }
+}
@@ -0,0 +1,43 @@
+/**
+ * @file
+ *
+ * This file provides the allocation functions all the library memory
+ * comes from, see docset_set_allocator().
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_ALLOC_H
+#define DOCSET_ALLOC_H
+
+#include <stddef.h>
+
+/**
+ * @brief Allocates @p size bytes with the current allocator.
+ */
+void *
+docset_malloc(size_t size);
+
+/**
+ * @brief Allocates zero-filled memory for @p n objects of @p size bytes.
+ */
+void *
+docset_calloc(size_t n,
+              size_t size);
+
+/**
+ * @brief Resizes memory allocated with docset_malloc() or
+ * docset_calloc(), the @p ptr is allowed to be NULL.
+ */
+void *
+docset_realloc(void  *ptr,
+               size_t size);
+
+/**
+ * @brief Frees memory allocated with the functions above, the @p ptr
+ * is allowed to be NULL.
+ */
+void
+docset_free(void *ptr);
+
+#endif
@@ -0,0 +1,135 @@
+#include "docset.h"
+#include "alloc.h"
+
+#define ARENA_BLOCK_SIZE 65536
+
+/* Allocations are aligned to the strictest alignment of these. */
+typedef union {
+    void *p;
+    void (*f)(void);
+    long l;
+    double d;
+    long double ld;
+} MaxAlign;
+
+/* The size of the union is a multiple of its alignment, but not
+ * necessarily a power of two, e.g. 12 with an x87 long double. */
+#define ALIGN(n) \
+    (((n) + sizeof(MaxAlign) - 1) / sizeof(MaxAlign) * sizeof(MaxAlign))
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+/* Data of a block follows its header. */
+#define BLOCK_HEADER ALIGN(sizeof(ArenaBlock))
+
+struct DocSetArena
+{
+    /* The first block serves the allocations, the others are full or
+     * hold a single large allocation. */
+    ArenaBlock *blocks;
+    size_t block_size;
+};
+
+static ArenaBlock *new_block(size_t size);
+
+static ArenaBlock *new_block(size_t size)
+{
+    ArenaBlock *block = (ArenaBlock *) docset_malloc(BLOCK_HEADER + size);
+
+    if (block) {
+        block->next = NULL;
+        block->size = size;
+        block->used = 0;
+    }
+    return block;
+}
+
+DocSetArena *docset_arena_create(size_t block_size)
+{
+    DocSetArena *arena = (DocSetArena *) docset_malloc(sizeof(*arena));
+
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->blocks = NULL;
+    arena->block_size = block_size ? ALIGN(block_size) : ARENA_BLOCK_SIZE;
+    return arena;
+}
+
+void *docset_arena_alloc(DocSetArena *arena, size_t size)
+{
+    ArenaBlock *block;
+    void *p;
+
+    if (!arena) {
+        return NULL;
+    }
+    if (size > (size_t)-1 - BLOCK_HEADER - sizeof(MaxAlign)) {
+        return NULL;
+    }
+    size = ALIGN(size ? size : 1);
+    block = arena->blocks;
+
+    if (!block || block->size - block->used < size) {
+        /* Large allocations get blocks of their own, so that the
+         * current block keeps serving the small ones. */
+        if (block && size > arena->block_size / 4) {
+            if (!(block = new_block(size))) {
+                return NULL;
+            }
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        } else {
+            block = new_block(size > arena->block_size
+                              ? size : arena->block_size);
+            if (!block) {
+                return NULL;
+            }
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+
+    p = (char *)block + BLOCK_HEADER + block->used;
+    block->used += size;
+    return p;
+}
+
+void docset_arena_reset(DocSetArena *arena)
+{
+    ArenaBlock *block, *next;
+    ArenaBlock *kept = NULL;
+
+    if (!arena) {
+        return;
+    }
+
+    for (block = arena->blocks; block; block = next) {
+        next = block->next;
+        if (!kept && block->size == arena->block_size) {
+            kept = block;
+            kept->next = NULL;
+            kept->used = 0;
+        } else {
+            docset_free(block);
+        }
+    }
+    arena->blocks = kept;
+}
+
+void docset_arena_destroy(DocSetArena *arena)
+{
+    if (!arena) {
+        return;
+    }
+
+    docset_arena_reset(arena);
+    docset_free(arena->blocks);
+    docset_free(arena);
+}
@@ -0,0 +1,15 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "clock.h"
+
+#include <time.h>
+
+double docset_clock_now(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0.0;
+    }
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
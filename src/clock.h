@@ -0,0 +1,19 @@
+/**
+ * @file
+ *
+ * This file provides a monotonic clock used to collect docset
+ * statistics.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_CLOCK_H
+#define DOCSET_CLOCK_H
+
+/**
+ * @brief Returns current time of a monotonic clock in seconds.
+ */
+double
+docset_clock_now(void);
+
+#endif
@@ -1,6 +1,21 @@
 #include "docset.h"
+#include "alloc.h"
 #include "stringbuf.h"
 #include "prop_parser.h"
+#include "name_index.h"
+#include "index_file.h"
+#include "flat_db.h"
+#include "type_names.h"
+#include "type_dict.h"
+#include "rowset.h"
+#include "result_cache.h"
+#include "mapping_cache.h"
+#include "document.h"
+#include "fuzzy.h"
+#include "topk.h"
+#include "rank.h"
+#include "clock.h"
+#include "mutex.h"
 #include "paths.h"
 
 #include <sqlite3.h>
@@ -8,23 +23,29 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define DASH_BASE_QUERY                                             \
-    "select id, name, type, null as parent, path from searchIndex"
+#define BUF_INIT_SIZE 100
 
-#define ZDASH_BASE_QUERY                                                \
-    "select t.z_pk as id"                                               \
-    ", t.ztokenname as name"                                            \
-    ", tt.ztypename as type"                                            \
-    ", null as parent"                                                  \
-    ", coalesce(tf.zpath || '#' || tm.zanchor, tf.zpath) as path "      \
-    "from ztoken t "                                                    \
-    "join ztokentype tt on (t.ztokentype=tt.z_pk) "                     \
-    "join ztokenmetainformation tm on (t.zmetainformation=tm.z_pk) "    \
-    "join zfilepath tf on (tm.zfile=tf.z_pk)"
+#define STMT_CACHE_SIZE 16
 
-#define COLUMN_ORDERING " order by id"
+/* Bulk id lookups bind ids in chunks, chunk sizes are powers of two in
+ * this range, so few statements serve any number of ids. */
+#define IDS_MIN_CHUNK 8
+#define IDS_MAX_CHUNK 512
 
-#define BUF_INIT_SIZE 100
+#define BATCH_INIT_SIZE 256
+#define BATCH_STRINGS_INIT_SIZE 4096
+
+#define RESULT_KEY_INIT_SIZE 64
+
+#define DOCUMENT_CACHE_SIZE 16
+
+/* Statement cache key: the query shape, the set of fetched columns and
+ * the number of parameters for queries with variable number of them. */
+#define QUERY_KEY(shape, columns, n) \
+    ((unsigned)(shape) | ((unsigned)(columns) << 4) | ((unsigned)(n) << 8))
+
+/* Public column flag corresponding to a column index. */
+#define COLUMN_FLAG(col) (1u << ((col) - 1))
 
 #define PLIST_FILE_NAME "Info.plist"
 #define DB_FILE_NAME "docSet.dsidx"
@@ -33,55 +54,196 @@
 
 static const char INDEX_FILE_PATH[] = "/Contents/Resources/" DB_FILE_NAME;
 static const char INFO_PLIST_PATH[] = "/Contents/" PLIST_FILE_NAME;
+static const char DOCUMENTS_PATH[] = "/Contents/Resources/Documents/";
 
 static const char *KIND_NAMES[] = { "DASH", "ZDASH" };
 
 static const char TABLE_COUNT_QUERY[] = "select count(*) from sqlite_master "
                                         "where type='table' and name=?";
 
+typedef enum {
+    QUERY_ALL,
+    QUERY_NAME_LIKE,
+    QUERY_COUNT,
+    QUERY_BY_ID,
+    QUERY_BY_IDS,
+    /* Variants of the shapes above restricted to entries of the given
+     * native type names, the number of names is the number of extra
+     * parameters. */
+    QUERY_NAME_LIKE_TYPED,
+    QUERY_BY_ID_TYPED
+} QueryShape;
+
+typedef enum {
+    COL_ID,
+    COL_NAME,
+    COL_TYPE,
+    COL_PARENT,
+    COL_PATH,
+    NUM_COLUMNS
+} ColumnIndex;
+
+/* Entry queries are assembled from the pieces below, so that columns
+ * the client doesn't need are neither computed nor joined. */
 typedef struct QueryTable
 {
-    const char *all_query;
-    const char *name_like_query;
     const char *count_query;
-    const char *query_base;
+    const char *names_query;
+    const char *from;
+    /* Expression computing the column. */
+    const char *columns[NUM_COLUMNS];
+    /* Join required to compute the column. */
+    const char *joins[NUM_COLUMNS];
+    /* Condition that replaces the join if the column is not fetched,
+     * so that the set of entries doesn't depend on the columns. */
+    const char *filters[NUM_COLUMNS];
+    /* Condition on the native type name, the list of parameters goes
+     * between the two parts. */
+    const char *type_filter[2];
 } QueryTable;
 
 static QueryTable dash_query_table =
 {
-    DASH_BASE_QUERY COLUMN_ORDERING,
-    DASH_BASE_QUERY " where name like ? " COLUMN_ORDERING,
     "select count(*) from searchIndex",
-    DASH_BASE_QUERY
+    "select id, name from searchIndex",
+    "searchIndex",
+    { "id", "name", "type", "null", "path" },
+    { NULL, NULL, NULL, NULL, NULL },
+    { NULL, NULL, NULL, NULL, NULL },
+    { "type in (", ")" }
 };
 
 static QueryTable zdash_query_table =
 {
-    ZDASH_BASE_QUERY COLUMN_ORDERING,
-    ZDASH_BASE_QUERY " where name like ? " COLUMN_ORDERING,
     "select count(*) from ztoken",
-    ZDASH_BASE_QUERY
+    "select z_pk, ztokenname from ztoken",
+    "ztoken t",
+    {
+        "t.z_pk",
+        "t.ztokenname",
+        "tt.ztypename",
+        "null",
+        "coalesce(tf.zpath || '#' || tm.zanchor, tf.zpath)"
+    },
+    {
+        NULL,
+        NULL,
+        " join ztokentype tt on (t.ztokentype=tt.z_pk)",
+        NULL,
+        " join ztokenmetainformation tm on (t.zmetainformation=tm.z_pk)"
+        " join zfilepath tf on (tm.zfile=tf.z_pk)"
+    },
+    {
+        NULL,
+        NULL,
+        "t.ztokentype is not null",
+        NULL,
+        "t.zmetainformation is not null"
+    },
+    {
+        "t.ztokentype in (select z_pk from ztokentype where ztypename in (",
+        "))"
+    }
 };
 
-struct DocSet
+/* Entries of a flattened ZDASH docset, see docset_flatten(). */
+static QueryTable flat_query_table =
+{
+    "select count(*) from " DOCSET_FLAT_TABLE,
+    "select id, name from " DOCSET_FLAT_TABLE,
+    DOCSET_FLAT_TABLE,
+    { "id", "name", "type", "parent", "path" },
+    { NULL, NULL, NULL, NULL, NULL },
+    { NULL, NULL, NULL, NULL, NULL },
+    { "type in (", ")" }
+};
+
+typedef struct CachedStmt
+{
+    unsigned key;
+    sqlite3_stmt *stmt;
+    unsigned long last_use;
+} CachedStmt;
+
+/* A database connection with its idle prepared statements, statements
+ * used by live cursors are not in the cache. */
+typedef struct DocSetConn
 {
     sqlite3 *db;
+    CachedStmt stmt_cache[STMT_CACHE_SIZE];
+    size_t num_cached;
+    unsigned long stmt_clock;
+
+    /* Counters of the queries executed on the connection. */
+    DocSetStats stats;
+
+    /* Types of the native type names met by the connection cursors. */
+    DocSetTypeDict types;
+
+    /* Next idle connection of a concurrent docset. */
+    struct DocSetConn *next;
+} DocSetConn;
+
+struct DocSet
+{
+    DocSetConn conn;
     QueryTable *query_table;
     DocSetFlags flags;
 
     char *bundle_id;
     char *name;
     char *platform_family;
+    char *db_path;
+    char *docs_path;
+
+    /* Index file path, see docset_set_cache_dir(). */
+    char *index_file;
+
+    /* Flat database file path, see docset_flatten(). Connections of a
+     * docset flattened to a file open flat_path instead of db_path. */
+    char *flat_file;
+    char *flat_path;
 
     docset_err_handler err_handler;
     void *err_context;
+
+    DocSetOpenOptions options;
+
+    DocSetStats stats;
+    int step_timing;
+
+    unsigned char type_weights[DOCSET_TYPE_LAST + 1];
+    int has_type_weights;
+
+    int use_name_index;
+    int name_index_failed;
+    DocSetNameIndex *name_index;
+
+    /* Disposed cursor kept to reuse its entry buffers. */
+    DocSetCursor *spare_cursor;
+
+    /* Cached query results, see docset_set_result_cache(). */
+    DocSetResultCache *results;
+
+    /* Mappings of documents, created on the first docset_open_document()
+     * call, see docset_set_document_cache(). */
+    DocSetMappingCache *documents;
+    size_t max_documents;
+
+    /* Concurrent docsets only: the lock guards the lazily initialized
+     * fields, the error handler, the statistics and the pool of idle
+     * connections. */
+    DocSetMutex *lock;
+    DocSetConn *idle_conns;
 };
 
 struct DocSetEntry
 {
+    unsigned columns;
     DocSetEntryId id;
     DocSetStringBuf name;
     DocSetStringBuf type;
+    DocSetEntryType type_id;
     DocSetStringBuf parent;
     DocSetStringBuf path;
 };
@@ -89,22 +251,109 @@ struct DocSetEntry
 struct DocSetCursor
 {
     DocSet *docset;
+    DocSetConn *conn;
     DocSetEntry entry;
     sqlite3_stmt *stmt;
+    unsigned stmt_key;
+    unsigned columns;
+
+    /* Set once the statement is done, SQLite would restart it on the
+     * next step. */
+    int finished;
+    /* Set once the statement fails or entries can't be copied, see
+     * docset_cursor_failed(). */
+    int failed;
+
+    /* If by_ids is set, the statement is a lookup by id that is
+     * re-executed for every id in the ids vector. If chunk_size is not
+     * zero, the statement looks up chunk_size ids at once. */
+    int by_ids;
+    DocSetEntryId *ids;
+    size_t num_ids;
+    size_t next_id;
+    size_t chunk_size;
+    int chunk_active;
+
+    /* If has_types is set, only entries of the types are returned, see
+     * docset_find_typed(). */
+    int has_types;
+    DocSetTypeMask types;
+
+    /* If rows is not NULL, the cursor traverses a materialized result
+     * set instead of executing a statement. If rows_in_arena is set,
+     * the rows are owned by an arena, see docset_cursor_materialize().
+     * If shared_rows is set, the rows are its rows and the cursor holds
+     * a reference to them. If cached_query is set, the rows answer a
+     * query of the result cache and rebinding looks the new pattern up
+     * in the cache. */
+    DocSetRows *rows;
+    int rows_in_arena;
+    DocSetSharedRows *shared_rows;
+    int cached_query;
+    DocSet **sources;
+    size_t next_row;
 };
 
+/* Query answered by the result cache, see docset_set_result_cache(). */
+typedef struct
+{
+    const char *pattern;
+    unsigned columns;
+    /* NULL if entries of all types match. */
+    const DocSetTypeMask *types;
+    /* If top is set, the query is docset_find_top(pattern, k). */
+    int top;
+    size_t k;
+} CachedQuery;
+
 static int init_entry(DocSetEntry *e);
 
 static int file_exists(const char *);
 
-static void assign_buffer_col(DocSetStringBuf *buf,
+static int step_stmt(DocSetCursor *cursor);
+
+static void assign_buffer_col(DocSetStats *stats,
+                              DocSetStringBuf *buf,
                               sqlite3_stmt *stmt,
                               int col);
 
+static void assign_row(DocSetEntry *e, const DocSetRows *rows, size_t i);
+
+static const char *cursor_column(DocSetCursor *cursor, int col, size_t *len);
+
+static DocSetEntryType cursor_type(DocSetCursor *cursor,
+                                   const char *type_name,
+                                   size_t len);
+
+static int batch_reserve(DocSetBatch *batch, size_t n);
+
+static int batch_append(DocSetBatch *batch,
+                        const char  *s,
+                        size_t       len,
+                        size_t      *offset);
+
 static int parse_props(DocSet *docset, const char *path);
 
 static int set_query_table(DocSet *);
 
+static int connect_db(DocSet *docset);
+
+static int open_db(DocSet *docset, DocSetConn *conn);
+
+static int close_conn(DocSetConn *conn);
+
+static int close_all_conns(DocSet *docset);
+
+static DocSetConn *take_conn(DocSet *docset);
+
+static void give_conn(DocSet *docset, DocSetConn *conn);
+
+static void add_stats(DocSetStats *sum, const DocSetStats *stats);
+
+static char *file_uri(const char *path, const char *query);
+
+static int ensure_db(DocSet *docset);
+
 static void report_error(DocSet *docset, const char *message);
 
 static void report_no_mem(DocSet *docset);
@@ -113,9 +362,94 @@ static int count_tables(sqlite3 *db, const char *table);
 
 static void dispose_entry(DocSetEntry *entry);
 
+static DocSetCursor *new_cursor(DocSet *docset);
+
+static DocSetCursor *reuse_cursor(DocSet *docset);
+
+static DocSetCursor *adopt_rows(DocSet *docset, DocSetSharedRows *rows);
+
+static void release_rows(DocSetCursor *cursor);
+
+static void free_cursor(DocSetCursor *cursor);
+
 static DocSetCursor *cursor_for_query(DocSet *docset,
-                                      const char *query,
-                                      int len);
+                                      QueryShape shape,
+                                      unsigned columns);
+
+static int cursor_set_query(DocSetCursor *cursor,
+                            QueryShape shape,
+                            unsigned num_params);
+
+static int cursor_set_pattern(DocSetCursor *cursor, const char *pattern);
+
+static int cursor_set_typed_query(DocSetCursor *cursor,
+                                  QueryShape shape,
+                                  QueryShape typed_shape);
+
+static int cursor_set_index(DocSetCursor *cursor, const char *pattern);
+
+static int cursor_set_ids(DocSetCursor *cursor,
+                          const DocSetEntryId *ids,
+                          size_t num_ids);
+
+static int compare_ids(const void *a, const void *b);
+
+static int step_chunks(DocSetCursor *cursor);
+
+static int cursor_set_topk(DocSetCursor *cursor, DocSetTopK *topk);
+
+static DocSetCursor *find_pattern(DocSet               *docset,
+                                  const char           *pattern,
+                                  unsigned              columns,
+                                  const DocSetTypeMask *types);
+
+static DocSetCursor *find_top(DocSet *docset, const char *pattern, size_t k);
+
+static DocSetCursor *run_query(DocSet *docset, const CachedQuery *query);
+
+static int result_key(DocSetStringBuf *key, const CachedQuery *query);
+
+static DocSetSharedRows *cached_rows(DocSet            *docset,
+                                     const CachedQuery *query);
+
+static DocSetCursor *find_cached(DocSet *docset, const CachedQuery *query);
+
+static int cursor_set_cached(DocSetCursor *cursor, const char *pattern);
+
+static DocSetNameIndex *get_name_index(DocSet *docset);
+
+static void fuzzy_scan(const DocSetNameIndex *index,
+                       const char            *query,
+                       size_t                 query_len,
+                       unsigned long          mask,
+                       DocSetTopK            *topk,
+                       size_t                 from,
+                       size_t                 to);
+
+static sqlite3_stmt *acquire_stmt(DocSet *docset,
+                                  DocSetConn *conn,
+                                  QueryShape shape,
+                                  unsigned columns,
+                                  unsigned num_params,
+                                  unsigned *key);
+
+static int build_query(DocSetStringBuf *buf,
+                       const QueryTable *table,
+                       QueryShape shape,
+                       unsigned columns,
+                       unsigned num_params);
+
+static int append_params(DocSetStringBuf *buf, unsigned n);
+
+static sqlite3_stmt *take_cached_stmt(DocSetConn *conn, unsigned key);
+
+static sqlite3_stmt *prepare_stmt(DocSet *docset,
+                                  DocSetConn *conn,
+                                  const char *query);
+
+static int release_stmt(DocSetConn *conn, unsigned key, sqlite3_stmt *stmt);
+
+static void clear_stmt_cache(DocSetConn *conn);
 
 DocSet *docset_open(const char *basedir)
 {
@@ -125,23 +459,64 @@ DocSet *docset_open(const char *basedir)
 }
 
 DocSetError docset_try_open(DocSet **docset, const char *basedir)
+{
+    return docset_try_open_flags(docset, basedir, 0);
+}
+
+DocSetError docset_try_open_flags(DocSet    **docset,
+                                  const char *basedir,
+                                  unsigned    flags)
+{
+    DocSetOpenOptions options;
+
+    docset_open_options_init(&options);
+    options.flags = flags;
+    return docset_open_ex(docset, basedir, &options);
+}
+
+void docset_open_options_init(DocSetOpenOptions *options)
+{
+    if (options) {
+        memset(options, 0, sizeof(*options));
+        options->temp_store = DOCSET_TEMP_STORE_DEFAULT;
+    }
+}
+
+DocSetError docset_open_ex(DocSet                  **docset,
+                           const char               *basedir,
+                           const DocSetOpenOptions  *options)
 {
     char *index_path = NULL;
     char *plist_path = NULL;
-    size_t base_len = strlen(basedir);
+    size_t base_len;
     DocSetError err = DOCSET_OK;
+    double start;
 
-    if (!docset || !basedir || !base_len) {
+    if (!docset || !basedir || !(base_len = strlen(basedir))) {
         return DOCSET_BAD_CALL;
     }
 
-    *docset = (DocSet *) calloc(1, sizeof(**docset));
+    *docset = (DocSet *) docset_calloc(1, sizeof(**docset));
 
     if (!*docset) {
         return DOCSET_NO_MEM;
     }
 
-    plist_path = (char *) malloc(base_len + sizeof(INFO_PLIST_PATH) + 1);
+    if (options) {
+        (*docset)->options = *options;
+    } else {
+        docset_open_options_init(&(*docset)->options);
+    }
+
+    if ((*docset)->options.flags & DOCSET_OPEN_CONCURRENT) {
+        if (!((*docset)->lock = docset_mutex_create())) {
+            err = DOCSET_NO_MEM;
+            goto fail;
+        }
+    }
+
+    plist_path = (char *)
+        docset_malloc(base_len + sizeof(INFO_PLIST_PATH) + 1);
 
     if (plist_path == NULL) {
         err = DOCSET_NO_MEM;
@@ -154,12 +529,15 @@ DocSetError docset_try_open(DocSet **docset, const char *basedir)
         err = DOCSET_NO_INFO_FILE;
         goto fail;
     }
+    start = docset_clock_now();
     if (!parse_props(*docset, plist_path)) {
         err = DOCSET_BAD_XML;
         goto fail;
     }
+    (*docset)->stats.open_plist_seconds = docset_clock_now() - start;
 
-    index_path = (char *) malloc(base_len + sizeof(INDEX_FILE_PATH) + 1);
+    index_path = (char *)
+        docset_malloc(base_len + sizeof(INDEX_FILE_PATH) + 1);
 
     if (index_path == NULL) {
         err = DOCSET_NO_MEM;
@@ -167,25 +545,36 @@ DocSetError docset_try_open(DocSet **docset, const char *basedir)
     }
 
     sprintf(index_path, "%s%s", basedir, INDEX_FILE_PATH);
-    if (sqlite3_open(index_path, &(*docset)->db) != SQLITE_OK) {
-        err = DOCSET_BAD_DB;
+    (*docset)->db_path = index_path;
+
+    (*docset)->docs_path = (char *)
+        docset_malloc(base_len + sizeof(DOCUMENTS_PATH));
+
+    if ((*docset)->docs_path == NULL) {
+        err = DOCSET_NO_MEM;
         goto fail;
     }
 
-    if (!set_query_table(*docset)) {
+    sprintf((*docset)->docs_path, "%s%s", basedir, DOCUMENTS_PATH);
+    (*docset)->max_documents = DOCUMENT_CACHE_SIZE;
+
+    if ((*docset)->options.flags & DOCSET_OPEN_LAZY) {
+        if (!file_exists(index_path)) {
+            err = DOCSET_BAD_DB;
+            goto fail;
+        }
+    } else if (!connect_db(*docset)) {
         err = DOCSET_BAD_DB;
         goto fail;
     }
 
-    free(plist_path);
-    free(index_path);
+    docset_free(plist_path);
 
     return err;
 
 fail:
     (void)docset_close(*docset);
-    free(index_path);
-    free(plist_path);
+    docset_free(plist_path);
     return err;
 }
 
@@ -197,35 +586,47 @@ DocSetError docset_close(DocSet *docset)
         return DOCSET_OK;
     }
 
-    ret_code = sqlite3_close(docset->db);
-    free(docset->bundle_id);
-    free(docset->name);
-    free(docset->platform_family);
-    free(docset);
+    docset_ni_free(docset->name_index);
+    free_cursor(docset->spare_cursor);
+    docset_rc_free(docset->results);
+    docset_mc_free(docset->documents);
+
+    ret_code = close_all_conns(docset);
+    docset_mutex_destroy(docset->lock);
+    docset_free(docset->bundle_id);
+    docset_free(docset->name);
+    docset_free(docset->platform_family);
+    docset_free(docset->db_path);
+    docset_free(docset->docs_path);
+    docset_free(docset->index_file);
+    docset_free(docset->flat_file);
+    docset_free(docset->flat_path);
+    docset_free(docset);
     return ret_code == SQLITE_OK ? DOCSET_OK : DOCSET_BAD_DB;
 }
 
 unsigned int docset_count(DocSet *docset)
 {
     sqlite3_stmt *stmt = NULL;
+    DocSetConn *conn;
     unsigned int result = 0;
-    const char *query = NULL;
+    unsigned key;
     int error = 0;
 
-    if (!docset) {
+    if (!docset || !(conn = take_conn(docset))) {
         return result;
     }
 
-    query = docset->query_table->count_query;
+    stmt = acquire_stmt(docset, conn, QUERY_COUNT, 0, 0, &key);
 
-    if (sqlite3_prepare_v2(docset->db, query, -1, &stmt, NULL) == SQLITE_OK &&
-        sqlite3_step(stmt) == SQLITE_ROW) {
+    if (stmt && sqlite3_step(stmt) == SQLITE_ROW) {
         result = sqlite3_column_int(stmt, 0);
     } else {
         error = 1;
     }
 
-    sqlite3_finalize(stmt);
+    release_stmt(conn, key, stmt);
+    give_conn(docset, conn);
 
     if (error) report_error(docset, "Query execution error");
 
@@ -252,245 +653,1415 @@ DocSetFlags docset_flags(DocSet *docset)
     return docset->flags;
 }
 
-void docset_set_error_handler(DocSet *docset, docset_err_handler h, void *ctx)
+const char *docset_documents_path(DocSet *docset)
 {
-    if (docset) {
-        docset->err_handler = h;
-        docset->err_context = ctx;
-    }
+    return docset->docs_path;
 }
 
-const char *docset_error_string(DocSetError err)
+void docset_set_name_index(DocSet *docset, int enabled)
 {
-    switch (err) {
-    case DOCSET_OK: return NULL;
-    case DOCSET_BAD_CALL: return "Docset API usage error";
-    case DOCSET_NO_MEM: return "Memory allocation error";
-    case DOCSET_NO_INFO_FILE: return "File not found: " PLIST_FILE_NAME;
-    case DOCSET_BAD_XML: return PLIST_FILE_NAME ": Xml parse error";
-    case DOCSET_NO_DB: return "File not found: " DB_FILE_NAME;
-    case DOCSET_BAD_DB: return DB_FILE_NAME ": Database access error";
-    case DOCSET_TOO_MANY_ARGS: return "Too many arguments";
-    default: return "Unknown docset error";
+    if (!docset) {
+        return;
     }
-}
 
-const char *docset_kind_name(DocSetKind k)
-{
-    if (DOCSET_KIND_DASH <= k && k <= DOCSET_KIND_ZDASH) {
-        return KIND_NAMES[k];
+    docset->use_name_index = enabled;
+    docset->name_index_failed = 0;
+
+    if (!enabled) {
+        docset_ni_free(docset->name_index);
+        docset->name_index = NULL;
     }
-    return "UNKNOWN";
 }
 
-DocSetKind docset_kind(DocSet *docset)
+void docset_get_stats(DocSet *docset, DocSetStats *stats)
 {
-    QueryTable *t;
-
-    if (docset == NULL) {
-        return DOCSET_KIND_UNKNOWN;
+    if (!docset || !stats) {
+        return;
     }
 
-    t = docset->query_table;
-
-    if (t == &dash_query_table) {
-        return DOCSET_KIND_DASH;
-    }
-    if (t == &zdash_query_table) {
-        return DOCSET_KIND_ZDASH;
+    /* Connections of a concurrent docset merge their counters into the
+     * docset ones when they are returned to the pool. */
+    docset_mutex_lock(docset->lock);
+    *stats = docset->stats;
+    if (!docset->lock) {
+        add_stats(stats, &docset->conn.stats);
     }
-
-    return DOCSET_KIND_UNKNOWN;
+    docset_mutex_unlock(docset->lock);
 }
 
-DocSetCursor *docset_find(DocSet *docset, const char *pattern)
+void docset_reset_stats(DocSet *docset)
 {
-    DocSetCursor *cursor;
-    const char *query;
-
-    if (!docset || !pattern) {
-        return NULL;
+    if (!docset) {
+        return;
     }
 
-    query = docset->query_table->name_like_query;
-    cursor = cursor_for_query(docset, query, -1);
-
-    if (!cursor) {
-        return NULL;
+    docset_mutex_lock(docset->lock);
+    memset(&docset->stats, 0, sizeof(docset->stats));
+    if (!docset->lock) {
+        memset(&docset->conn.stats, 0, sizeof(docset->conn.stats));
     }
-
-    sqlite3_bind_text(cursor->stmt, 1, pattern, -1, SQLITE_TRANSIENT);
-
-    return cursor;
+    docset_mutex_unlock(docset->lock);
 }
 
-DocSetCursor *docset_find_by_ids(DocSet *docset,
-                                 const DocSetEntryId *ids,
-                                 unsigned num_ids)
+void docset_set_step_timing(DocSet *docset, int enabled)
 {
-    DocSetCursor *cursor = NULL;
-    DocSetStringBuf buf;
-    const char *query_base;
-    size_t n;
-    unsigned i;
-
-    if (!docset || !ids || num_ids < 1) {
-        report_error(docset, docset_error_string(DOCSET_BAD_CALL));
-        return NULL;
-    }
-    if (num_ids > (unsigned) DOCSET_MAX_IDS) {
-        report_error(docset, docset_error_string(DOCSET_TOO_MANY_ARGS));
-        return NULL;
+    if (docset) {
+        docset->step_timing = enabled;
     }
+}
 
-    query_base = docset->query_table->query_base;
-    n = strlen(query_base);
-
-    docset_sb_init(&buf, n + num_ids * 5);
-    docset_sb_assign(&buf, query_base, n);
-
-    docset_sb_append(&buf, " where id in (?");
-    for (i = 1; i < num_ids; i++) {
-        docset_sb_append(&buf, ", ?");
+void docset_set_type_weight(DocSet          *docset,
+                            DocSetEntryType  type,
+                            unsigned         weight)
+{
+    if (!docset || type < DOCSET_TYPE_FIRST || type > DOCSET_TYPE_LAST) {
+        return;
     }
-    docset_sb_append(&buf, ") order by id");
 
-    cursor = cursor_for_query(docset, buf.data, -1);
-    if (!cursor) {
-        goto error;
-    }
+    docset->type_weights[type] = (unsigned char)
+        (weight < DOCSET_RANK_MAX_WEIGHT ? weight : DOCSET_RANK_MAX_WEIGHT);
+    docset->has_type_weights = docset->has_type_weights || weight > 0;
 
-    for (i = 1; i <= num_ids; i++) {
-        sqlite3_bind_int(cursor->stmt, (int)i, ids[i - 1]);
+    /* Cached results of docset_find_top() are ranked with old weights,
+     * cursors may still hold references to them. */
+    if (docset->results) {
+        docset_mutex_lock(docset->lock);
+        docset_rc_clear(docset->results);
+        docset_mutex_unlock(docset->lock);
     }
+}
 
-    return cursor;
-
-error:
-    docset_sb_destroy(&buf);
-    docset_cursor_dispose(cursor);
-    return NULL;
+unsigned docset_type_weight(DocSet *docset, DocSetEntryType type)
+{
+    if (!docset || type < DOCSET_TYPE_FIRST || type > DOCSET_TYPE_LAST) {
+        return 0;
+    }
+    return docset->type_weights[type];
 }
 
-DocSetCursor *docset_list_entries(DocSet *docset)
+DocSetError docset_set_cache_dir(DocSet *docset, const char *dir)
 {
-    const char *query;
+    char *path = NULL;
+    char *flat_path = NULL;
 
     if (!docset) {
-        return NULL;
+        return DOCSET_BAD_CALL;
+    }
+
+    if (dir
+        && (!(path = docset_if_path(dir, docset->db_path, ".dsni"))
+            || !(flat_path = docset_if_path(dir, docset->db_path,
+                                            ".dsflat")))) {
+        docset_free(path);
+        report_no_mem(docset);
+        return DOCSET_NO_MEM;
     }
 
-    query = docset->query_table->all_query;
-    return cursor_for_query(docset, query, -1);
+    docset_free(docset->index_file);
+    docset->index_file = path;
+    docset_free(docset->flat_file);
+    docset->flat_file = flat_path;
+    return DOCSET_OK;
 }
 
-int docset_cursor_dispose(DocSetCursor *cursor)
+DocSetError docset_set_result_cache(DocSet *docset, size_t max_bytes)
 {
-    int ret_code;
+    DocSetResultCache *cache = NULL;
 
-    if (!cursor) {
-        return 0;
+    if (!docset) {
+        return DOCSET_BAD_CALL;
     }
 
-    ret_code = sqlite3_finalize(cursor->stmt);
-    dispose_entry(&cursor->entry);
-    free(cursor);
+    if (max_bytes > 0 && !(cache = docset_rc_create(max_bytes))) {
+        report_no_mem(docset);
+        return DOCSET_NO_MEM;
+    }
 
-    return ret_code != SQLITE_OK;
+    docset_mutex_lock(docset->lock);
+    docset_rc_free(docset->results);
+    docset->results = cache;
+    docset_mutex_unlock(docset->lock);
+    return DOCSET_OK;
 }
 
-int docset_cursor_step(DocSetCursor *cursor)
+DocSetError docset_open_document(DocSet         *docset,
+                                 DocSetEntry    *entry,
+                                 DocSetDocument *document)
 {
-    return cursor && sqlite3_step(cursor->stmt) == SQLITE_ROW;
+    const char *path = entry ? docset_entry_path(entry) : NULL;
+
+    if (!path) {
+        return DOCSET_BAD_CALL;
+    }
+    return docset_open_document_path(docset, path, document);
 }
 
-DocSetEntry *docset_cursor_entry(DocSetCursor *cursor)
+DocSetError docset_open_document_path(DocSet         *docset,
+                                      const char     *path,
+                                      DocSetDocument *document)
 {
-    DocSetEntry *e;
-    sqlite3_stmt *stmt;
-    int column_index = 0;
-
-    if (!cursor) {
-        return NULL;
+    const DocSetMapping *mapping = NULL;
+    const char *file, *anchor;
+    size_t file_len, docs_len;
+    char *file_path;
+    DocSetError err = DOCSET_NO_MEM;
+    int hit;
+
+    if (!docset || !path || !document) {
+        return DOCSET_BAD_CALL;
     }
 
-    e = &cursor->entry;
-    stmt = cursor->stmt;
+    memset(document, 0, sizeof(*document));
+    document->anchor_offset = DOCSET_NO_ANCHOR;
 
-    e->id = sqlite3_column_int(stmt, column_index++);
-    assign_buffer_col(&e->name, stmt, column_index++);
-    assign_buffer_col(&e->type, stmt, column_index++);
-    assign_buffer_col(&e->parent, stmt, column_index++);
-    assign_buffer_col(&e->path, stmt, column_index++);
+    if (!docset_doc_split_path(path, &file, &file_len, &anchor)) {
+        return DOCSET_NO_DOCUMENT;
+    }
 
-    return e;
-}
+    docs_len = strlen(docset->docs_path);
+    file_path = (char *) docset_malloc(docs_len + file_len + 1);
+    if (!file_path) {
+        report_no_mem(docset);
+        return DOCSET_NO_MEM;
+    }
+    memcpy(file_path, docset->docs_path, docs_len);
+    memcpy(file_path + docs_len, file, file_len);
+    file_path[docs_len + file_len] = '\0';
 
-DocSetEntryId docset_entry_id(DocSetEntry *entry)
-{
-    return entry->id;
-}
+    docset_mutex_lock(docset->lock);
+    if (!docset->documents) {
+        docset->documents = docset_mc_create(docset->max_documents);
+    }
+    if (docset->documents) {
+        mapping = docset_mc_acquire(docset->documents, file_path, &hit, &err);
+    }
+    if (mapping && hit) {
+        docset->stats.document_cache_hits++;
+    } else if (mapping) {
+        docset->stats.document_cache_misses++;
+    }
+    docset_mutex_unlock(docset->lock);
+    docset_free(file_path);
 
-const char *docset_entry_name(DocSetEntry *entry)
-{
-    return entry->name.data;
-}
+    if (!mapping) {
+        if (err == DOCSET_NO_MEM) {
+            report_no_mem(docset);
+        }
+        return err;
+    }
 
-DocSetEntryType docset_entry_type(DocSetEntry *entry)
-{
-    return docset_type_by_name(entry->type.data);
+    document->data = mapping->data;
+    document->size = mapping->size;
+    document->anchor_offset = docset_doc_find_anchor(mapping->data,
+                                                     mapping->size, anchor);
+    document->docset = docset;
+    document->mapping = mapping;
+    return DOCSET_OK;
 }
 
-const char *docset_entry_type_name(DocSetEntry *entry)
+void docset_close_document(DocSetDocument *document)
 {
-    return entry->type.data;
-}
+    DocSet *docset;
 
-const char *docset_entry_path(DocSetEntry *entry)
-{
-    return entry->path.data;
-}
+    if (!document || !document->mapping) {
+        return;
+    }
 
-const char *docset_entry_canonical_type(DocSetEntry *entry)
-{
-    const char *native_type = docset_entry_type_name(entry);
-    DocSetEntryType type = docset_type_by_name(native_type);
+    docset = document->docset;
+    docset_mutex_lock(docset->lock);
+    docset_mc_release(docset->documents,
+                      (const DocSetMapping *)document->mapping);
+    docset_mutex_unlock(docset->lock);
 
-    return docset_canonical_type_name(type);
+    memset(document, 0, sizeof(*document));
+    document->anchor_offset = DOCSET_NO_ANCHOR;
 }
 
-static int file_exists(const char *filename)
+void docset_set_document_cache(DocSet *docset, size_t max_documents)
 {
-    /* Looks like the only ANSI-C compatible way
-     * to check file existence */
-    FILE *f = fopen(filename, "r");
-    if (f != NULL) {
-        fclose(f);
-        return 1;
+    if (!docset) {
+        return;
     }
-    return 0;
-}
-
-static int init_entry(DocSetEntry *e)
-{
-    int ok = docset_sb_init(&e->name, BUF_INIT_SIZE) &
-             docset_sb_init(&e->type, BUF_INIT_SIZE) &
-             docset_sb_init(&e->parent, BUF_INIT_SIZE) &
-             docset_sb_init(&e->path, BUF_INIT_SIZE);
 
-    if (!ok) {
-        dispose_entry(e);
+    docset_mutex_lock(docset->lock);
+    docset->max_documents = max_documents;
+    if (docset->documents) {
+        docset_mc_set_max_idle(docset->documents, max_documents);
     }
-
-    return ok;
+    docset_mutex_unlock(docset->lock);
 }
 
-static void assign_buffer_col(DocSetStringBuf *buf, sqlite3_stmt *stmt, int col)
+DocSetError docset_flatten(DocSet *docset)
 {
-    docset_sb_assign(buf,
-                     (const char *)sqlite3_column_text(stmt, col),
-                     (size_t)sqlite3_column_bytes(stmt, col));
-}
+    DocSetStringBuf query;
+    DocSetError err = DOCSET_BAD_DB;
+    sqlite3 *db = NULL;
+    char *stamp = NULL;
+    char *path = NULL;
+
+    if (!docset) {
+        return DOCSET_BAD_CALL;
+    }
+    if (!ensure_db(docset)) {
+        return DOCSET_BAD_DB;
+    }
+    if (docset->query_table != &zdash_query_table) {
+        return DOCSET_OK;
+    }
+    /* Pooled connections can't share an in-memory database. */
+    if (docset->lock && !docset->flat_file) {
+        report_error(docset, docset_error_string(DOCSET_BAD_CALL));
+        return DOCSET_BAD_CALL;
+    }
+
+    if (!docset_sb_init(&query, BUF_INIT_SIZE * 4)) {
+        report_no_mem(docset);
+        return DOCSET_NO_MEM;
+    }
+    if (!build_query(&query, &zdash_query_table, QUERY_ALL,
+                     DOCSET_COL_ALL, 0)) {
+        err = DOCSET_NO_MEM;
+        goto fail;
+    }
+
+    if (docset->flat_file) {
+        stamp = docset_if_db_stamp(docset->db_path);
+        path = (char *) docset_malloc(strlen(docset->flat_file) + 1);
+        if (!stamp || !path) {
+            goto fail;
+        }
+        strcpy(path, docset->flat_file);
+
+        /* A missing or stale file is rebuilt. */
+        if (!docset_flat_check(path, stamp)
+            && !docset_flat_save(path, docset->db_path, query.data, stamp)) {
+            goto fail;
+        }
+    } else if (!(db = docset_flat_build(docset->db_path, query.data))) {
+        goto fail;
+    }
+
+    close_all_conns(docset);
+    docset->flat_path = path;
+    path = NULL;
+
+    if (db) {
+        docset->conn.db = db;
+    } else if (!open_db(docset, &docset->conn)) {
+        /* The original database is reopened by the next query. */
+        close_conn(&docset->conn);
+        docset_free(docset->flat_path);
+        docset->flat_path = NULL;
+        docset->query_table = NULL;
+        goto fail;
+    }
+
+    docset->query_table = &flat_query_table;
+    if (docset->lock) {
+        docset->idle_conns = &docset->conn;
+    }
+    err = DOCSET_OK;
+
+fail:
+    if (err != DOCSET_OK) {
+        report_error(docset, "Can't flatten the docset");
+    }
+    docset_sb_destroy(&query);
+    docset_free(stamp);
+    docset_free(path);
+    return err;
+}
+
+void docset_set_error_handler(DocSet *docset, docset_err_handler h, void *ctx)
+{
+    if (docset) {
+        docset_mutex_lock(docset->lock);
+        docset->err_handler = h;
+        docset->err_context = ctx;
+        docset_mutex_unlock(docset->lock);
+    }
+}
+
+const char *docset_error_string(DocSetError err)
+{
+    switch (err) {
+    case DOCSET_OK: return NULL;
+    case DOCSET_BAD_CALL: return "Docset API usage error";
+    case DOCSET_NO_MEM: return "Memory allocation error";
+    case DOCSET_NO_INFO_FILE: return "File not found: " PLIST_FILE_NAME;
+    case DOCSET_BAD_XML: return PLIST_FILE_NAME ": Xml parse error";
+    case DOCSET_NO_DB: return "File not found: " DB_FILE_NAME;
+    case DOCSET_BAD_DB: return DB_FILE_NAME ": Database access error";
+    case DOCSET_TOO_MANY_ARGS: return "Too many arguments";
+    case DOCSET_NO_DOCUMENT: return "Document not found";
+    default: return "Unknown docset error";
+    }
+}
+
+const char *docset_kind_name(DocSetKind k)
+{
+    if (DOCSET_KIND_DASH <= k && k <= DOCSET_KIND_ZDASH) {
+        return KIND_NAMES[k];
+    }
+    return "UNKNOWN";
+}
+
+DocSetKind docset_kind(DocSet *docset)
+{
+    QueryTable *t;
+
+    if (docset == NULL || !ensure_db(docset)) {
+        return DOCSET_KIND_UNKNOWN;
+    }
+
+    t = docset->query_table;
+
+    if (t == &dash_query_table) {
+        return DOCSET_KIND_DASH;
+    }
+    if (t == &zdash_query_table || t == &flat_query_table) {
+        return DOCSET_KIND_ZDASH;
+    }
+
+    return DOCSET_KIND_UNKNOWN;
+}
+
+DocSetCursor *docset_find(DocSet *docset, const char *pattern)
+{
+    return docset_find_ex(docset, pattern, DOCSET_COL_ALL);
+}
+
+DocSetCursor *docset_find_ex(DocSet     *docset,
+                             const char *pattern,
+                             unsigned    columns)
+{
+    CachedQuery query;
+
+    if (!docset || !pattern) {
+        return NULL;
+    }
+
+    memset(&query, 0, sizeof(query));
+    query.pattern = pattern;
+    query.columns = columns & DOCSET_COL_ALL;
+    return find_cached(docset, &query);
+}
+
+int docset_cursor_rebind(DocSetCursor *cursor, const char *pattern)
+{
+    if (!cursor || !pattern || !cursor->docset) {
+        return 0;
+    }
+    if (cursor->cached_query) {
+        return cursor_set_cached(cursor, pattern);
+    }
+    if (cursor->rows) {
+        return 0;
+    }
+    return cursor_set_pattern(cursor, pattern);
+}
+
+DocSetCursor *docset_find_typed(DocSet               *docset,
+                                const char           *pattern,
+                                const DocSetTypeMask *types)
+{
+    CachedQuery query;
+
+    if (!docset || !pattern || !types) {
+        return NULL;
+    }
+
+    memset(&query, 0, sizeof(query));
+    query.pattern = pattern;
+    query.columns = DOCSET_COL_ALL;
+    query.types = types;
+    return find_cached(docset, &query);
+}
+
+static DocSetCursor *find_pattern(DocSet               *docset,
+                                  const char           *pattern,
+                                  unsigned              columns,
+                                  const DocSetTypeMask *types)
+{
+    DocSetCursor *cursor = new_cursor(docset);
+
+    if (!cursor) {
+        return NULL;
+    }
+
+    cursor->columns = columns;
+    if (types) {
+        cursor->has_types = 1;
+        cursor->types = *types;
+    }
+
+    if (!cursor_set_pattern(cursor, pattern)) {
+        docset_cursor_dispose(cursor);
+        return NULL;
+    }
+
+    return cursor;
+}
+
+DocSetCursor *docset_find_by_ids(DocSet *docset,
+                                 const DocSetEntryId *ids,
+                                 unsigned num_ids)
+{
+    DocSetCursor *cursor = NULL;
+
+    if (!docset || !ids || num_ids < 1) {
+        report_error(docset, docset_error_string(DOCSET_BAD_CALL));
+        return NULL;
+    }
+
+    cursor = new_cursor(docset);
+    if (!cursor) {
+        return NULL;
+    }
+
+    if (!cursor_set_ids(cursor, ids, num_ids)) {
+        docset_cursor_dispose(cursor);
+        return NULL;
+    }
+    return cursor;
+}
+
+/* The mask test rejects most of the names with a couple of
+ * instructions, names that can't beat the worst of the current top
+ * entries are not scored either. */
+static void fuzzy_scan(const DocSetNameIndex *index,
+                       const char            *query,
+                       size_t                 query_len,
+                       unsigned long          mask,
+                       DocSetTopK            *topk,
+                       size_t                 from,
+                       size_t                 to)
+{
+    const char *name;
+    unsigned long rank;
+    size_t name_len, i;
+
+    for (i = from; i < to; ++i) {
+        if ((mask & ~index->masks[i]) != 0) {
+            continue;
+        }
+        name = docset_ni_name(index, index->items + i);
+        name_len = strlen(name);
+        if (docset_topk_accepts(topk,
+                                docset_fuzzy_best_rank(query_len, name_len))
+            && docset_fuzzy_rank(query, query_len, name, name_len, &rank)) {
+            docset_topk_push(topk, rank, index->items[i].id);
+        }
+    }
+}
+
+DocSetCursor *docset_fuzzy_find(DocSet *docset, const char *query, size_t k)
+{
+    DocSetNameIndex *index;
+    DocSetCursor *c;
+    DocSetTopK topk;
+    unsigned long mask;
+    size_t query_len;
+    size_t lo = 0, hi = 0;
+
+    if (!docset || !query) {
+        report_error(docset, docset_error_string(DOCSET_BAD_CALL));
+        return NULL;
+    }
+
+    query_len = strlen(query);
+    if (query_len > DOCSET_FUZZY_MAX_QUERY) {
+        report_error(docset, "Fuzzy query is too long");
+        return NULL;
+    }
+
+    if (!(index = get_name_index(docset))) {
+        return NULL;
+    }
+
+    if (!docset_topk_init(&topk, k)) {
+        report_no_mem(docset);
+        return NULL;
+    }
+
+    /* Names starting with the first query character are likely to be
+     * the best, scoring them first makes the pruning more effective. */
+    if (query_len > 0) {
+        docset_ni_prefix_range(index, query, 1, &lo, &hi);
+    }
+    mask = docset_ni_char_mask(query);
+    fuzzy_scan(index, query, query_len, mask, &topk, lo, hi);
+    fuzzy_scan(index, query, query_len, mask, &topk, 0, lo);
+    fuzzy_scan(index, query, query_len, mask, &topk, hi, index->num_items);
+
+    c = new_cursor(docset);
+    if (c && !cursor_set_topk(c, &topk)) {
+        docset_cursor_dispose(c);
+        c = NULL;
+    }
+
+    docset_topk_destroy(&topk);
+    return c;
+}
+
+DocSetCursor *docset_find_top(DocSet *docset, const char *pattern, size_t k)
+{
+    CachedQuery query;
+
+    if (!docset || !pattern) {
+        report_error(docset, docset_error_string(DOCSET_BAD_CALL));
+        return NULL;
+    }
+
+    memset(&query, 0, sizeof(query));
+    query.pattern = pattern;
+    query.columns = DOCSET_COL_ALL;
+    query.top = 1;
+    query.k = k;
+    return find_cached(docset, &query);
+}
+
+static DocSetCursor *find_top(DocSet *docset, const char *pattern, size_t k)
+{
+    DocSetCursor *c;
+    DocSetTopK topk;
+    const char *needle, *name, *type;
+    size_t needle_len, name_len, type_len;
+    unsigned long best, rank;
+    unsigned weight = 0;
+
+    if (!docset_topk_init(&topk, k)) {
+        report_no_mem(docset);
+        return NULL;
+    }
+
+    c = find_pattern(docset, pattern,
+                     DOCSET_COL_NAME
+                     | (docset->has_type_weights ? DOCSET_COL_TYPE : 0),
+                     NULL);
+    if (!c) {
+        docset_topk_destroy(&topk);
+        return NULL;
+    }
+
+    needle_len = docset_rank_needle(pattern, &needle);
+    best = docset_rank_best(needle_len, needle_len, 0);
+
+    while (k > 0 && docset_cursor_step(c)) {
+        name = cursor_column(c, COL_NAME, &name_len);
+        if (docset->has_type_weights) {
+            type = cursor_column(c, COL_TYPE, &type_len);
+            weight = docset_type_weight(docset,
+                                        cursor_type(c, type, type_len));
+        }
+
+        /* Names that can't beat the worst of the top entries are not
+         * ranked. */
+        if (!docset_topk_accepts(&topk,
+                                 docset_rank_best(name_len, needle_len,
+                                                  weight))) {
+            continue;
+        }
+
+        rank = docset_rank_score(name, name_len, needle, needle_len, weight);
+        docset_topk_push(&topk, rank, sqlite3_column_int(c->stmt, COL_ID));
+
+        /* Nothing could beat the top entries any more. */
+        if (topk.size == k && topk.items[0].rank <= best) {
+            break;
+        }
+    }
+
+    c->columns = DOCSET_COL_ALL;
+    if (!cursor_set_topk(c, &topk)) {
+        docset_cursor_dispose(c);
+        c = NULL;
+    }
+
+    docset_topk_destroy(&topk);
+    return c;
+}
+
+static DocSetCursor *run_query(DocSet *docset, const CachedQuery *query)
+{
+    if (query->top) {
+        return find_top(docset, query->pattern, query->k);
+    }
+    return find_pattern(docset, query->pattern, query->columns,
+                        query->types);
+}
+
+/* Keys start with the query kind, so the fields that follow it are
+ * never confused with the pattern. */
+static int result_key(DocSetStringBuf *key, const CachedQuery *query)
+{
+    char head[32 + 9 * DOCSET_TYPE_MASK_WORDS];
+    size_t n, i;
+
+    n = (size_t)sprintf(head, "%c%u:%lu:",
+                        query->top ? 't' : query->types ? 'y' : 'f',
+                        query->columns, (unsigned long)query->k);
+    for (i = 0; query->types && i < DOCSET_TYPE_MASK_WORDS; ++i) {
+        n += (size_t)sprintf(head + n, "%lx:", query->types->bits[i]);
+    }
+
+    if (!docset_sb_reserve(key, n + strlen(query->pattern) + 1)) {
+        return 0;
+    }
+    docset_sb_assign(key, head, n);
+    return docset_sb_append(key, query->pattern);
+}
+
+/* Returns the result of the query with a reference for the caller,
+ * results of the queries missing in the cache are fetched completely
+ * and added to it. */
+static DocSetSharedRows *cached_rows(DocSet *docset, const CachedQuery *query)
+{
+    DocSetStringBuf key;
+    DocSetSharedRows *rows;
+    DocSetCursor *c;
+    int ok;
+
+    if (!docset_sb_init(&key, RESULT_KEY_INIT_SIZE)) {
+        report_no_mem(docset);
+        return NULL;
+    }
+    if (!result_key(&key, query)) {
+        docset_sb_destroy(&key);
+        report_no_mem(docset);
+        return NULL;
+    }
+
+    docset_mutex_lock(docset->lock);
+    rows = docset_rc_lookup(docset->results, key.data);
+    if (rows) {
+        docset->stats.result_cache_hits++;
+    } else {
+        docset->stats.result_cache_misses++;
+    }
+    docset_mutex_unlock(docset->lock);
+
+    if (!rows) {
+        if (!(rows = docset_rows_create_shared())) {
+            report_no_mem(docset);
+        }
+        c = rows ? run_query(docset, query) : NULL;
+        ok = c && docset_cursor_collect(c, &rows->rows);
+        docset_cursor_dispose(c);
+
+        /* A result that could not be cached only costs a miss later. */
+        if (ok) {
+            docset_mutex_lock(docset->lock);
+            docset_rc_insert(docset->results, key.data, rows);
+            docset_mutex_unlock(docset->lock);
+        } else {
+            docset_rows_release_shared(rows);
+            rows = NULL;
+        }
+    }
+
+    docset_sb_destroy(&key);
+    return rows;
+}
+
+/* Answers the query from the result cache, the cursor shares the rows
+ * with the cache. */
+static DocSetCursor *find_cached(DocSet *docset, const CachedQuery *query)
+{
+    DocSetSharedRows *rows;
+    DocSetCursor *c;
+
+    if (!docset->results) {
+        return run_query(docset, query);
+    }
+
+    if (!(rows = cached_rows(docset, query))
+        || !(c = adopt_rows(docset, rows))) {
+        return NULL;
+    }
+
+    c->columns = query->columns;
+    c->cached_query = !query->top;
+    c->has_types = query->types != NULL;
+    if (query->types) {
+        c->types = *query->types;
+    }
+    return c;
+}
+
+/* Rebinds the cursor of a cached query, see find_cached(). */
+static int cursor_set_cached(DocSetCursor *c, const char *pattern)
+{
+    CachedQuery query;
+    DocSetSharedRows *rows;
+
+    memset(&query, 0, sizeof(query));
+    query.pattern = pattern;
+    query.columns = c->columns;
+    query.types = c->has_types ? &c->types : NULL;
+
+    if (!(rows = cached_rows(c->docset, &query))) {
+        return 0;
+    }
+
+    release_rows(c);
+    c->rows = &rows->rows;
+    c->shared_rows = rows;
+    c->next_row = 0;
+    return 1;
+}
+
+DocSetCursor *docset_list_entries(DocSet *docset)
+{
+    if (!docset) {
+        return NULL;
+    }
+
+    return cursor_for_query(docset, QUERY_ALL, DOCSET_COL_ALL);
+}
+
+int docset_cursor_dispose(DocSetCursor *cursor)
+{
+    DocSet *docset;
+    int ret_code;
+
+    if (!cursor) {
+        return 0;
+    }
+
+    docset = cursor->docset;
+    ret_code = release_stmt(cursor->conn, cursor->stmt_key, cursor->stmt);
+
+    docset_free(cursor->ids);
+    cursor->ids = NULL;
+    cursor->stmt = NULL;
+
+    release_rows(cursor);
+    docset_free(cursor->sources);
+    cursor->sources = NULL;
+
+    if (docset) {
+        give_conn(docset, cursor->conn);
+        cursor->conn = NULL;
+
+        docset_mutex_lock(docset->lock);
+        if (!docset->spare_cursor) {
+            docset->spare_cursor = cursor;
+            cursor = NULL;
+        }
+        docset_mutex_unlock(docset->lock);
+    }
+    free_cursor(cursor);
+
+    return ret_code != SQLITE_OK;
+}
+
+int docset_cursor_step(DocSetCursor *cursor)
+{
+    if (!cursor) {
+        return 0;
+    }
+
+    if (cursor->rows) {
+        if (cursor->next_row < cursor->rows->num_rows) {
+            cursor->next_row++;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!cursor->by_ids) {
+        if (cursor->finished || !step_stmt(cursor)) {
+            cursor->finished = 1;
+            return 0;
+        }
+        return 1;
+    }
+
+    if (cursor->chunk_size) {
+        return step_chunks(cursor);
+    }
+
+    while (cursor->next_id < cursor->num_ids) {
+        sqlite3_reset(cursor->stmt);
+        sqlite3_bind_int(cursor->stmt, 1, cursor->ids[cursor->next_id++]);
+        if (step_stmt(cursor)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int docset_cursor_failed(DocSetCursor *cursor)
+{
+    return cursor && cursor->failed;
+}
+
+/* Executes the statement for consecutive chunks of the sorted ids, the
+ * last chunk is padded with its last id. */
+static int step_chunks(DocSetCursor *c)
+{
+    size_t i, n;
+
+    for (;;) {
+        if (c->chunk_active) {
+            if (step_stmt(c)) {
+                return 1;
+            }
+            c->chunk_active = 0;
+        }
+
+        if (c->next_id >= c->num_ids) {
+            return 0;
+        }
+
+        n = c->num_ids - c->next_id;
+        if (n > c->chunk_size) {
+            n = c->chunk_size;
+        }
+
+        sqlite3_reset(c->stmt);
+        for (i = 0; i < c->chunk_size; ++i) {
+            sqlite3_bind_int(c->stmt, (int)i + 1,
+                             c->ids[c->next_id + (i < n ? i : n - 1)]);
+        }
+        c->next_id += n;
+        c->chunk_active = 1;
+    }
+}
+
+DocSetEntry *docset_cursor_entry(DocSetCursor *cursor)
+{
+    DocSetEntry *e;
+    sqlite3_stmt *stmt;
+    DocSetStats *stats;
+    unsigned columns;
+
+    if (!cursor) {
+        return NULL;
+    }
+
+    e = &cursor->entry;
+    e->columns = columns = cursor->columns;
+
+    if (cursor->rows) {
+        assign_row(e, cursor->rows, cursor->next_row - 1);
+        return e;
+    }
+
+    stmt = cursor->stmt;
+    stats = &cursor->conn->stats;
+
+    e->id = sqlite3_column_int(stmt, COL_ID);
+    if (columns & DOCSET_COL_NAME) {
+        assign_buffer_col(stats, &e->name, stmt, COL_NAME);
+    }
+    if (columns & DOCSET_COL_TYPE) {
+        assign_buffer_col(stats, &e->type, stmt, COL_TYPE);
+        e->type_id = docset_td_lookup(&cursor->conn->types,
+                                      e->type.data, e->type.size);
+    }
+    if (columns & DOCSET_COL_PARENT) {
+        assign_buffer_col(stats, &e->parent, stmt, COL_PARENT);
+    }
+    if (columns & DOCSET_COL_PATH) {
+        assign_buffer_col(stats, &e->path, stmt, COL_PATH);
+    }
+
+    return e;
+}
+
+DocSet *docset_cursor_docset(DocSetCursor *cursor)
+{
+    if (!cursor) {
+        return NULL;
+    }
+
+    if (cursor->rows) {
+        const DocSetRow *row;
+
+        if (!cursor->sources || cursor->next_row == 0) {
+            return cursor->docset;
+        }
+        row = cursor->rows->rows + (cursor->next_row - 1);
+        return cursor->sources[row->source];
+    }
+
+    return cursor->docset;
+}
+
+void docset_batch_init(DocSetBatch *batch)
+{
+    memset(batch, 0, sizeof(*batch));
+}
+
+void docset_batch_destroy(DocSetBatch *batch)
+{
+    if (!batch) {
+        return;
+    }
+    docset_free(batch->ids);
+    docset_free(batch->types);
+    docset_free(batch->docsets);
+    docset_free(batch->name_offsets);
+    docset_free(batch->name_lengths);
+    docset_free(batch->type_offsets);
+    docset_free(batch->type_lengths);
+    docset_free(batch->path_offsets);
+    docset_free(batch->path_lengths);
+    docset_free(batch->strings);
+    docset_batch_init(batch);
+}
+
+size_t docset_cursor_fetch_batch(DocSetCursor *cursor,
+                                 size_t        n,
+                                 DocSetBatch  *batch)
+{
+    const char *s;
+    size_t i, len;
+    size_t last_type = 0;
+    unsigned columns;
+    int ok = 1;
+
+    if (!cursor || !batch) {
+        return 0;
+    }
+
+    batch->size = 0;
+    batch->strings_size = 0;
+    columns = cursor->columns;
+
+    /* Offset 0 is the empty string shared by all the missing values. */
+    if (!batch_append(batch, "", 0, &i)) {
+        cursor->failed = 1;
+        report_no_mem(cursor->docset);
+        return 0;
+    }
+
+    while (batch->size < n && docset_cursor_step(cursor)) {
+        i = batch->size;
+        if (!batch_reserve(batch, i + 1)) {
+            ok = 0;
+            break;
+        }
+
+        batch->ids[i] = cursor->rows
+                        ? cursor->rows->rows[cursor->next_row - 1].id
+                        : sqlite3_column_int(cursor->stmt, COL_ID);
+        batch->types[i] = DOCSET_TYPE_UNKNOWN;
+        batch->docsets[i] = docset_cursor_docset(cursor);
+        batch->name_offsets[i] = batch->name_lengths[i] = 0;
+        batch->type_offsets[i] = batch->type_lengths[i] = 0;
+        batch->path_offsets[i] = batch->path_lengths[i] = 0;
+
+        if (columns & DOCSET_COL_NAME) {
+            s = cursor_column(cursor, COL_NAME, &len);
+            if (!batch_append(batch, s, len, &batch->name_offsets[i])) {
+                ok = 0;
+                break;
+            }
+            batch->name_lengths[i] = len;
+        }
+
+        if (columns & DOCSET_COL_TYPE) {
+            s = cursor_column(cursor, COL_TYPE, &len);
+            /* Neighbour entries tend to have the same type, share the
+             * string and skip the type name lookup. */
+            if (i > 0
+                && batch->type_lengths[last_type] == len
+                && memcmp(batch->strings + batch->type_offsets[last_type],
+                          s, len) == 0) {
+                batch->type_offsets[i] = batch->type_offsets[last_type];
+                batch->types[i] = batch->types[last_type];
+            } else if (batch_append(batch, s, len, &batch->type_offsets[i])) {
+                batch->types[i] = cursor_type(cursor, s, len);
+            } else {
+                ok = 0;
+                break;
+            }
+            batch->type_lengths[i] = len;
+            last_type = i;
+        }
+
+        if (columns & DOCSET_COL_PATH) {
+            s = cursor_column(cursor, COL_PATH, &len);
+            if (!batch_append(batch, s, len, &batch->path_offsets[i])) {
+                ok = 0;
+                break;
+            }
+            batch->path_lengths[i] = len;
+        }
+
+        batch->size++;
+    }
+
+    if (!ok) {
+        cursor->failed = 1;
+        report_no_mem(cursor->docset);
+    }
+    if (cursor->conn) {
+        cursor->conn->stats.bytes_copied += batch->strings_size;
+    }
+
+    return batch->size;
+}
+
+DocSetCursor *docset_cursor_for_shared_rows(DocSet           *docset,
+                                            DocSetSharedRows *rows)
+{
+    docset_mutex_lock(docset->lock);
+    rows->refs++;
+    docset_mutex_unlock(docset->lock);
+
+    return adopt_rows(docset, rows);
+}
+
+DocSetSharedRows *docset_view_rows(DocSet           *docset,
+                                   DocSetSharedRows *rows)
+{
+    DocSetSharedRows *view;
+
+    docset_mutex_lock(docset->lock);
+    view = docset_rows_create_view(rows);
+    docset_mutex_unlock(docset->lock);
+
+    if (!view) {
+        report_no_mem(docset);
+    }
+    return view;
+}
+
+void docset_release_rows(DocSet *docset, DocSetSharedRows *rows)
+{
+    docset_mutex_lock(docset->lock);
+    docset_rows_release_shared(rows);
+    docset_mutex_unlock(docset->lock);
+}
+
+int docset_cursor_collect(DocSetCursor *cursor, DocSetRows *rows)
+{
+    while (docset_cursor_step(cursor)) {
+        if (!docset_rows_append(rows, docset_cursor_entry(cursor))) {
+            cursor->failed = 1;
+            report_no_mem(cursor->docset);
+            return 0;
+        }
+    }
+    return !cursor->failed;
+}
+
+DocSetCursor *docset_cursor_for_rows(DocSetRows    *rows,
+                                     DocSet *const *sources,
+                                     unsigned       num_sources)
+{
+    DocSetCursor *c = new_cursor(NULL);
+
+    /* The sources are copied, the array they come from may be grown
+     * while the cursor is alive. */
+    if (c && sources) {
+        c->sources = (DocSet **)
+            docset_malloc((num_sources ? num_sources : 1) * sizeof(DocSet *));
+        if (c->sources) {
+            memcpy(c->sources, sources, num_sources * sizeof(DocSet *));
+        } else {
+            free_cursor(c);
+            c = NULL;
+        }
+    }
+
+    if (!c) {
+        docset_rows_destroy(rows);
+        docset_free(rows);
+        return NULL;
+    }
+
+    c->rows = rows;
+    return c;
+}
+
+int docset_cursor_materialize(DocSetCursor *cursor, DocSetArena *arena)
+{
+    DocSetRows fetched;
+    DocSetRows *rows;
+    int ok = 1;
+
+    if (!cursor || !arena) {
+        return 0;
+    }
+
+    if (cursor->rows) {
+        rows = docset_rows_pack(cursor->rows, cursor->next_row, arena);
+    } else {
+        if (!docset_rows_init(&fetched)) {
+            report_no_mem(cursor->docset);
+            return 0;
+        }
+        while (ok && docset_cursor_step(cursor)) {
+            ok = docset_rows_append(&fetched,
+                                    docset_cursor_entry(cursor)) != NULL;
+        }
+        rows = ok ? docset_rows_pack(&fetched, 0, arena) : NULL;
+        docset_rows_destroy(&fetched);
+    }
+
+    if (!rows) {
+        report_no_mem(cursor->docset);
+        return 0;
+    }
+
+    release_stmt(cursor->conn, cursor->stmt_key, cursor->stmt);
+    cursor->stmt = NULL;
+    if (cursor->docset) {
+        give_conn(cursor->docset, cursor->conn);
+    }
+    cursor->conn = NULL;
+
+    docset_free(cursor->ids);
+    cursor->ids = NULL;
+    cursor->by_ids = 0;
+    cursor->chunk_size = 0;
+
+    release_rows(cursor);
+    cursor->rows = rows;
+    cursor->rows_in_arena = 1;
+    cursor->next_row = 0;
+    return 1;
+}
+
+DocSetEntryId docset_entry_id(DocSetEntry *entry)
+{
+    return entry->id;
+}
+
+const char *docset_entry_name(DocSetEntry *entry)
+{
+    return (entry->columns & DOCSET_COL_NAME) ? entry->name.data : NULL;
+}
+
+size_t docset_entry_name_length(DocSetEntry *entry)
+{
+    return (entry->columns & DOCSET_COL_NAME) ? entry->name.size : 0;
+}
+
+DocSetEntryType docset_entry_type(DocSetEntry *entry)
+{
+    return (entry->columns & DOCSET_COL_TYPE)
+           ? entry->type_id
+           : DOCSET_TYPE_UNKNOWN;
+}
+
+const char *docset_entry_type_name(DocSetEntry *entry)
+{
+    return (entry->columns & DOCSET_COL_TYPE) ? entry->type.data : NULL;
+}
+
+size_t docset_entry_type_name_length(DocSetEntry *entry)
+{
+    return (entry->columns & DOCSET_COL_TYPE) ? entry->type.size : 0;
+}
+
+const char *docset_entry_path(DocSetEntry *entry)
+{
+    return (entry->columns & DOCSET_COL_PATH) ? entry->path.data : NULL;
+}
+
+size_t docset_entry_path_length(DocSetEntry *entry)
+{
+    return (entry->columns & DOCSET_COL_PATH) ? entry->path.size : 0;
+}
+
+const char *docset_entry_canonical_type(DocSetEntry *entry)
+{
+    return docset_canonical_type_name(docset_entry_type(entry));
+}
+
+static int file_exists(const char *filename)
+{
+    /* Looks like the only ANSI-C compatible way
+     * to check file existence */
+    FILE *f = fopen(filename, "r");
+    if (f != NULL) {
+        fclose(f);
+        return 1;
+    }
+    return 0;
+}
+
+static int init_entry(DocSetEntry *e)
+{
+    int ok = docset_sb_init(&e->name, BUF_INIT_SIZE) &
+             docset_sb_init(&e->type, BUF_INIT_SIZE) &
+             docset_sb_init(&e->parent, BUF_INIT_SIZE) &
+             docset_sb_init(&e->path, BUF_INIT_SIZE);
+
+    if (!ok) {
+        dispose_entry(e);
+    }
+
+    return ok;
+}
+
+static void assign_row(DocSetEntry *e, const DocSetRows *rows, size_t i)
+{
+    const DocSetRow *row = rows->rows + i;
+    const char *strings = rows->strings.data;
+
+    e->id = row->id;
+    e->type_id = row->entry_type;
+    docset_sb_assign(&e->name, strings + row->name, strlen(strings + row->name));
+    docset_sb_assign(&e->type, strings + row->type, strlen(strings + row->type));
+    docset_sb_assign(&e->parent, "", 0);
+    docset_sb_assign(&e->path, strings + row->path, strlen(strings + row->path));
+}
+
+/* Returns the type of the current entry, type_name is its type column
+ * value. */
+static DocSetEntryType cursor_type(DocSetCursor *c,
+                                   const char *type_name,
+                                   size_t len)
+{
+    if (c->rows) {
+        return c->rows->rows[c->next_row - 1].entry_type;
+    }
+    return docset_td_lookup(&c->conn->types, type_name, len);
+}
+
+/* Returns the current value of the column, NULL values are returned as
+ * empty strings. */
+static const char *cursor_column(DocSetCursor *c, int col, size_t *len)
+{
+    const char *s;
+
+    if (c->rows) {
+        const DocSetRow *row = c->rows->rows + (c->next_row - 1);
+        size_t offset = col == COL_NAME ? row->name
+                        : col == COL_TYPE ? row->type
+                        : row->path;
+
+        s = c->rows->strings.data + offset;
+        *len = strlen(s);
+        return s;
+    }
+
+    s = (const char *) sqlite3_column_text(c->stmt, col);
+    if (!s) {
+        *len = 0;
+        return "";
+    }
+    *len = (size_t) sqlite3_column_bytes(c->stmt, col);
+    return s;
+}
+
+static int batch_reserve(DocSetBatch *b, size_t n)
+{
+    size_t new_cap;
+
+    if (n <= b->capacity) {
+        return 1;
+    }
+
+    new_cap = b->capacity ? b->capacity * 2 : BATCH_INIT_SIZE;
+    if (new_cap < n) {
+        new_cap = n;
+    }
+
+#define BATCH_GROW(field) \
+    do { \
+        void *p = docset_realloc(b->field, new_cap * sizeof(*b->field)); \
+        if (!p) { \
+            return 0; \
+        } \
+        b->field = p; \
+    } while (0)
+
+    BATCH_GROW(ids);
+    BATCH_GROW(types);
+    BATCH_GROW(docsets);
+    BATCH_GROW(name_offsets);
+    BATCH_GROW(name_lengths);
+    BATCH_GROW(type_offsets);
+    BATCH_GROW(type_lengths);
+    BATCH_GROW(path_offsets);
+    BATCH_GROW(path_lengths);
+
+#undef BATCH_GROW
+
+    b->capacity = new_cap;
+    return 1;
+}
+
+static int batch_append(DocSetBatch *b,
+                        const char  *s,
+                        size_t       len,
+                        size_t      *offset)
+{
+    size_t need = b->strings_size + len + 1;
+
+    if (need > b->strings_capacity) {
+        size_t new_cap = b->strings_capacity
+                         ? b->strings_capacity * 2
+                         : BATCH_STRINGS_INIT_SIZE;
+        char *p;
+
+        while (new_cap < need) {
+            new_cap *= 2;
+        }
+        p = (char *) docset_realloc(b->strings, new_cap);
+        if (!p) {
+            return 0;
+        }
+        b->strings = p;
+        b->strings_capacity = new_cap;
+    }
+
+    *offset = b->strings_size;
+    memcpy(b->strings + b->strings_size, s, len);
+    b->strings[b->strings_size + len] = '\0';
+    b->strings_size = need;
+    return 1;
+}
+
+static int step_stmt(DocSetCursor *c)
+{
+    int timing = c->docset->step_timing;
+    double start = 0;
+    int rc;
+
+    if (timing) {
+        start = docset_clock_now();
+    }
+    rc = sqlite3_step(c->stmt);
+    if (timing) {
+        c->conn->stats.step_seconds += docset_clock_now() - start;
+    }
+
+    if (rc != SQLITE_ROW) {
+        if (rc != SQLITE_DONE) {
+            c->failed = 1;
+            report_error(c->docset, "Query execution error");
+        }
+        return 0;
+    }
+    c->conn->stats.rows_stepped++;
+    return 1;
+}
+
+static void assign_buffer_col(DocSetStats *stats,
+                              DocSetStringBuf *buf,
+                              sqlite3_stmt *stmt,
+                              int col)
+{
+    const char *text = (const char *)sqlite3_column_text(stmt, col);
+    size_t len = (size_t)sqlite3_column_bytes(stmt, col);
+    size_t capacity = buf->capacity;
+
+    docset_sb_assign(buf, text, len);
+
+    stats->bytes_copied += len;
+    if (buf->capacity != capacity) {
+        stats->buffer_reallocs++;
+    }
+}
 
 static int parse_props(DocSet *docset, const char *path)
 {
@@ -512,26 +2083,246 @@ static int parse_props(DocSet *docset, const char *path)
     props[3].target.bool_target = &is_dash;
     props[4].target.bool_target = &js_enabled;
 
-    result = docset_parse_properties(path, props, props + num_props);
+    result = docset_parse_properties(path, props, props + num_props);
+
+    if (is_dash) {
+        DOCSET_SET_FLAG(docset->flags, DOCSET_IS_DASH);
+    }
+    if (js_enabled) {
+        DOCSET_SET_FLAG(docset->flags, DOCSET_IS_JS_ENABLED);
+    }
+
+    return result;
+}
+
+/* Opens the index database and detects its kind. The database is not
+ * reopened after a failure. */
+static int connect_db(DocSet *docset)
+{
+    double start;
+
+    if (docset->conn.db) {
+        return docset->query_table != NULL;
+    }
+
+    start = docset_clock_now();
+    if (!open_db(docset, &docset->conn)) {
+        return 0;
+    }
+    docset->stats.open_db_seconds = docset_clock_now() - start;
+
+    start = docset_clock_now();
+    if (!set_query_table(docset)) {
+        return 0;
+    }
+    docset->stats.open_schema_seconds = docset_clock_now() - start;
+
+    /* The first connection of a concurrent docset becomes pooled. */
+    if (docset->lock) {
+        docset->idle_conns = &docset->conn;
+    }
+    return 1;
+}
+
+/* Opens the database connection according to the docset options. */
+static int open_db(DocSet *docset, DocSetConn *conn)
+{
+    const DocSetOpenOptions *options = &docset->options;
+    const char *path = docset->flat_path ? docset->flat_path
+                                         : docset->db_path;
+    char pragma[64];
+    char *uri = NULL;
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+    int ok;
+
+    if (options->flags & (DOCSET_OPEN_READ_ONLY | DOCSET_OPEN_IMMUTABLE
+                          | DOCSET_OPEN_CONCURRENT)) {
+        flags = SQLITE_OPEN_READONLY;
+    }
+    /* A pooled connection is used by a single cursor at a time. */
+    if (options->flags & (DOCSET_OPEN_NO_MUTEX | DOCSET_OPEN_CONCURRENT)) {
+        flags |= SQLITE_OPEN_NOMUTEX;
+    }
+    if (options->flags & DOCSET_OPEN_IMMUTABLE) {
+        if (!(uri = file_uri(path, "?immutable=1"))) {
+            return 0;
+        }
+        flags |= SQLITE_OPEN_URI;
+    }
+
+    ok = sqlite3_open_v2(uri ? uri : path, &conn->db, flags, NULL)
+         == SQLITE_OK;
+    docset_free(uri);
+
+    if (ok && options->mmap_size) {
+        sprintf(pragma, "pragma mmap_size=%lu", options->mmap_size);
+        ok = sqlite3_exec(conn->db, pragma, NULL, NULL, NULL) == SQLITE_OK;
+    }
+    if (ok && options->cache_size) {
+        sprintf(pragma, "pragma cache_size=%ld", options->cache_size);
+        ok = sqlite3_exec(conn->db, pragma, NULL, NULL, NULL) == SQLITE_OK;
+    }
+    if (ok && options->temp_store != DOCSET_TEMP_STORE_DEFAULT) {
+        sprintf(pragma, "pragma temp_store=%d", (int)options->temp_store);
+        ok = sqlite3_exec(conn->db, pragma, NULL, NULL, NULL) == SQLITE_OK;
+    }
+    return ok;
+}
+
+/* Builds an SQLite URI for the path escaping the characters that have a
+ * special meaning in URIs. */
+static char *file_uri(const char *path, const char *query)
+{
+    static const char HEX[] = "0123456789ABCDEF";
+    size_t len = strlen(path);
+    char *uri = (char *)
+        docset_malloc(sizeof("file://") + 3 * len + strlen(query));
+    char *out = uri;
+
+    if (!uri) {
+        return NULL;
+    }
+
+    strcpy(out, path[0] == '/' ? "file://" : "file:");
+    out += strlen(out);
+
+    for (; *path; ++path) {
+        if (*path == '%' || *path == '?' || *path == '#') {
+            *out++ = '%';
+            *out++ = HEX[(unsigned char)*path >> 4];
+            *out++ = HEX[(unsigned char)*path & 0xF];
+        } else {
+            *out++ = *path;
+        }
+    }
+    strcpy(out, query);
+    return uri;
+}
+
+static int ensure_db(DocSet *docset)
+{
+    int ok;
+
+    docset_mutex_lock(docset->lock);
+    ok = docset->query_table != NULL || connect_db(docset);
+    docset_mutex_unlock(docset->lock);
+
+    if (!ok) {
+        report_error(docset, "Can't open the index database");
+    }
+    return ok;
+}
+
+static int close_conn(DocSetConn *conn)
+{
+    int ret_code;
+
+    clear_stmt_cache(conn);
+    docset_td_clear(&conn->types);
+    ret_code = sqlite3_close(conn->db);
+    conn->db = NULL;
+    return ret_code;
+}
+
+/* Closes the main connection and the pooled ones, no cursors must be
+ * alive. */
+static int close_all_conns(DocSet *docset)
+{
+    DocSetConn *conn;
+    int ret_code = SQLITE_OK;
+
+    while ((conn = docset->idle_conns)) {
+        docset->idle_conns = conn->next;
+        if (close_conn(conn) != SQLITE_OK) {
+            ret_code = SQLITE_ERROR;
+        }
+        if (conn != &docset->conn) {
+            docset_free(conn);
+        }
+    }
+    if (close_conn(&docset->conn) != SQLITE_OK) {
+        ret_code = SQLITE_ERROR;
+    }
+    return ret_code;
+}
+
+/* Returns the connection for a new cursor. A concurrent docset takes an
+ * idle connection from the pool or opens a new one, other docsets have
+ * a single connection. */
+static DocSetConn *take_conn(DocSet *docset)
+{
+    DocSetConn *conn;
+
+    if (!docset->lock) {
+        return &docset->conn;
+    }
+    if (!ensure_db(docset)) {
+        return NULL;
+    }
+
+    docset_mutex_lock(docset->lock);
+    if ((conn = docset->idle_conns)) {
+        docset->idle_conns = conn->next;
+    }
+    docset_mutex_unlock(docset->lock);
 
-    if (is_dash) {
-        DOCSET_SET_FLAG(docset->flags, DOCSET_IS_DASH);
+    if (conn) {
+        return conn;
     }
-    if (js_enabled) {
-        DOCSET_SET_FLAG(docset->flags, DOCSET_IS_JS_ENABLED);
+
+    if (!(conn = (DocSetConn *) docset_calloc(1, sizeof(*conn)))) {
+        report_no_mem(docset);
+        return NULL;
+    }
+    if (!open_db(docset, conn)) {
+        close_conn(conn);
+        docset_free(conn);
+        report_error(docset, "Can't open the index database");
+        return NULL;
     }
+    return conn;
+}
 
-    return result;
+static void give_conn(DocSet *docset, DocSetConn *conn)
+{
+    if (!docset->lock || !conn) {
+        return;
+    }
+
+    docset_mutex_lock(docset->lock);
+    add_stats(&docset->stats, &conn->stats);
+    memset(&conn->stats, 0, sizeof(conn->stats));
+    conn->next = docset->idle_conns;
+    docset->idle_conns = conn;
+    docset_mutex_unlock(docset->lock);
+}
+
+static void add_stats(DocSetStats *sum, const DocSetStats *stats)
+{
+    sum->open_plist_seconds += stats->open_plist_seconds;
+    sum->open_db_seconds += stats->open_db_seconds;
+    sum->open_schema_seconds += stats->open_schema_seconds;
+    sum->stmts_prepared += stats->stmts_prepared;
+    sum->stmts_reused += stats->stmts_reused;
+    sum->prepare_seconds += stats->prepare_seconds;
+    sum->rows_stepped += stats->rows_stepped;
+    sum->step_seconds += stats->step_seconds;
+    sum->bytes_copied += stats->bytes_copied;
+    sum->buffer_reallocs += stats->buffer_reallocs;
+    sum->result_cache_hits += stats->result_cache_hits;
+    sum->result_cache_misses += stats->result_cache_misses;
+    sum->document_cache_hits += stats->document_cache_hits;
+    sum->document_cache_misses += stats->document_cache_misses;
 }
 
 static int set_query_table(DocSet *docset)
 {
-    if (count_tables(docset->db, "searchIndex")) {
+    if (count_tables(docset->conn.db, "searchIndex")) {
         docset->query_table = &dash_query_table;
         return 1;
     }
 
-    if (count_tables(docset->db, "ZTOKEN")) {
+    if (count_tables(docset->conn.db, "ZTOKEN")) {
         docset->query_table = &zdash_query_table;
         return 1;
     }
@@ -539,39 +2330,634 @@ static int set_query_table(DocSet *docset)
     return 0;
 }
 
+static DocSetCursor *new_cursor(DocSet *docset)
+{
+    DocSetConn *conn = NULL;
+    DocSetCursor *c;
+
+    if (docset && !(conn = take_conn(docset))) {
+        return NULL;
+    }
+
+    c = reuse_cursor(docset);
+    if (!c) {
+        if (docset) {
+            give_conn(docset, conn);
+        }
+        return NULL;
+    }
+
+    c->conn = conn;
+    return c;
+}
+
+/* Returns the spare cursor of the docset or a new cursor, in both cases
+ * without a connection. */
+static DocSetCursor *reuse_cursor(DocSet *docset)
+{
+    DocSetCursor *c = NULL;
+
+    if (docset) {
+        docset_mutex_lock(docset->lock);
+        c = docset->spare_cursor;
+        docset->spare_cursor = NULL;
+        docset_mutex_unlock(docset->lock);
+    }
+
+    if (!c) {
+        c = (DocSetCursor *) docset_calloc(1, sizeof(*c));
+        if (!c || !init_entry(&c->entry)) {
+            docset_free(c);
+            report_no_mem(docset);
+            return NULL;
+        }
+    }
+
+    c->docset = docset;
+    c->conn = NULL;
+    c->stmt = NULL;
+    c->finished = 0;
+    c->failed = 0;
+    c->columns = DOCSET_COL_ALL;
+    c->by_ids = 0;
+    c->ids = NULL;
+    c->num_ids = 0;
+    c->next_id = 0;
+    c->chunk_size = 0;
+    c->chunk_active = 0;
+    c->has_types = 0;
+    c->rows = NULL;
+    c->rows_in_arena = 0;
+    c->shared_rows = NULL;
+    c->cached_query = 0;
+    c->sources = NULL;
+    c->next_row = 0;
+    return c;
+}
+
+/* Returns a cursor that traverses the rows and takes over the reference
+ * of the caller. */
+static DocSetCursor *adopt_rows(DocSet *docset, DocSetSharedRows *rows)
+{
+    DocSetCursor *c = reuse_cursor(docset);
+
+    if (!c) {
+        docset_release_rows(docset, rows);
+        return NULL;
+    }
+
+    c->rows = &rows->rows;
+    c->shared_rows = rows;
+    return c;
+}
+
+/* Releases the result set the cursor traverses. */
+static void release_rows(DocSetCursor *c)
+{
+    if (c->shared_rows) {
+        docset_release_rows(c->docset, c->shared_rows);
+    } else if (c->rows && !c->rows_in_arena) {
+        docset_rows_destroy(c->rows);
+        docset_free(c->rows);
+    }
+    c->rows = NULL;
+    c->rows_in_arena = 0;
+    c->shared_rows = NULL;
+}
+
+static void free_cursor(DocSetCursor *c)
+{
+    if (c) {
+        dispose_entry(&c->entry);
+        docset_free(c);
+    }
+}
+
 static DocSetCursor *cursor_for_query(DocSet *docset,
-                                      const char *query,
-                                      int len)
+                                      QueryShape shape,
+                                      unsigned columns)
 {
-    sqlite3_stmt *stmt = NULL;
-    DocSetCursor *c = (DocSetCursor *) calloc(1, sizeof(*c));
+    DocSetCursor *c = new_cursor(docset);
 
     if (!c) {
-        report_no_mem(docset);
         return NULL;
     }
 
-    if (!init_entry(&c->entry)) {
-        free(c);
+    c->columns = columns;
+    if (!cursor_set_query(c, shape, 0)) {
+        docset_cursor_dispose(c);
+        return NULL;
+    }
+
+    return c;
+}
+
+/* Makes cursor execute the query of given shape, the current cursor
+ * statement is reused if it has the same shape. */
+static int cursor_set_query(DocSetCursor *c,
+                            QueryShape shape,
+                            unsigned num_params)
+{
+    c->finished = 0;
+    c->failed = 0;
+    if (c->stmt && c->stmt_key == QUERY_KEY(shape, c->columns, num_params)) {
+        c->conn->stats.stmts_reused++;
+        sqlite3_reset(c->stmt);
+        sqlite3_clear_bindings(c->stmt);
+        return 1;
+    }
+
+    release_stmt(c->conn, c->stmt_key, c->stmt);
+    c->stmt = acquire_stmt(c->docset, c->conn, shape, c->columns, num_params,
+                           &c->stmt_key);
+
+    return c->stmt != NULL;
+}
+
+static int cursor_set_pattern(DocSetCursor *c, const char *pattern)
+{
+    DocSet *docset = c->docset;
+    int found;
+
+    docset_free(c->ids);
+    c->by_ids = 0;
+    c->ids = NULL;
+    c->num_ids = 0;
+    c->next_id = 0;
+    c->chunk_size = 0;
+
+    if (docset->use_name_index) {
+        found = cursor_set_index(c, pattern);
+        if (found) {
+            return found > 0;
+        }
+    }
+
+    if (!cursor_set_typed_query(c, QUERY_NAME_LIKE, QUERY_NAME_LIKE_TYPED)) {
+        return 0;
+    }
+
+    sqlite3_bind_text(c->stmt, 1, pattern, -1, SQLITE_TRANSIENT);
+    return 1;
+}
+
+/* Sets the query of the shape or of its typed variant if the cursor
+ * filters types, the type names are bound after the first parameter. */
+static int cursor_set_typed_query(DocSetCursor *c,
+                                  QueryShape shape,
+                                  QueryShape typed_shape)
+{
+    const char *names[DOCSET_MAX_TYPE_NAMES];
+    size_t i, n;
+
+    if (!c->has_types) {
+        return cursor_set_query(c, shape, 0);
+    }
+
+    n = docset_type_names(&c->types, names);
+    if (!cursor_set_query(c, typed_shape, (unsigned)n)) {
+        return 0;
+    }
+    for (i = 0; i < n; ++i) {
+        sqlite3_bind_text(c->stmt, (int)i + 2, names[i], -1, SQLITE_STATIC);
+    }
+    return 1;
+}
+
+/* Returns 0 if the pattern can't be answered by the name index, in
+ * that case the caller should fall back to the database query. */
+static int cursor_set_index(DocSetCursor *c, const char *pattern)
+{
+    DocSet *docset = c->docset;
+    DocSetEntryId *ids;
+    size_t num_ids;
+
+    DocSetNameIndex *index = get_name_index(docset);
+
+    if (!index || docset_ni_lookup(index, pattern, &ids, &num_ids) <= 0) {
+        return 0;
+    }
+
+    if (!cursor_set_typed_query(c, QUERY_BY_ID, QUERY_BY_ID_TYPED)) {
+        docset_free(ids);
+        return -1;
+    }
+
+    c->by_ids = 1;
+    c->ids = ids;
+    c->num_ids = num_ids;
+    return 1;
+}
+
+/* Makes the cursor look up the ids in ascending order chunk by chunk,
+ * see step_chunks(). */
+static int cursor_set_ids(DocSetCursor *c,
+                          const DocSetEntryId *ids,
+                          size_t num_ids)
+{
+    size_t i, n, chunk = IDS_MIN_CHUNK;
+
+    c->ids = (DocSetEntryId *) docset_malloc(num_ids * sizeof(*c->ids));
+    if (!c->ids) {
+        report_no_mem(c->docset);
+        return 0;
+    }
+
+    memcpy(c->ids, ids, num_ids * sizeof(*c->ids));
+    qsort(c->ids, num_ids, sizeof(*c->ids), compare_ids);
+
+    for (i = 1, n = 1; i < num_ids; ++i) {
+        if (c->ids[i] != c->ids[n - 1]) {
+            c->ids[n++] = c->ids[i];
+        }
+    }
+
+    while (chunk < n && chunk < IDS_MAX_CHUNK) {
+        chunk *= 2;
+    }
+
+    if (!cursor_set_query(c, QUERY_BY_IDS, (unsigned)chunk)) {
+        return 0;
+    }
+
+    c->by_ids = 1;
+    c->num_ids = n;
+    c->next_id = 0;
+    c->chunk_size = chunk;
+    c->chunk_active = 0;
+    return 1;
+}
+
+static int compare_ids(const void *a, const void *b)
+{
+    DocSetEntryId x = *(const DocSetEntryId *)a;
+    DocSetEntryId y = *(const DocSetEntryId *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Turns the cursor into a materialized result set of the topk
+ * entries ordered by rank. */
+static int cursor_set_topk(DocSetCursor *c, DocSetTopK *topk)
+{
+    DocSetRows *rows;
+    DocSetRow *row;
+    size_t i;
+
+    rows = (DocSetRows *) docset_malloc(sizeof(*rows));
+    if (!rows || !docset_rows_init(rows)) {
+        docset_free(rows);
+        report_no_mem(c->docset);
+        return 0;
+    }
+
+    docset_topk_sort_by_id(topk);
+
+    docset_free(c->ids);
+    c->ids = NULL;
+    c->by_ids = 0;
+
+    if (topk->size > 0) {
+        c->ids = (DocSetEntryId *) docset_malloc(topk->size * sizeof(*c->ids));
+        if (!c->ids) {
+            goto fail_no_mem;
+        }
+        for (i = 0; i < topk->size; ++i) {
+            c->ids[i] = topk->items[i].id;
+        }
+        c->num_ids = topk->size;
+        c->next_id = 0;
+        c->by_ids = 1;
+
+        if (!cursor_set_query(c, QUERY_BY_ID, 0)) {
+            goto fail;
+        }
+
+        while (docset_cursor_step(c)) {
+            row = docset_rows_append(rows, docset_cursor_entry(c));
+            if (!row) {
+                goto fail_no_mem;
+            }
+            row->rank = docset_topk_rank(topk, row->id);
+        }
+
+        docset_free(c->ids);
+        c->ids = NULL;
+        c->by_ids = 0;
+    }
+
+    release_stmt(c->conn, c->stmt_key, c->stmt);
+    c->stmt = NULL;
+
+    docset_rows_sort_by_rank(rows);
+    c->rows = rows;
+    return 1;
+
+fail_no_mem:
+    report_no_mem(c->docset);
+fail:
+    docset_rows_destroy(rows);
+    docset_free(rows);
+    return 0;
+}
+
+/* Loads or builds the name index on first use. Threads of a concurrent
+ * docset may build it simultaneously, the first built index wins. */
+static DocSetNameIndex *get_name_index(DocSet *docset)
+{
+    DocSetNameIndex *index;
+    DocSetConn *conn;
+    int failed;
+
+    docset_mutex_lock(docset->lock);
+    index = docset->name_index;
+    failed = docset->name_index_failed;
+    docset_mutex_unlock(docset->lock);
+
+    if (index || failed) {
+        return index;
+    }
+
+    if (docset->index_file) {
+        index = docset_if_load(docset->index_file, docset->db_path);
+    }
+
+    if (!index) {
+        if (!ensure_db(docset) || !(conn = take_conn(docset))) {
+            goto fail;
+        }
+        index = docset_ni_build(conn->db, docset->query_table->names_query);
+        give_conn(docset, conn);
+
+        if (!index) {
+            report_error(docset, "Can't build the name index");
+            goto fail;
+        }
+
+        /* A stale or missing index file is replaced by the fresh
+         * index. */
+        if (docset->index_file
+            && !docset_if_save(index, docset->index_file, docset->db_path)) {
+            report_error(docset, "Can't save the name index file");
+        }
+    }
+
+    docset_mutex_lock(docset->lock);
+    if (docset->name_index) {
+        docset_ni_free(index);
+        index = docset->name_index;
+    } else {
+        docset->name_index = index;
+    }
+    docset_mutex_unlock(docset->lock);
+    return index;
+
+fail:
+    docset_mutex_lock(docset->lock);
+    docset->name_index_failed = 1;
+    docset_mutex_unlock(docset->lock);
+    return NULL;
+}
+
+static sqlite3_stmt *acquire_stmt(DocSet *docset,
+                                  DocSetConn *conn,
+                                  QueryShape shape,
+                                  unsigned columns,
+                                  unsigned num_params,
+                                  unsigned *key)
+{
+    DocSetStringBuf buf;
+    sqlite3_stmt *stmt;
+
+    *key = QUERY_KEY(shape, columns, num_params);
+
+    if (!ensure_db(docset)) {
+        return NULL;
+    }
+
+    if ((stmt = take_cached_stmt(conn, *key))) {
+        conn->stats.stmts_reused++;
+        return stmt;
+    }
+
+    if (shape == QUERY_COUNT) {
+        return prepare_stmt(docset, conn, docset->query_table->count_query);
+    }
+
+    if (!docset_sb_init(&buf, BUF_INIT_SIZE * 4 + num_params * 2)) {
         report_no_mem(docset);
         return NULL;
     }
 
-    if (sqlite3_prepare_v2(docset->db, query, len, &stmt, NULL) != SQLITE_OK) {
-        docset_cursor_dispose(c);
+    if (build_query(&buf, docset->query_table, shape, columns, num_params)) {
+        stmt = prepare_stmt(docset, conn, buf.data);
+    } else {
+        report_no_mem(docset);
+    }
+
+    docset_sb_destroy(&buf);
+    return stmt;
+}
+
+static int build_query(DocSetStringBuf *buf,
+                       const QueryTable *t,
+                       QueryShape shape,
+                       unsigned columns,
+                       unsigned num_params)
+{
+    const char *sep = " where ";
+    unsigned i;
+    int ok;
+
+    ok = docset_sb_append(buf, "select ")
+         && docset_sb_append(buf, t->columns[COL_ID]);
+
+    for (i = COL_NAME; i < NUM_COLUMNS; ++i) {
+        ok = ok
+             && docset_sb_append(buf, ", ")
+             && docset_sb_append(buf, (columns & COLUMN_FLAG(i))
+                                      ? t->columns[i]
+                                      : "null");
+    }
+
+    ok = ok
+         && docset_sb_append(buf, " from ")
+         && docset_sb_append(buf, t->from);
+
+    for (i = COL_NAME; i < NUM_COLUMNS; ++i) {
+        if (t->joins[i] && (columns & COLUMN_FLAG(i))) {
+            ok = ok && docset_sb_append(buf, t->joins[i]);
+        }
+    }
+
+    switch (shape) {
+    case QUERY_NAME_LIKE:
+    case QUERY_NAME_LIKE_TYPED:
+        ok = ok
+             && docset_sb_append(buf, sep)
+             && docset_sb_append(buf, t->columns[COL_NAME])
+             && docset_sb_append(buf, " like ?");
+        sep = " and ";
+        break;
+    case QUERY_BY_ID:
+    case QUERY_BY_ID_TYPED:
+        ok = ok
+             && docset_sb_append(buf, sep)
+             && docset_sb_append(buf, t->columns[COL_ID])
+             && docset_sb_append(buf, " = ?");
+        sep = " and ";
+        break;
+    case QUERY_BY_IDS:
+        ok = ok
+             && docset_sb_append(buf, sep)
+             && docset_sb_append(buf, t->columns[COL_ID])
+             && docset_sb_append(buf, " in (")
+             && append_params(buf, num_params)
+             && docset_sb_append(buf, ")");
+        sep = " and ";
+        break;
+    default:
+        break;
+    }
+
+    if (shape == QUERY_NAME_LIKE_TYPED || shape == QUERY_BY_ID_TYPED) {
+        ok = ok
+             && docset_sb_append(buf, sep)
+             && docset_sb_append(buf, t->type_filter[0])
+             && append_params(buf, num_params)
+             && docset_sb_append(buf, t->type_filter[1]);
+        sep = " and ";
+    }
+
+    for (i = COL_NAME; i < NUM_COLUMNS; ++i) {
+        if (t->filters[i] && !(columns & COLUMN_FLAG(i))) {
+            ok = ok
+                 && docset_sb_append(buf, sep)
+                 && docset_sb_append(buf, t->filters[i]);
+            sep = " and ";
+        }
+    }
+
+    if (shape != QUERY_BY_ID && shape != QUERY_BY_ID_TYPED) {
+        ok = ok
+             && docset_sb_append(buf, " order by ")
+             && docset_sb_append(buf, t->columns[COL_ID]);
+    }
+
+    return ok;
+}
+
+/* Appends the comma separated list of n parameters. */
+static int append_params(DocSetStringBuf *buf, unsigned n)
+{
+    unsigned i;
+    int ok = 1;
+
+    for (i = 0; ok && i < n; ++i) {
+        ok = docset_sb_append(buf, i > 0 ? ",?" : "?");
+    }
+    return ok;
+}
+
+static sqlite3_stmt *take_cached_stmt(DocSetConn *conn, unsigned key)
+{
+    sqlite3_stmt *stmt;
+    size_t i;
+
+    for (i = 0; i < conn->num_cached; ++i) {
+        if (conn->stmt_cache[i].key == key) {
+            stmt = conn->stmt_cache[i].stmt;
+            conn->stmt_cache[i] = conn->stmt_cache[--conn->num_cached];
+            return stmt;
+        }
+    }
+    return NULL;
+}
+
+static sqlite3_stmt *prepare_stmt(DocSet *docset,
+                                  DocSetConn *conn,
+                                  const char *query)
+{
+    sqlite3_stmt *stmt = NULL;
+    double start = docset_clock_now();
+    int rc;
+
+    rc = sqlite3_prepare_v2(conn->db, query, -1, &stmt, NULL);
+    conn->stats.prepare_seconds += docset_clock_now() - start;
+
+    if (rc != SQLITE_OK) {
+        sqlite3_finalize(stmt);
         report_error(docset, "Can't prepare a query");
         return NULL;
     }
+    conn->stats.stmts_prepared++;
+    return stmt;
+}
+
+/* Puts the statement back to the cache evicting the least recently
+ * used one if the cache is full. */
+static int release_stmt(DocSetConn *conn, unsigned key, sqlite3_stmt *stmt)
+{
+    CachedStmt *slot;
+    size_t i;
+    int ret_code;
+
+    if (!stmt) {
+        return SQLITE_OK;
+    }
 
-    c->docset = docset;
-    c->stmt = stmt;
-    return c;
+    ret_code = sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    if (!conn) {
+        sqlite3_finalize(stmt);
+        return ret_code;
+    }
+
+    if (conn->num_cached < STMT_CACHE_SIZE) {
+        slot = conn->stmt_cache + conn->num_cached++;
+    } else {
+        slot = conn->stmt_cache;
+        for (i = 1; i < conn->num_cached; ++i) {
+            if (conn->stmt_cache[i].last_use < slot->last_use) {
+                slot = conn->stmt_cache + i;
+            }
+        }
+        sqlite3_finalize(slot->stmt);
+    }
+
+    slot->key = key;
+    slot->stmt = stmt;
+    slot->last_use = ++conn->stmt_clock;
+    return ret_code;
+}
+
+static void clear_stmt_cache(DocSetConn *conn)
+{
+    size_t i;
+
+    for (i = 0; i < conn->num_cached; ++i) {
+        sqlite3_finalize(conn->stmt_cache[i].stmt);
+    }
+    conn->num_cached = 0;
 }
 
 static void report_error(DocSet *docset, const char *msg)
 {
-    if (docset && docset->err_handler) {
-        docset->err_handler(docset->err_context, msg);
+    docset_err_handler handler;
+    void *ctx;
+
+    if (!docset) {
+        return;
+    }
+
+    docset_mutex_lock(docset->lock);
+    handler = docset->err_handler;
+    ctx = docset->err_context;
+    docset_mutex_unlock(docset->lock);
+
+    if (handler) {
+        handler(ctx, msg);
     }
 }
 
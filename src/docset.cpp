@@ -1,9 +1,58 @@
 #include <docset.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <utility>
 
 namespace docset
 {
 
+namespace
+{
+
+const std::size_t collect_batch_size = 1024;
+
+// Batches a stream fetches ahead of its consumer.
+const std::size_t max_pending_batches = 4;
+
+static_assert(type_by_name("Attribute") == ::DOCSET_TYPE_ATTRIBUTE
+              && type_by_name("Variable") == ::DOCSET_TYPE_VARIABLE
+              && type_by_name("tdef") == ::DOCSET_TYPE_TYPE
+              && type_by_name("function") == ::DOCSET_TYPE_UNKNOWN,
+              "type_by_name() must agree with DOCSET_TYPE_NAMES");
+
+struct batch_holder
+{
+    ::DocSetBatch batch;
+
+    batch_holder() { ::docset_batch_init(&batch); }
+    ~batch_holder() { ::docset_batch_destroy(&batch); }
+};
+
+// Disposed cursors return their statements to the docset, so a cursor
+// must keep its docset (or library) alive.
+struct cursor_deleter
+{
+    std::shared_ptr<void> owner;
+
+    void operator()(::DocSetCursor *cursor) const
+    {
+        ::docset_cursor_dispose(cursor);
+    }
+};
+
+// Cursors stop at a failure as they do at the end of the result set,
+// a cursor that could not be created is a failure too.
+void check_cursor(::DocSetCursor *cursor)
+{
+    if (!cursor || ::docset_cursor_failed(cursor)) {
+        throw error("Query execution error");
+    }
+}
+
+}
+
 // Error
 
 error::error(const char *text) throw()
@@ -17,9 +66,22 @@ doc_set::doc_set(const char *dirname)
 {}
 
 doc_set::doc_set(std::string dirname)
+    : doc_set(std::move(dirname), 0)
+{}
+
+doc_set::doc_set(std::string dirname, unsigned flags)
+    : basedir_(std::move(dirname))
+{
+    ::DocSetOpenOptions options;
+    ::docset_open_options_init(&options);
+    options.flags = flags;
+    init(basedir_.c_str(), options);
+}
+
+doc_set::doc_set(std::string dirname, const ::DocSetOpenOptions &options)
     : basedir_(std::move(dirname))
 {
-    init(basedir_.c_str());
+    init(basedir_.c_str(), options);
 }
 
 std::size_t doc_set::count() const
@@ -42,36 +104,461 @@ const char *doc_set::bundle_identifier() const
     return ::docset_bundle_identifier(docset_.get());
 }
 
+const char *doc_set::documents_path() const
+{
+    return ::docset_documents_path(docset_.get());
+}
+
+document doc_set::open_document(const entry &e) const
+{
+    return document(docset_, e.path().c_str());
+}
+
+document doc_set::open_document(const entry_view &e) const
+{
+    return document(docset_, e.path().data());
+}
+
 iterator doc_set::begin() const
 {
-    return iterator(::docset_list_entries(docset_.get()));
+    return iterator(wrap(::docset_list_entries(docset_.get())));
 }
 
 entry_range doc_set::find(const char *query) const
 {
-    return entry_range(docset_find(docset_.get(), query));
+    return entry_range(wrap(::docset_find(docset_.get(), query)));
 }
 
 entry_range doc_set::find(const std::string& query) const
 {
-    return entry_range(docset_find(docset_.get(), query.c_str()));
+    return find(query.c_str());
+}
+
+entry_range doc_set::find(const std::string &query, unsigned columns) const
+{
+    return entry_range(
+        wrap(::docset_find_ex(docset_.get(), query.c_str(), columns)));
+}
+
+entry_range doc_set::find(const std::string &query,
+                          const std::set<::DocSetEntryType> &types) const
+{
+    ::DocSetTypeMask mask;
+    ::docset_type_mask_clear(&mask);
+    for (::DocSetEntryType t : types) {
+        ::docset_type_mask_add(&mask, t);
+    }
+    return entry_range(
+        wrap(::docset_find_typed(docset_.get(), query.c_str(), &mask)));
 }
 
 entry_range doc_set::find_by_ids(const std::vector<entry::id_type> &ids) const
 {
-    return entry_range(docset_find_by_ids(docset_.get(), &ids[0], ids.size()));
+    return entry_range(
+        wrap(::docset_find_by_ids(docset_.get(), &ids[0], ids.size())));
+}
+
+entry_range doc_set::find_top(const std::string &query, std::size_t k) const
+{
+    return entry_range(
+        wrap(::docset_find_top(docset_.get(), query.c_str(), k)));
+}
+
+std::future<std::vector<entry>>
+doc_set::find_async(const std::string &query, executor &ex) const
+{
+    typedef std::promise<std::vector<entry>> promise_type;
+
+    auto promise = std::make_shared<promise_type>();
+    auto result = promise->get_future();
+    doc_set self(*this);
+
+    ex.post([self, query, promise] {
+        try {
+            std::vector<entry> entries;
+            self.find(query).collect_into(entries);
+            promise->set_value(std::move(entries));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return result;
+}
+
+entry_stream
+doc_set::find_stream(const std::string &query, executor &ex,
+                     std::size_t batch_size) const
+{
+    auto ch = std::make_shared<entry_stream::channel>();
+    doc_set self(*this);
+
+    if (batch_size == 0) {
+        batch_size = collect_batch_size;
+    }
+    ex.post([self, query, ch, batch_size] {
+        entry_stream::produce(
+            ch, self.wrap(::docset_find(self.docset_.get(), query.c_str())),
+            batch_size);
+    });
+    return entry_stream(ch);
+}
+
+void doc_set::set_cache_dir(const std::string &dir)
+{
+    ::DocSetError err = ::docset_set_cache_dir(docset_.get(), dir.c_str());
+    if (err != ::DOCSET_OK) {
+        throw error(::docset_error_string(err));
+    }
+}
+
+void doc_set::flatten()
+{
+    ::DocSetError err = ::docset_flatten(docset_.get());
+    if (err != ::DOCSET_OK) {
+        throw error(::docset_error_string(err));
+    }
+}
+
+void doc_set::set_result_cache(std::size_t max_bytes)
+{
+    ::DocSetError err = ::docset_set_result_cache(docset_.get(), max_bytes);
+    if (err != ::DOCSET_OK) {
+        throw error(::docset_error_string(err));
+    }
+}
+
+void doc_set::set_type_weight(::DocSetEntryType type, unsigned weight)
+{
+    ::docset_set_type_weight(docset_.get(), type, weight);
 }
 
-void doc_set::init(const char *dirname)
+::DocSetStats doc_set::stats() const
+{
+    ::DocSetStats result;
+    ::docset_get_stats(docset_.get(), &result);
+    return result;
+}
+
+void doc_set::reset_stats()
+{
+    ::docset_reset_stats(docset_.get());
+}
+
+std::shared_ptr<::DocSetCursor> doc_set::wrap(::DocSetCursor *cursor) const
+{
+    return std::shared_ptr<::DocSetCursor>(cursor, cursor_deleter{docset_});
+}
+
+void doc_set::init(const char *dirname, const ::DocSetOpenOptions &options)
 {
     ::DocSet *ds;
-    ::DocSetError err = ::docset_try_open(&ds, dirname);
+    ::DocSetError err = ::docset_open_ex(&ds, dirname, &options);
     if (err != ::DOCSET_OK) {
         throw error(::docset_error_string(err));
     }
     docset_ = std::shared_ptr<::DocSet>(ds, ::docset_close);
 }
 
+// Library
+
+library::library(unsigned num_threads)
+{
+    ::DocSetLibrary *lib;
+    ::DocSetError err = ::docset_library_create(&lib, num_threads);
+    if (err != ::DOCSET_OK) {
+        throw error(::docset_error_string(err));
+    }
+    library_ = std::shared_ptr<::DocSetLibrary>(lib, ::docset_library_close);
+}
+
+void library::add(const char *dirname)
+{
+    ::DocSetError err = ::docset_library_add(library_.get(), dirname);
+    if (err != ::DOCSET_OK) {
+        throw error(::docset_error_string(err));
+    }
+}
+
+void library::add(const std::string &dirname)
+{
+    add(dirname.c_str());
+}
+
+std::size_t library::size() const
+{
+    return ::docset_library_size(library_.get());
+}
+
+entry_range library::find(const char *query, ::DocSetOrder order) const
+{
+    ::DocSetCursor *c = ::docset_library_find(library_.get(), query, order);
+    return entry_range(
+        std::shared_ptr<::DocSetCursor>(c, cursor_deleter{library_}));
+}
+
+entry_range library::find(const std::string &query, ::DocSetOrder order) const
+{
+    return find(query.c_str(), order);
+}
+
+// Search session
+
+search_session::search_session(const doc_set &docset)
+{
+    std::shared_ptr<::DocSet> ds = docset.docset_;
+    ::DocSetSearchSession *session;
+    ::DocSetError err = ::docset_session_create(&session, ds.get());
+    if (err != ::DOCSET_OK) {
+        throw error(::docset_error_string(err));
+    }
+    // The session must not outlive its docset.
+    session_ = std::shared_ptr<::DocSetSearchSession>(
+        session, [ds](::DocSetSearchSession *s) {
+            ::docset_session_close(s);
+        });
+}
+
+entry_range search_session::find(const std::string &query)
+{
+    ::DocSetCursor *c = ::docset_session_find(session_.get(), query.c_str());
+    return entry_range(
+        std::shared_ptr<::DocSetCursor>(c, cursor_deleter{session_}));
+}
+
+// Document
+
+document::document(std::shared_ptr<::DocSet> docset, const char *path)
+    : docset_(std::move(docset))
+{
+    ::DocSetError err = ::docset_open_document_path(docset_.get(), path,
+                                                    &doc_);
+    if (err != ::DOCSET_OK) {
+        throw error(::docset_error_string(err));
+    }
+}
+
+document::document(document &&rhs)
+    : docset_(std::move(rhs.docset_)), doc_(rhs.doc_)
+{
+    rhs.doc_.mapping = nullptr;
+}
+
+document &document::operator=(document &&rhs)
+{
+    if (this != &rhs) {
+        ::docset_close_document(&doc_);
+        docset_ = std::move(rhs.docset_);
+        doc_ = rhs.doc_;
+        rhs.doc_.mapping = nullptr;
+    }
+    return *this;
+}
+
+document::~document()
+{
+    ::docset_close_document(&doc_);
+}
+
+// Thread pool executor
+
+struct thread_pool_executor::state
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (;;) {
+            cond.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+};
+
+thread_pool_executor::thread_pool_executor(unsigned num_threads)
+    : state_(new state)
+{
+    if (num_threads == 0) {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+    for (unsigned i = 0; i < num_threads; ++i) {
+        state_->threads.emplace_back(&state::work, state_.get());
+    }
+}
+
+thread_pool_executor::~thread_pool_executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->stopping = true;
+    }
+    state_->cond.notify_all();
+    for (std::thread &t : state_->threads) {
+        t.join();
+    }
+}
+
+void thread_pool_executor::post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->tasks.push_back(std::move(task));
+    }
+    state_->cond.notify_one();
+}
+
+// Entry stream
+
+// Batches travel from the executor thread to the consumer, the producer
+// waits while max_pending_batches are not consumed yet.
+struct entry_stream::channel
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::vector<entry>> batches;
+    std::exception_ptr failure;
+    bool finished = false;
+    bool cancelled = false;
+
+    bool pop(std::vector<entry> &batch)
+    {
+        if (failure) {
+            std::exception_ptr e = failure;
+            failure = nullptr;
+            std::rethrow_exception(e);
+        }
+        if (batches.empty()) {
+            return false;
+        }
+        batch.swap(batches.front());
+        batches.pop_front();
+        cond.notify_all();
+        return true;
+    }
+};
+
+void entry_stream::produce(const std::shared_ptr<channel> &ch,
+                           const std::shared_ptr<::DocSetCursor> &cursor,
+                           std::size_t batch_size)
+{
+    batch_holder h;
+    std::exception_ptr failure;
+
+    try {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(ch->mutex);
+                ch->cond.wait(lock, [&ch] {
+                    return ch->cancelled
+                        || ch->batches.size() < max_pending_batches;
+                });
+                if (ch->cancelled) {
+                    break;
+                }
+            }
+
+            std::size_t n = ::docset_cursor_fetch_batch(cursor.get(),
+                                                        batch_size, &h.batch);
+            check_cursor(cursor.get());
+            if (n == 0) {
+                break;
+            }
+
+            std::vector<entry> batch(h.batch.size);
+            for (std::size_t i = 0; i < h.batch.size; ++i) {
+                batch[i].assign_batch_entry(h.batch, i);
+            }
+
+            std::lock_guard<std::mutex> lock(ch->mutex);
+            ch->batches.push_back(std::move(batch));
+            ch->cond.notify_all();
+        }
+    } catch (...) {
+        failure = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(ch->mutex);
+    ch->failure = failure;
+    ch->finished = true;
+    ch->cond.notify_all();
+}
+
+entry_stream::entry_stream(std::shared_ptr<channel> ch)
+    : channel_(std::move(ch))
+{}
+
+entry_stream &entry_stream::operator=(entry_stream &&rhs)
+{
+    if (this != &rhs) {
+        cancel();
+        channel_ = std::move(rhs.channel_);
+    }
+    return *this;
+}
+
+entry_stream::~entry_stream()
+{
+    cancel();
+}
+
+bool entry_stream::next(std::vector<entry> &batch)
+{
+    if (!channel_) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(channel_->mutex);
+    channel_->cond.wait(lock, [this] {
+        return channel_->finished || !channel_->batches.empty();
+    });
+    return channel_->pop(batch);
+}
+
+bool entry_stream::try_next(std::vector<entry> &batch)
+{
+    if (!channel_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(channel_->mutex);
+    return channel_->pop(batch);
+}
+
+bool entry_stream::done() const
+{
+    if (!channel_) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(channel_->mutex);
+    return channel_->finished
+        && channel_->batches.empty()
+        && !channel_->failure;
+}
+
+void entry_stream::cancel()
+{
+    if (!channel_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(channel_->mutex);
+    channel_->cancelled = true;
+    channel_->batches.clear();
+    channel_->cond.notify_all();
+}
+
 // Entry
 
 bool entry::operator==(const entry &rhs) const
@@ -81,14 +568,66 @@ bool entry::operator==(const entry &rhs) const
         && canonical_type_ == rhs.canonical_type_;
 }
 
+namespace
+{
+
+void assign_or_clear(std::string &s, const char *value)
+{
+    if (value) {
+        s.assign(value);
+    } else {
+        s.clear();
+    }
+}
+
+void assign_or_clear(std::string &s, const char *value, std::size_t n)
+{
+    if (value) {
+        s.assign(value, n);
+    } else {
+        s.clear();
+    }
+}
+
+}
+
+entry &entry::assign(const entry_view &view)
+{
+    assign_raw_entry(view.entry_);
+    assign_or_clear(docset_name_, view.docset_name());
+    return *this;
+}
+
 void entry::assign_raw_entry(::DocSetEntry *e)
 {
     id_ = ::docset_entry_id(e);
-    name_.assign(::docset_entry_name(e));
-    path_.assign(::docset_entry_path(e));
+    assign_or_clear(name_, ::docset_entry_name(e),
+                    ::docset_entry_name_length(e));
+    assign_or_clear(path_, ::docset_entry_path(e),
+                    ::docset_entry_path_length(e));
+    assign_or_clear(type_name_, ::docset_entry_type_name(e),
+                    ::docset_entry_type_name_length(e));
     canonical_type_ = ::docset_entry_type(e);
 }
 
+void entry::assign_batch_entry(const ::DocSetBatch &b, std::size_t i)
+{
+    id_ = b.ids[i];
+    name_.assign(b.strings + b.name_offsets[i], b.name_lengths[i]);
+    path_.assign(b.strings + b.path_offsets[i], b.path_lengths[i]);
+    type_name_.assign(b.strings + b.type_offsets[i], b.type_lengths[i]);
+    canonical_type_ = b.types[i];
+    assign_or_clear(docset_name_, ::docset_name(b.docsets[i]));
+}
+
+// Entry view
+
+const char *entry_view::docset_name() const
+{
+    ::DocSet *ds = ::docset_cursor_docset(cursor_);
+    return ds ? ::docset_name(ds) : nullptr;
+}
+
 // Iterator
 
 iterator::iterator(DocSetCursor *cursor)
@@ -108,6 +647,8 @@ iterator &iterator::operator++()
     if (::docset_cursor_step(cursor_.get())) {
         ::DocSetEntry *e = docset_cursor_entry(cursor_.get());
         entry_.assign_raw_entry(e);
+        assign_or_clear(entry_.docset_name_,
+                        ::docset_name(::docset_cursor_docset(cursor_.get())));
     } else {
         cursor_.reset();
     }
@@ -123,15 +664,71 @@ bool iterator::operator==(const iterator &rhs) const
         && entry_ == rhs.entry_;
 }
 
+// View iterator
+
+view_iterator::view_iterator(::DocSetCursor *cursor)
+{
+    view_.cursor_ = cursor;
+    ++(*this);
+}
+
+view_iterator &view_iterator::operator++()
+{
+    if (::docset_cursor_step(view_.cursor_)) {
+        view_.entry_ = ::docset_cursor_entry(view_.cursor_);
+    } else {
+        view_.cursor_ = nullptr;
+        view_.entry_ = nullptr;
+    }
+    return *this;
+}
+
 // Entry range
 
+arena::arena(std::size_t block_size)
+    : arena_(::docset_arena_create(block_size), ::docset_arena_destroy)
+{
+    if (!arena_) {
+        throw error(::docset_error_string(::DOCSET_NO_MEM));
+    }
+}
+
 entry_range::entry_range(::DocSetCursor *cursor)
     : cursor_(cursor, ::docset_cursor_dispose)
 {}
 
+entry_range::entry_range(std::shared_ptr<::DocSetCursor> cursor)
+    : cursor_(std::move(cursor))
+{}
+
+void entry_range::materialize(arena &a) const
+{
+    if (!::docset_cursor_materialize(cursor_.get(), a.arena_.get())) {
+        throw error(::docset_error_string(::DOCSET_NO_MEM));
+    }
+}
+
 iterator entry_range::begin() const
 {
     return iterator(cursor_);
 }
 
+void entry_range::collect_into(std::vector<entry> &out) const
+{
+    batch_holder h;
+    std::size_t n = 0;
+
+    while (::docset_cursor_fetch_batch(cursor_.get(), collect_batch_size,
+                                       &h.batch)) {
+        for (std::size_t i = 0; i < h.batch.size; ++i, ++n) {
+            if (n == out.size()) {
+                out.emplace_back();
+            }
+            out[n].assign_batch_entry(h.batch, i);
+        }
+    }
+    out.resize(n);
+    check_cursor(cursor_.get());
+}
+
 }
@@ -29,6 +29,8 @@
 #ifndef DOCSET_H
 #define DOCSET_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -63,7 +65,8 @@ typedef enum {
     DOCSET_BAD_XML,
     DOCSET_NO_DB,
     DOCSET_BAD_DB,
-    DOCSET_TOO_MANY_ARGS
+    DOCSET_TOO_MANY_ARGS,
+    DOCSET_NO_DOCUMENT
 } DocSetError;
 
 /**
@@ -137,8 +140,109 @@ typedef enum {
     DOCSET_TYPE_LAST = DOCSET_TYPE_VARIABLE
 } DocSetEntryType;
 
+/**
+ * @brief Canonical type names in the order of ::DocSetEntryType.
+ *
+ * The list expands @c X(name, type) for every type, it's the single
+ * source of type names: the name lookup tables of the library and the
+ * compile time lookup of the C++ bindings are generated from it.
+ */
+#define DOCSET_TYPE_NAMES(X) \
+    X("Attribute", DOCSET_TYPE_ATTRIBUTE) \
+    X("Binding", DOCSET_TYPE_BINDING) \
+    X("Builtin", DOCSET_TYPE_BUILTIN) \
+    X("Callback", DOCSET_TYPE_CALLBACK) \
+    X("Category", DOCSET_TYPE_CATEGORY) \
+    X("Class", DOCSET_TYPE_CLASS) \
+    X("Command", DOCSET_TYPE_COMMAND) \
+    X("Component", DOCSET_TYPE_COMPONENT) \
+    X("Constant", DOCSET_TYPE_CONSTANT) \
+    X("Constructor", DOCSET_TYPE_CONSTRUCTOR) \
+    X("Define", DOCSET_TYPE_DEFINE) \
+    X("Delegate", DOCSET_TYPE_DELEGATE) \
+    X("Directive", DOCSET_TYPE_DIRECTIVE) \
+    X("Element", DOCSET_TYPE_ELEMENT) \
+    X("Entry", DOCSET_TYPE_ENTRY) \
+    X("Enum", DOCSET_TYPE_ENUM) \
+    X("Error", DOCSET_TYPE_ERROR) \
+    X("Event", DOCSET_TYPE_EVENT) \
+    X("Exception", DOCSET_TYPE_EXCEPTION) \
+    X("Field", DOCSET_TYPE_FIELD) \
+    X("File", DOCSET_TYPE_FILE) \
+    X("Filter", DOCSET_TYPE_FILTER) \
+    X("Framework", DOCSET_TYPE_FRAMEWORK) \
+    X("Function", DOCSET_TYPE_FUNCTION) \
+    X("Global", DOCSET_TYPE_GLOBAL) \
+    X("Guide", DOCSET_TYPE_GUIDE) \
+    X("Instance", DOCSET_TYPE_INSTANCE) \
+    X("Instruction", DOCSET_TYPE_INSTRUCTION) \
+    X("Interface", DOCSET_TYPE_INTERFACE) \
+    X("Keyword", DOCSET_TYPE_KEYWORD) \
+    X("Library", DOCSET_TYPE_LIBRARY) \
+    X("Literal", DOCSET_TYPE_LITERAL) \
+    X("Macro", DOCSET_TYPE_MACRO) \
+    X("Method", DOCSET_TYPE_METHOD) \
+    X("Mixin", DOCSET_TYPE_MIXIN) \
+    X("Module", DOCSET_TYPE_MODULE) \
+    X("Namespace", DOCSET_TYPE_NAMESPACE) \
+    X("Notation", DOCSET_TYPE_NOTATION) \
+    X("Object", DOCSET_TYPE_OBJECT) \
+    X("Operator", DOCSET_TYPE_OPERATOR) \
+    X("Option", DOCSET_TYPE_OPTION) \
+    X("Package", DOCSET_TYPE_PACKAGE) \
+    X("Parameter", DOCSET_TYPE_PARAMETER) \
+    X("Procedure", DOCSET_TYPE_PROCEDURE) \
+    X("Property", DOCSET_TYPE_PROPERTY) \
+    X("Protocol", DOCSET_TYPE_PROTOCOL) \
+    X("Record", DOCSET_TYPE_RECORD) \
+    X("Resource", DOCSET_TYPE_RESOURCE) \
+    X("Sample", DOCSET_TYPE_SAMPLE) \
+    X("Section", DOCSET_TYPE_SECTION) \
+    X("Service", DOCSET_TYPE_SERVICE) \
+    X("Struct", DOCSET_TYPE_STRUCT) \
+    X("Style", DOCSET_TYPE_STYLE) \
+    X("Subroutine", DOCSET_TYPE_SUBROUTINE) \
+    X("Tag", DOCSET_TYPE_TAG) \
+    X("Trait", DOCSET_TYPE_TRAIT) \
+    X("Type", DOCSET_TYPE_TYPE) \
+    X("Union", DOCSET_TYPE_UNION) \
+    X("Value", DOCSET_TYPE_VALUE) \
+    X("Variable", DOCSET_TYPE_VARIABLE)
+
+/**
+ * @brief Other type names docsets use, see ::DOCSET_TYPE_NAMES.
+ */
+#define DOCSET_TYPE_ALIASES(X) \
+    X("Word", DOCSET_TYPE_KEYWORD) \
+    X("cat", DOCSET_TYPE_CATEGORY) \
+    X("cl", DOCSET_TYPE_CLASS) \
+    X("clconst", DOCSET_TYPE_CONSTANT) \
+    X("clm", DOCSET_TYPE_METHOD) \
+    X("func", DOCSET_TYPE_FUNCTION) \
+    X("instp", DOCSET_TYPE_INSTRUCTION) \
+    X("macro", DOCSET_TYPE_MACRO) \
+    X("specialization", DOCSET_TYPE_TYPE) \
+    X("tdef", DOCSET_TYPE_TYPE)
+
+/* Kept for compatibility, docset_find_by_ids() accepts any number of
+ * ids. */
 enum { DOCSET_MAX_IDS = 999 };
 
+/**
+ * @brief Entry columns a cursor could fetch, entry id is always
+ * fetched.
+ */
+typedef enum {
+    DOCSET_COL_NAME   = 1,
+    DOCSET_COL_TYPE   = 1 << 1,
+    DOCSET_COL_PARENT = 1 << 2,
+    DOCSET_COL_PATH   = 1 << 3,
+    DOCSET_COL_ALL    = DOCSET_COL_NAME
+                      | DOCSET_COL_TYPE
+                      | DOCSET_COL_PARENT
+                      | DOCSET_COL_PATH
+} DocSetColumn;
+
 /**
  * @brief Abstract data type representing docset.
  */
@@ -159,6 +263,213 @@ typedef struct DocSetEntry DocSetEntry;
  */
 typedef struct DocSetCursor DocSetCursor;
 
+/**
+ * @brief Abstract data type representing a collection of docsets
+ * searched together.
+ */
+typedef struct DocSetLibrary DocSetLibrary;
+
+/**
+ * @brief Abstract data type representing a sequence of searches refined
+ * by the user, see docset_session_find().
+ */
+typedef struct DocSetSearchSession DocSetSearchSession;
+
+/**
+ * @brief Abstract data type representing a region of memory freed all
+ * at once, see docset_arena_create().
+ */
+typedef struct DocSetArena DocSetArena;
+
+/**
+ * @brief Orderings of entries found in multiple docsets.
+ */
+typedef enum {
+    /** Entries are ordered by docset, then by entry id. */
+    DOCSET_ORDER_BY_DOCSET,
+    /** Best matches go first, exact matches rank better than prefix
+     * matches, which rank better than word boundary and substring ones
+     * (see docset_find_top()). */
+    DOCSET_ORDER_BY_RANK
+} DocSetOrder;
+
+/**
+ * @brief Number of words in ::DocSetTypeMask, every word holds 32 types
+ * whatever the size of @c long is.
+ */
+enum { DOCSET_TYPE_MASK_WORDS = (DOCSET_TYPE_LAST + 32) / 32 };
+
+/**
+ * @brief Set of entry types, see docset_find_typed().
+ *
+ * Use docset_type_mask_clear() and docset_type_mask_add() to fill it.
+ */
+typedef struct DocSetTypeMask
+{
+    unsigned long bits[DOCSET_TYPE_MASK_WORDS];
+} DocSetTypeMask;
+
+/**
+ * @brief Columnar buffer filled by docset_cursor_fetch_batch().
+ *
+ * All the strings of a batch are stored null-terminated in a single
+ * arena: the name of the entry @c i is @c strings + @c name_offsets[i]
+ * and is @c name_lengths[i] bytes long. Columns not fetched by the
+ * cursor are empty strings, their types are ::DOCSET_TYPE_UNKNOWN.
+ */
+typedef struct DocSetBatch
+{
+    /** Number of entries in the batch. */
+    size_t size;
+    /** Number of entries the arrays have room for. */
+    size_t capacity;
+
+    DocSetEntryId *ids;
+    DocSetEntryType *types;
+    /** Docsets the entries come from, see docset_cursor_docset(). */
+    DocSet **docsets;
+
+    size_t *name_offsets;
+    size_t *name_lengths;
+    size_t *type_offsets;
+    size_t *type_lengths;
+    size_t *path_offsets;
+    size_t *path_lengths;
+
+    char *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+} DocSetBatch;
+
+/**
+ * @brief Cumulative docset statistics, see docset_get_stats().
+ *
+ * Times are in seconds.
+ */
+typedef struct DocSetStats
+{
+    /** Time spent parsing the property list on open. */
+    double open_plist_seconds;
+    /** Time spent opening the database on open. */
+    double open_db_seconds;
+    /** Time spent detecting the database schema on open. */
+    double open_schema_seconds;
+
+    /** Number of statements prepared. */
+    unsigned long stmts_prepared;
+    /** Number of times a prepared statement was reused. */
+    unsigned long stmts_reused;
+    /** Time spent preparing statements. */
+    double prepare_seconds;
+
+    /** Number of rows fetched from the database. */
+    unsigned long rows_stepped;
+    /** Time spent fetching rows, see docset_set_step_timing(). */
+    double step_seconds;
+
+    /** Number of bytes copied to entries and batches. */
+    unsigned long bytes_copied;
+    /** Number of times an entry buffer had to grow. */
+    unsigned long buffer_reallocs;
+
+    /** Number of queries answered by the result cache, see
+     *  docset_set_result_cache(). */
+    unsigned long result_cache_hits;
+    /** Number of queries the result cache had no result for. */
+    unsigned long result_cache_misses;
+
+    /** Number of documents opened from a cached mapping, see
+     *  docset_set_document_cache(). */
+    unsigned long document_cache_hits;
+    /** Number of documents mapped into memory. */
+    unsigned long document_cache_misses;
+} DocSetStats;
+
+/**
+ * @brief Anchor offset of documents without a known anchor, see
+ * ::DocSetDocument.
+ */
+#define DOCSET_NO_ANCHOR ((size_t)-1)
+
+/**
+ * @brief Read-only view of an HTML document, see docset_open_document().
+ */
+typedef struct DocSetDocument
+{
+    /** Contents of the file, not zero-terminated. */
+    const char *data;
+    size_t      size;
+    /** Offset of the tag defining the anchor of the entry path,
+     *  ::DOCSET_NO_ANCHOR if the path has no anchor or it's not found. */
+    size_t      anchor_offset;
+
+    /* Private fields of the library. */
+    DocSet     *docset;
+    const void *mapping;
+} DocSetDocument;
+
+/**
+ * @brief Flags of docset_try_open_flags().
+ */
+typedef enum {
+    /** Defer opening of the index database until the first query.
+     *  Metadata is available right after the docset is opened. */
+    DOCSET_OPEN_LAZY      = 1,
+    /** Open the index database in read-only mode. */
+    DOCSET_OPEN_READ_ONLY = 1 << 1,
+    /** Assume that the index database never changes while the docset
+     *  is open, SQLite then skips all the locking. Implies
+     *  DOCSET_OPEN_READ_ONLY. */
+    DOCSET_OPEN_IMMUTABLE = 1 << 2,
+    /** Open the database connection without SQLite mutexes, the docset
+     *  must not be used by several threads at once. */
+    DOCSET_OPEN_NO_MUTEX  = 1 << 3,
+    /** Allow searching the docset from several threads at once, see
+     *  docset_open_ex(). Implies DOCSET_OPEN_READ_ONLY. */
+    DOCSET_OPEN_CONCURRENT = 1 << 4
+} DocSetOpenFlags;
+
+/**
+ * @brief Storage of SQLite temporary tables and indices.
+ */
+typedef enum {
+    DOCSET_TEMP_STORE_DEFAULT = 0,
+    DOCSET_TEMP_STORE_FILE    = 1,
+    DOCSET_TEMP_STORE_MEMORY  = 2
+} DocSetTempStore;
+
+/**
+ * @brief Options of docset_open_ex(), initialize them with
+ * docset_open_options_init() before setting the fields.
+ */
+typedef struct DocSetOpenOptions
+{
+    /** Bitwise or of DocSetOpenFlags. */
+    unsigned flags;
+    /** Maximum number of database bytes to memory-map, 0 keeps the
+     *  SQLite default. */
+    unsigned long mmap_size;
+    /** Value of the cache_size pragma: pages if positive, KiB if
+     *  negative, 0 keeps the SQLite default. */
+    long cache_size;
+    /** Where SQLite keeps temporary data. */
+    DocSetTempStore temp_store;
+} DocSetOpenOptions;
+
+/**
+ * @brief Memory allocation functions, see docset_set_allocator().
+ *
+ * The functions follow the contracts of malloc(), realloc() and free()
+ * of the C library, @p context is passed to every call.
+ */
+typedef struct DocSetAllocator
+{
+    void *(*allocate)(void *context, size_t size);
+    void *(*reallocate)(void *context, void *ptr, size_t size);
+    void (*deallocate)(void *context, void *ptr);
+    void *context;
+} DocSetAllocator;
+
 typedef void (*docset_err_handler)(void *, const char *);
 
 /**
@@ -171,6 +482,52 @@ typedef void (*docset_err_handler)(void *, const char *);
 DocSetError
 docset_try_open(DocSet **docset, const char *basedir);
 
+/**
+ * @brief Opens a docset for reading with the given DocSetOpenFlags.
+ *
+ * If DOCSET_OPEN_LAZY is set, only the docset metadata is read. The
+ * index database is opened and its kind is detected by the first query,
+ * count or docset_kind() call, errors are then reported to the docset
+ * error handler.
+ *
+ * @param docset docset pointer sink
+ * @param basedir base docset directory
+ * @param flags bitwise or of DocSetOpenFlags
+ * @return error code
+ */
+DocSetError
+docset_try_open_flags(DocSet    **docset,
+                      const char *basedir,
+                      unsigned    flags);
+
+/**
+ * @brief Initializes docset open options with defaults, the defaults
+ * match the docset_try_open() behaviour.
+ */
+void
+docset_open_options_init(DocSetOpenOptions *options);
+
+/**
+ * @brief Opens a docset for reading with the given options.
+ *
+ * A docset opened with DOCSET_OPEN_CONCURRENT keeps a pool of read-only
+ * database connections, every cursor uses its own connection while it
+ * is alive. Functions creating cursors, docset_count(), the metadata
+ * getters, docset_get_stats() and docset_set_error_handler() may then
+ * be called from any number of threads at once. A cursor must be used
+ * by one thread at a time. Other setters must be called before the
+ * docset is shared between threads.
+ *
+ * @param docset docset pointer sink
+ * @param basedir base docset directory
+ * @param options open options, NULL means defaults
+ * @return error code
+ */
+DocSetError
+docset_open_ex(DocSet                  **docset,
+               const char               *basedir,
+               const DocSetOpenOptions  *options);
+
 /**
  * @brief Opens a docset for reading.
  *
@@ -204,6 +561,125 @@ docset_set_error_handler(DocSet            *docset,
                          docset_err_handler h,
                          void              *ctx);
 
+/**
+ * @brief Copies the docset statistics collected since it was opened or
+ * since the last docset_reset_stats() call.
+ *
+ * Counters are always collected, they cost a few increments per row.
+ */
+void
+docset_get_stats(DocSet      *docset,
+                 DocSetStats *stats);
+
+/**
+ * @brief Resets all the docset statistics to zero.
+ */
+void
+docset_reset_stats(DocSet *docset);
+
+/**
+ * @brief Enables or disables measuring of the time spent fetching rows.
+ *
+ * It's disabled by default since it reads the clock twice per row.
+ */
+void
+docset_set_step_timing(DocSet *docset,
+                       int     enabled);
+
+/**
+ * @brief Sets a directory to persist the name index in.
+ *
+ * Once built, the name index (see docset_set_name_index()) is saved to
+ * a file in the directory, later processes opening the same docset map
+ * the file into memory instead of scanning the database. Index files
+ * are keyed by the docset database path, size and modification time,
+ * stale files are rebuilt automatically.
+ *
+ * @param dir existing writable directory, NULL disables persistence.
+ * @return error code
+ */
+DocSetError
+docset_set_cache_dir(DocSet     *docset,
+                     const char *dir);
+
+/**
+ * @brief Materializes the entries of a ZDASH docset into a flat table.
+ *
+ * ZDASH (Xcode) docsets keep entries in several normalized tables, so
+ * every query joins them. Flattening copies the entries once into a
+ * single table with an index on names that later queries read instead.
+ * The flat table is saved to the cache directory if it's set (see
+ * docset_set_cache_dir()) and reused by later processes until the
+ * docset database changes, otherwise it's kept in memory.
+ *
+ * Does nothing for other docsets.
+ *
+ * @note Must not be called while cursors of the docset are alive.
+ * Concurrent docsets (see @c DOCSET_OPEN_CONCURRENT) can only be
+ * flattened to the cache directory.
+ * @return error code
+ */
+DocSetError
+docset_flatten(DocSet *docset);
+
+/**
+ * @brief Enables the cache of query results.
+ *
+ * Results of docset_find(), docset_find_ex(), docset_find_typed() and
+ * docset_find_top() are kept in memory, repeated queries are answered
+ * without the database. The least recently used results are evicted
+ * once the cache takes more than @p max_bytes. Hits and misses are
+ * counted in the docset statistics.
+ *
+ * The cache is disabled by default. On a miss the whole result set is
+ * fetched before the query function returns. Cursors share the cached
+ * results instead of copying them, rebinding them looks the new pattern
+ * up in the cache.
+ *
+ * @note The cache assumes the docset database doesn't change while the
+ * docset is open.
+ * @param max_bytes memory budget of the cache, 0 disables the cache.
+ * @return error code
+ */
+DocSetError
+docset_set_result_cache(DocSet *docset,
+                        size_t  max_bytes);
+
+/**
+ * @brief Sets the ranking weight of entries of the @p type.
+ *
+ * Among matches of the same kind (see docset_find_top()) entries with
+ * smaller weights go first. All the weights are 0 by default.
+ *
+ * @param weight weight from 0 to 255, larger values are clamped.
+ */
+void
+docset_set_type_weight(DocSet          *docset,
+                       DocSetEntryType  type,
+                       unsigned         weight);
+
+/**
+ * @brief Returns the ranking weight of entries of the @p type.
+ */
+unsigned
+docset_type_weight(DocSet          *docset,
+                   DocSetEntryType  type);
+
+/**
+ * @brief Enables or disables the in-memory name index.
+ *
+ * The index is built on the first docset_find() call and answers exact
+ * (@c "printf") and prefix (@c "std::vec%") patterns with a binary
+ * search instead of a full index table scan. All the other patterns are
+ * answered by the database as usual.
+ *
+ * The index is disabled by default. Disabling the index frees the
+ * memory it occupies.
+ */
+void
+docset_set_name_index(DocSet *docset,
+                      int     enabled);
+
 /**
  * @brief Returns text representation of error.
  */
@@ -268,6 +744,75 @@ DocSetCursor *
 docset_find(DocSet     *docset,
             const char *pattern);
 
+/**
+ * @brief Returns cursor that traverses entries matching given @p
+ * pattern and fetches only specified @p columns.
+ *
+ * Columns that are not fetched are not computed by the database, e.g.
+ * XCode docsets don't join file tables if the path is not requested.
+ * Accessors of the entry return NULL (or DOCSET_TYPE_UNKNOWN) for the
+ * columns that were not fetched.
+ *
+ * @param columns bitwise or of DocSetColumn flags.
+ */
+DocSetCursor *
+docset_find_ex(DocSet     *docset,
+               const char *pattern,
+               unsigned    columns);
+
+/**
+ * @brief Returns cursor that traverses entries matching given @p
+ * pattern that have one of the @p types.
+ *
+ * The filter is applied by the database: canonical types are expanded
+ * to the type names docsets actually use (e.g. @c "clm" for methods and
+ * @c "tdef" for types), so entries of other types are never fetched.
+ *
+ * @param types types of entries to return, an empty set matches
+ *        nothing.
+ */
+DocSetCursor *
+docset_find_typed(DocSet               *docset,
+                  const char           *pattern,
+                  const DocSetTypeMask *types);
+
+/**
+ * @brief Finds at most @p k best entries matching the @p pattern.
+ *
+ * Entries are ranked against the longest literal part of the pattern:
+ * exact matches go first, then prefix matches, then matches at a word
+ * boundary (after a separator or at a camel case hump), then all the
+ * others. Matches of the same kind are ordered by type weights (see
+ * docset_set_type_weight()), then shorter names go first.
+ *
+ * Only names and types are fetched while ranking, the whole result set
+ * is computed before the function returns.
+ */
+DocSetCursor *
+docset_find_top(DocSet     *docset,
+                const char *pattern,
+                size_t      k);
+
+/**
+ * @brief Finds at most @p k entries whose names contain all the
+ * characters of the @p query in the same order, e.g. "vecpb" finds
+ * "std::vector::push_back".
+ *
+ * Best matches go first: matches at the start of words and runs of
+ * consecutive characters rank better, shorter names rank better than
+ * longer ones with the same score. The whole result set is computed
+ * before the function returns using the in-memory name index (see
+ * docset_set_name_index()), which is built on the first call.
+ *
+ * @param query query characters, no wildcards. At most 64 characters,
+ *        an empty query matches nothing.
+ * @param k maximal number of entries to return
+ */
+DocSetCursor *
+docset_fuzzy_find(DocSet     *docset,
+                  const char *query,
+                  size_t      k);
+
 /**
  * @brief Returns cursor that traverses entries with specified
  * @p ids.
@@ -277,7 +822,8 @@ docset_find(DocSet     *docset,
  * @return cursor that enumerates entries with specified ids, ordered by
  * entry id (asc).
  *
- * @note @p num_ids must not exceed @c DOCSET_MAX_IDS.
+ * @note Any number of ids is accepted, duplicate ids produce a single
+ * entry, unknown ids are skipped.
  */
 DocSetCursor *
 docset_find_by_ids(DocSet *docset,
@@ -290,8 +836,26 @@ docset_find_by_ids(DocSet *docset,
 DocSetCursor *
 docset_list_entries(DocSet *docset);
 
+/**
+ * @brief Makes the cursor traverse entries matching the @p pattern.
+ *
+ * After successful call the cursor is equivalent to a cursor newly
+ * created for the @p pattern by the function that created it, i.e.
+ * cursors of docset_find_ex() and docset_find_typed() keep their
+ * columns and their type filter. The prepared statement and entry
+ * buffers of the cursor are reused.
+ *
+ * @return non-zero on success.
+ */
+int
+docset_cursor_rebind(DocSetCursor *cursor,
+                     const char   *pattern);
+
 /**
  * @brief Disposes a cursor.
+ *
+ * @note All the cursors MUST be disposed before the docset they were
+ * created from is closed.
  */
 int
 docset_cursor_dispose(DocSetCursor *cursor);
@@ -303,6 +867,19 @@ docset_cursor_dispose(DocSetCursor *cursor);
 int
 docset_cursor_step(DocSetCursor *cursor);
 
+/**
+ * @brief Checks whether the query of the cursor failed.
+ *
+ * docset_cursor_step() and docset_cursor_fetch_batch() stop both at the
+ * end of the result set and on a failure, the failure is also reported
+ * to the error handler.
+ *
+ * @return non-zero if the query failed or memory could not be allocated
+ *         while fetching the entries.
+ */
+int
+docset_cursor_failed(DocSetCursor *cursor);
+
 /**
  * @brief Returns entry this cursor points to.
  *
@@ -312,6 +889,289 @@ docset_cursor_step(DocSetCursor *cursor);
 DocSetEntry *
 docset_cursor_entry(DocSetCursor *cursor);
 
+/**
+ * @brief Returns the docset the current entry comes from.
+ *
+ * It's useful for cursors returned by docset_library_find().
+ */
+DocSet *
+docset_cursor_docset(DocSetCursor *cursor);
+
+/**
+ * @brief Initializes an empty batch.
+ */
+void
+docset_batch_init(DocSetBatch *batch);
+
+/**
+ * @brief Frees memory owned by the batch.
+ */
+void
+docset_batch_destroy(DocSetBatch *batch);
+
+/**
+ * @brief Fetches up to @p n next entries of the cursor into the batch.
+ *
+ * The previous batch contents is replaced, its memory is reused.
+ * A single call replaces @p n calls to docset_cursor_step() and
+ * docset_cursor_entry() plus the accessors calls.
+ *
+ * @return number of entries fetched, 0 if the cursor is exhausted.
+ *         On memory allocation failure the error handler is called,
+ *         the batch holds the entries fetched before the failure and
+ *         the cursor is marked as failed, see docset_cursor_failed().
+ */
+size_t
+docset_cursor_fetch_batch(DocSetCursor *cursor,
+                          size_t        n,
+                          DocSetBatch  *batch);
+
+/** @} */
+
+/** @defgroup library Multiple Docsets Search
+ * @{
+ */
+
+/**
+ * @brief Creates an empty docset library.
+ *
+ * Library searches all its docsets in parallel using a pool of
+ * @p num_threads threads (including the calling one). Each docset is
+ * searched by a single thread at a time using its own database
+ * connection.
+ *
+ * @param num_threads number of threads, 0 means the number of online
+ *        processors.
+ * @return error code
+ */
+DocSetError
+docset_library_create(DocSetLibrary **library,
+                      unsigned        num_threads);
+
+/**
+ * @brief Opens a docset and adds it to the library.
+ *
+ * The docset is owned by the library and MUST NOT be closed by the
+ * client.
+ *
+ * @return error code
+ */
+DocSetError
+docset_library_add(DocSetLibrary *library,
+                   const char    *basedir);
+
+/**
+ * @brief Returns number of docsets in the library.
+ */
+unsigned
+docset_library_size(DocSetLibrary *library);
+
+/**
+ * @brief Returns docset with index @p i, docsets are indexed in the
+ * order they were added.
+ */
+DocSet *
+docset_library_docset(DocSetLibrary *library,
+                      unsigned       i);
+
+/**
+ * @brief Searches all the library docsets for entries matching
+ * the @p pattern.
+ *
+ * The whole result set is fetched before the function returns, use
+ * docset_cursor_docset() to find the docset of an entry. Docsets that
+ * fail to answer the query are skipped, their failures are reported to
+ * their error handlers.
+ *
+ * @note Docset error handlers could be called from the worker threads.
+ * @note Cursors stay valid when docsets are added to the library.
+ */
+DocSetCursor *
+docset_library_find(DocSetLibrary *library,
+                     const char    *pattern,
+                     DocSetOrder    order);
+
+/**
+ * @brief Closes all the library docsets and frees the library.
+ *
+ * @note All the library cursors MUST be disposed before.
+ */
+void
+docset_library_close(DocSetLibrary *library);
+
+/** @} */
+
+/** @defgroup session Incremental Search
+ * @{
+ */
+
+/**
+ * @brief Creates a search session for the @p docset.
+ *
+ * The session keeps the entries found by the last search in memory.
+ *
+ * @return error code
+ */
+DocSetError
+docset_session_create(DocSetSearchSession **session,
+                      DocSet               *docset);
+
+/**
+ * @brief Returns cursor that traverses entries matching given @p
+ * pattern, like docset_find() does.
+ *
+ * If the previous pattern of the session ends with @c '%' and the rest
+ * of it is a prefix of the @p pattern (e.g. @c "pri%" followed by
+ * @c "prin%"), the entries found last time are filtered in memory and
+ * the database is not queried. Otherwise the whole result set is
+ * fetched before the function returns.
+ *
+ * The cursor shares the entries with the session instead of copying
+ * them, it stays valid after the session is closed or searches again.
+ */
+DocSetCursor *
+docset_session_find(DocSetSearchSession *session,
+                    const char          *pattern);
+
+/**
+ * @brief Frees the session, its docset is not closed.
+ */
+void
+docset_session_close(DocSetSearchSession *session);
+
+/** @} */
+
+/** @defgroup documents Document Access
+ * @{
+ */
+
+/**
+ * @brief Returns the directory entry paths are relative to, the path
+ * ends with a slash.
+ */
+const char *
+docset_documents_path(DocSet *docset);
+
+/**
+ * @brief Maps the document of the @p entry into memory.
+ *
+ * The entry path is resolved against docset_documents_path(), the
+ * anchor after @c '#' selects the tag with the same @c id or @c name
+ * attribute. The document is mapped read-only, its contents is never
+ * copied.
+ *
+ * The entry MUST be fetched with the ::DOCSET_COL_PATH column.
+ *
+ * @return error code, ::DOCSET_NO_DOCUMENT if the path doesn't name a
+ *         file of the docset or the file could not be mapped.
+ */
+DocSetError
+docset_open_document(DocSet         *docset,
+                     DocSetEntry    *entry,
+                     DocSetDocument *document);
+
+/**
+ * @brief Maps the document at the entry @p path into memory, see
+ * docset_open_document().
+ */
+DocSetError
+docset_open_document_path(DocSet         *docset,
+                          const char     *path,
+                          DocSetDocument *document);
+
+/**
+ * @brief Releases the document.
+ *
+ * @note All the documents MUST be closed before their docset is closed.
+ */
+void
+docset_close_document(DocSetDocument *document);
+
+/**
+ * @brief Sets the number of documents kept mapped after they are
+ * closed.
+ *
+ * Reopening such a document takes no system calls and the pages read
+ * before stay mapped. Hits and misses are counted in the docset
+ * statistics. The default is 16 documents.
+ *
+ * @note The cache assumes the documents don't change while the docset
+ * is open.
+ */
+void
+docset_set_document_cache(DocSet *docset,
+                          size_t  max_documents);
+
+/** @} */
+
+/** @defgroup memory Memory Management
+ * @{
+ */
+
+/**
+ * @brief Makes the library allocate all its memory with the @p
+ * allocator, NULL restores the C library functions.
+ *
+ * The allocator is global. It MUST be set before any docset is opened
+ * and MUST NOT be changed while any library object is alive, memory is
+ * always freed by the allocator it came from. SQLite and libxml2 keep
+ * allocating with their own functions.
+ *
+ * @return error code, ::DOCSET_BAD_CALL if a function is missing.
+ */
+DocSetError
+docset_set_allocator(const DocSetAllocator *allocator);
+
+/**
+ * @brief Creates an empty arena.
+ *
+ * Arena hands out memory from blocks of @p block_size bytes and frees
+ * it all at once. It is not thread-safe, a typical arena serves a
+ * single request.
+ *
+ * @param block_size size of arena blocks, 0 selects the default.
+ * @return new arena or NULL if memory could not be allocated.
+ */
+DocSetArena *
+docset_arena_create(size_t block_size);
+
+/**
+ * @brief Allocates @p size bytes aligned for any type from the arena.
+ * @return memory or NULL if memory could not be allocated.
+ */
+void *
+docset_arena_alloc(DocSetArena *arena,
+                   size_t       size);
+
+/**
+ * @brief Frees all the memory allocated from the arena, a single block
+ * is kept for the further allocations.
+ */
+void
+docset_arena_reset(DocSetArena *arena);
+
+/**
+ * @brief Frees the arena and all the memory allocated from it.
+ */
+void
+docset_arena_destroy(DocSetArena *arena);
+
+/**
+ * @brief Copies the remaining entries of the cursor into the arena.
+ *
+ * The entries are laid out in a single arena allocation and the cursor
+ * traverses them from then on, it no longer holds a database
+ * connection or statement. The cursor is positioned before the first
+ * copied entry.
+ *
+ * @note The cursor MUST be disposed before the arena is reset.
+ * @return non-zero on success. On memory allocation failure the error
+ *         handler is called and the cursor could have been advanced.
+ */
+int
+docset_cursor_materialize(DocSetCursor *cursor,
+                          DocSetArena  *arena);
+
 /** @} */
 
 /** @defgroup entry Entry manipulation functions
@@ -329,6 +1189,13 @@ docset_entry_id(DocSetEntry *entry);
 const char *
 docset_entry_name(DocSetEntry *entry);
 
+/**
+ * @brief Returns the length of the entry name, 0 if the name isn't
+ * fetched.
+ */
+size_t
+docset_entry_name_length(DocSetEntry *entry);
+
 /**
  * @brief Returns type of the current entry.
  */
@@ -342,6 +1209,13 @@ docset_entry_type(DocSetEntry *entry);
 const char *
 docset_entry_path(DocSetEntry *entry);
 
+/**
+ * @brief Returns the length of the entry path, 0 if the path isn't
+ * fetched.
+ */
+size_t
+docset_entry_path_length(DocSetEntry *entry);
+
 /**
  * @brief Returns type name of the entry as it's recorded in the
  * index.
@@ -349,6 +1223,13 @@ docset_entry_path(DocSetEntry *entry);
 const char *
 docset_entry_type_name(DocSetEntry *entry);
 
+/**
+ * @brief Returns the length of the entry type name, 0 if the type isn't
+ * fetched.
+ */
+size_t
+docset_entry_type_name_length(DocSetEntry *entry);
+
 /**
  * @brief Returns canonical name type of entry.
  *
@@ -378,6 +1259,26 @@ docset_type_by_name(const char *name);
 const char *
 docset_canonical_type_name(DocSetEntryType type);
 
+/**
+ * @brief Makes the type @p mask empty.
+ */
+void
+docset_type_mask_clear(DocSetTypeMask *mask);
+
+/**
+ * @brief Adds the @p type to the @p mask, unknown types are ignored.
+ */
+void
+docset_type_mask_add(DocSetTypeMask  *mask,
+                     DocSetEntryType  type);
+
+/**
+ * @brief Checks whether the @p mask contains the @p type.
+ */
+int
+docset_type_mask_has(const DocSetTypeMask *mask,
+                     DocSetEntryType       type);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -18,36 +18,194 @@
  *         std::cout << e.name() << ": " << e.path() << "\n";
  *     }
  *
+ *     // list entries without copying their strings
+ *     for (const auto &e: ds.find("%").views()) {
+ *         std::cout << e.name() << ": " << e.path() << "\n";
+ *     }
+ *
  * @endcode
  */
 #include <docset.h>
+#include <cstring>
+#include <ostream>
+#include <set>
 #include <string>
 #include <vector>
 #include <iterator>
 #include <stdexcept>
 #include <memory>
+#include <utility>
+#include <functional>
+#include <future>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 namespace docset
 {
 
+namespace detail
+{
+
+constexpr bool same_name(const char *a, const char *b)
+{
+    return *a == *b && (*a == '\0' || same_name(a + 1, b + 1));
+}
+
+}
+
+/// @brief Compile-time equivalent of ::docset_type_by_name():
+/// @code
+///     static_assert(docset::type_by_name("clm") == DOCSET_TYPE_METHOD, "");
+/// @endcode
+/// The names are compared one by one, names known only at run time are
+/// better resolved by ::docset_type_by_name().
+constexpr ::DocSetEntryType type_by_name(const char *name)
+{
+#define LIBDOCSET_TYPE_NAME(n, type) detail::same_name(name, n) ? type :
+    return DOCSET_TYPE_NAMES(LIBDOCSET_TYPE_NAME)
+           DOCSET_TYPE_ALIASES(LIBDOCSET_TYPE_NAME)
+           ::DOCSET_TYPE_UNKNOWN;
+#undef LIBDOCSET_TYPE_NAME
+}
+
 class error : public std::runtime_error
 {
 public:
     error(const char *) throw();
 };
 
+/// @brief Read-only reference to a string owned by someone else.
+///
+/// Converts to @c std::string_view when compiled as C++17.
+class string_ref
+{
+public:
+    typedef const char *const_iterator;
+
+    string_ref() : data_(""), size_(0) {}
+
+    string_ref(const char *s)
+        : data_(s ? s : ""), size_(s ? std::strlen(s) : 0)
+    {}
+
+    string_ref(const char *s, std::size_t n) : data_(s), size_(n) {}
+
+    string_ref(const std::string &s) : data_(s.data()), size_(s.size()) {}
+
+    const char *data() const { return data_; }
+
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const_iterator begin() const { return data_; }
+
+    const_iterator end() const { return data_ + size_; }
+
+    char operator[](std::size_t i) const { return data_[i]; }
+
+    std::string str() const { return std::string(data_, size_); }
+
+#if __cplusplus >= 201703L
+    operator std::string_view() const
+    {
+        return std::string_view(data_, size_);
+    }
+#endif
+
+private:
+    const char *data_;
+    std::size_t size_;
+};
+
+inline bool operator==(string_ref a, string_ref b)
+{
+    return a.size() == b.size()
+        && std::char_traits<char>::compare(a.data(), b.data(), a.size()) == 0;
+}
+
+inline bool operator!=(string_ref a, string_ref b) { return !(a == b); }
+
+inline std::ostream &operator<<(std::ostream &os, string_ref s)
+{
+    return os.write(s.data(), s.size());
+}
+
+/// @brief Entry of a result set that borrows its strings from the
+/// cursor, the strings are valid until the cursor steps further.
+class entry_view
+{
+public:
+    typedef ::DocSetEntryId id_type;
+
+    id_type id() const { return ::docset_entry_id(entry_); }
+
+    string_ref name() const
+    {
+        return ref(::docset_entry_name(entry_),
+                   ::docset_entry_name_length(entry_));
+    }
+
+    string_ref path() const
+    {
+        return ref(::docset_entry_path(entry_),
+                   ::docset_entry_path_length(entry_));
+    }
+
+    string_ref type_name() const
+    {
+        return ref(::docset_entry_type_name(entry_),
+                   ::docset_entry_type_name_length(entry_));
+    }
+
+    ::DocSetEntryType canonical_type() const
+    {
+        return ::docset_entry_type(entry_);
+    }
+
+    const char *canonical_type_name() const
+    {
+        return ::docset_canonical_type_name(canonical_type());
+    }
+
+    /// @brief Returns the name of the docset the entry comes from.
+    const char *docset_name() const;
+
+private:
+    friend class entry;
+    friend class view_iterator;
+
+    static string_ref ref(const char *s, std::size_t n)
+    {
+        return s ? string_ref(s, n) : string_ref();
+    }
+
+    ::DocSetCursor *cursor_ = nullptr;
+    ::DocSetEntry *entry_ = nullptr;
+};
+
 class entry
 {
 public:
     typedef ::DocSetEntryId id_type;
 
+    entry() = default;
+
+    /// @brief Copies the entry @p view refers to.
+    explicit entry(const entry_view &view) { assign(view); }
+
+    /// @brief Replaces the entry with a copy of the entry @p view refers
+    /// to, memory already owned by the entry is reused.
+    entry &assign(const entry_view &view);
+
     id_type id() const { return id_; }
 
-    std::string name() const { return name_; }
+    const std::string &name() const { return name_; }
 
-    std::string path() const { return path_; }
+    const std::string &path() const { return path_; }
 
-    std::string type_name() const { return type_name_; }
+    const std::string &type_name() const { return type_name_; }
 
     ::DocSetEntryType canonical_type() const { return canonical_type_; }
 
@@ -56,12 +214,18 @@ public:
         return ::docset_canonical_type_name(canonical_type_);
     }
 
+    /// @brief Returns the name of the docset the entry comes from.
+    const std::string &docset_name() const { return docset_name_; }
+
     bool operator==(const entry &rhs) const;
     bool operator!=(const entry &rhs) const { return !(*this == rhs); }
 
 private:
     friend class iterator;
+    friend class entry_range;
+    friend class entry_stream;
     void assign_raw_entry(::DocSetEntry *);
+    void assign_batch_entry(const ::DocSetBatch &, std::size_t);
 
 private:
     id_type id_;
@@ -69,6 +233,7 @@ private:
     std::string path_;
     std::string type_name_;
     ::DocSetEntryType canonical_type_;
+    std::string docset_name_;
 };
 
 /// @brief Iterator that traverses entries in a result set.
@@ -105,6 +270,71 @@ private:
     entry entry_;
 };
 
+/// @brief Iterator that traverses entry views of a result set, see
+/// entry_range::views().
+///
+/// Models input iterator, incrementing the iterator invalidates the
+/// view it points to.
+class view_iterator :
+        public std::iterator<entry_view,
+                             std::input_iterator_tag>
+{
+public:
+    explicit view_iterator(::DocSetCursor *cursor = nullptr);
+
+    view_iterator &operator++();
+
+    const entry_view &operator*() const { return view_; }
+
+    const entry_view *operator->() const { return &view_; }
+
+    bool operator==(const view_iterator &rhs) const
+    {
+        return view_.cursor_ == rhs.view_.cursor_;
+    }
+
+    bool operator!=(const view_iterator &rhs) const { return !(*this == rhs); }
+
+private:
+    entry_view view_;
+};
+
+/// @brief Result set traversed with entry views.
+///
+/// Views borrow the strings from the cursor, so the traversal doesn't
+/// allocate memory per entry.
+class view_range
+{
+public:
+    explicit view_range(std::shared_ptr<::DocSetCursor> cursor)
+        : cursor_(std::move(cursor))
+    {}
+
+    view_iterator begin() const { return view_iterator(cursor_.get()); }
+
+    view_iterator end() const { return view_iterator(); }
+
+private:
+    std::shared_ptr<::DocSetCursor> cursor_;
+};
+
+/// @brief Memory freed all at once, see ::docset_arena_create().
+class arena
+{
+public:
+    explicit arena(std::size_t block_size = 0);
+
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+
+    /// @brief Frees all the memory allocated from the arena.
+    void reset() { ::docset_arena_reset(arena_.get()); }
+
+private:
+    friend class entry_range;
+    std::unique_ptr<::DocSetArena, void (*)(::DocSetArena *)> arena_;
+};
+
 /// @brief Represents query result set.
 ///
 /// It's not safe to traverse the result set multiple times.
@@ -112,6 +342,7 @@ class entry_range
 {
 public:
     entry_range(::DocSetCursor *cursor);
+    entry_range(std::shared_ptr<::DocSetCursor> cursor);
 
     /// @brief Returns iterator pointing to the first entry
     /// in a result set.
@@ -121,17 +352,155 @@ public:
     /// in a result set.
     iterator end() const { return iterator(); }
 
+    /// @brief Moves the remaining entries of the result set to @p out
+    /// replacing its contents.
+    ///
+    /// Entries are fetched in batches, memory already owned by @p out
+    /// (including the strings of its entries) is reused.
+    /// @throw error if the query failed.
+    void collect_into(std::vector<entry> &out) const;
+
+    /// @brief Returns the result set traversed with entry views.
+    view_range views() const { return view_range(cursor_); }
+
+    /// @brief Copies the remaining entries into the arena, see
+    /// ::docset_cursor_materialize().
+    ///
+    /// The range MUST be destroyed before the arena is reset.
+    void materialize(arena &a) const;
+
 private:
     std::shared_ptr<::DocSetCursor> cursor_;
 };
 
+/// @brief Runs asynchronous queries, see doc_set::find_async().
+class executor
+{
+public:
+    virtual ~executor() {}
+
+    /// @brief Schedules the @p task to run on some thread.
+    virtual void post(std::function<void()> task) = 0;
+};
+
+/// @brief Executor running tasks on a fixed number of threads.
+///
+/// The destructor waits for the tasks already posted, so the streams
+/// running on the pool must be destroyed before it.
+class thread_pool_executor : public executor
+{
+public:
+    /// @brief Starts @p num_threads threads, 0 means the number of
+    /// hardware threads.
+    explicit thread_pool_executor(unsigned num_threads = 0);
+    ~thread_pool_executor();
+
+    thread_pool_executor(const thread_pool_executor &) = delete;
+    thread_pool_executor &operator=(const thread_pool_executor &) = delete;
+
+    void post(std::function<void()> task) override;
+
+private:
+    struct state;
+    std::unique_ptr<state> state_;
+};
+
+/// @brief Entries of a query running on an executor, the entries are
+/// delivered in batches while the query is still running.
+///
+/// Destroying the stream cancels the query, the executor thread stops
+/// after the batch it's fetching. A moved-from stream has no entries
+/// and is done.
+class entry_stream
+{
+public:
+    entry_stream(entry_stream &&) = default;
+    entry_stream &operator=(entry_stream &&rhs);
+    ~entry_stream();
+
+    /// @brief Waits for the next batch and moves it to @p batch.
+    /// @return false if there are no more entries.
+    /// @throw error if the query failed.
+    bool next(std::vector<entry> &batch);
+
+    /// @brief Moves the next batch to @p batch if it's ready, never
+    /// blocks, e.g. to poll the stream from a GUI event loop.
+    /// @return false if no batch is ready, see done().
+    /// @throw error if the query failed.
+    bool try_next(std::vector<entry> &batch);
+
+    /// @brief Returns true if all the batches were consumed.
+    bool done() const;
+
+    /// @brief Stops the query, the remaining batches are dropped.
+    void cancel();
+
+private:
+    friend class doc_set;
+    struct channel;
+
+    explicit entry_stream(std::shared_ptr<channel> ch);
+
+    static void produce(const std::shared_ptr<channel> &,
+                        const std::shared_ptr<::DocSetCursor> &,
+                        std::size_t batch_size);
+
+private:
+    std::shared_ptr<channel> channel_;
+};
+
+/// @brief Read-only view of a docset document, see
+/// ::docset_open_document().
+class document
+{
+public:
+    document(document &&rhs);
+    document &operator=(document &&rhs);
+    ~document();
+
+    document(const document &) = delete;
+    document &operator=(const document &) = delete;
+
+    const char *data() const { return doc_.data; }
+
+    std::size_t size() const { return doc_.size; }
+
+    string_ref contents() const { return string_ref(doc_.data, doc_.size); }
+
+    /// @brief Checks whether the anchor of the entry path was found.
+    bool has_anchor() const { return doc_.anchor_offset != DOCSET_NO_ANCHOR; }
+
+    /// @brief Returns offset of the tag defining the anchor.
+    std::size_t anchor_offset() const { return doc_.anchor_offset; }
+
+private:
+    friend class doc_set;
+    document(std::shared_ptr<::DocSet> docset, const char *path);
+
+    // The document must not outlive its docset.
+    std::shared_ptr<::DocSet> docset_;
+    ::DocSetDocument doc_;
+};
+
 /// @brief Represents a docset handle.
+///
+/// Asynchronous queries run on executor threads: unless the docset is
+/// opened with ::DOCSET_OPEN_CONCURRENT, no other queries must run on
+/// the docset until they are finished.
 class doc_set
 {
 public:
     doc_set(const char *dirname);
     doc_set(std::string dirname);
 
+    /// @brief Opens a docset with the given ::DocSetOpenFlags, see
+    /// ::docset_try_open_flags().
+    doc_set(std::string dirname, unsigned flags);
+
+    /// @brief Opens a docset with the given options, see
+    /// ::docset_open_ex().
+    doc_set(std::string dirname, const ::DocSetOpenOptions &options);
+
     /// @brief Returns number of entries in a docset.
     std::size_t count() const;
 
@@ -147,6 +516,15 @@ public:
     /// @brief Returns base docset directory.
     std::string basedir() const { return basedir_; }
 
+    /// @brief Returns the directory entry paths are relative to.
+    const char *documents_path() const;
+
+    /// @brief Maps the document of the entry into memory, see
+    /// ::docset_open_document().
+    document open_document(const entry &e) const;
+
+    document open_document(const entry_view &e) const;
+
 
     /// @brief Returns iterator pointing to the first entry in a docset.
     iterator begin() const;
@@ -159,16 +537,109 @@ public:
 
     entry_range find(const std::string &query) const;
 
+    /// @brief Returns range of entries matching the given query that
+    /// have only specified @p columns (see ::DocSetColumn) filled.
+    entry_range find(const std::string &query, unsigned columns) const;
+
+    /// @brief Returns range of entries matching the given query that
+    /// have one of the @p types, see ::docset_find_typed().
+    entry_range find(const std::string &query,
+                     const std::set<::DocSetEntryType> &types) const;
+
     entry_range find_by_ids(const std::vector<entry::id_type> &ids) const;
 
+    /// @brief Returns range of at most @p k best entries matching the
+    /// given query, see ::docset_find_top().
+    entry_range find_top(const std::string &query, std::size_t k) const;
+
+    /// @brief Runs the query on the executor @p ex, the future becomes
+    /// ready when all the matching entries are fetched or holds an
+    /// error if the query failed.
+    std::future<std::vector<entry>>
+    find_async(const std::string &query, executor &ex) const;
+
+    /// @brief Runs the query on the executor @p ex, the entries are
+    /// delivered in batches of at most @p batch_size entries.
+    entry_stream
+    find_stream(const std::string &query, executor &ex,
+                std::size_t batch_size = 256) const;
+
+    /// @brief Sets a directory to persist the name index in, see
+    /// ::docset_set_cache_dir().
+    void set_cache_dir(const std::string &dir);
+
+    /// @brief Materializes entries of a ZDASH docset into a flat table,
+    /// see ::docset_flatten().
+    void flatten();
+
+    /// @brief Enables the cache of query results limited to
+    /// @p max_bytes, see ::docset_set_result_cache().
+    void set_result_cache(std::size_t max_bytes);
+
+    /// @brief Sets the ranking weight of entries of the @p type, see
+    /// ::docset_set_type_weight().
+    void set_type_weight(::DocSetEntryType type, unsigned weight);
+
+    /// @brief Returns statistics collected so far, see
+    /// ::docset_get_stats().
+    ::DocSetStats stats() const;
+
+    /// @brief Resets the collected statistics.
+    void reset_stats();
+
 private:
-    void init(const char *);
+    friend class search_session;
+    void init(const char *, const ::DocSetOpenOptions &);
+    std::shared_ptr<::DocSetCursor> wrap(::DocSetCursor *) const;
 
 private:
     std::string basedir_;
     std::shared_ptr<::DocSet> docset_;
 };
 
+/// @brief Represents a collection of docsets searched in parallel.
+class library
+{
+public:
+    /// @brief Creates an empty library searched by @p num_threads
+    /// threads, 0 means the number of online processors.
+    explicit library(unsigned num_threads = 0);
+
+    /// @brief Opens a docset and adds it to the library.
+    void add(const char *dirname);
+
+    void add(const std::string &dirname);
+
+    /// @brief Returns number of docsets in the library.
+    std::size_t size() const;
+
+    /// @brief Returns range of entries of all the docsets matching the
+    /// given query.
+    entry_range find(const char *query,
+                     ::DocSetOrder order = ::DOCSET_ORDER_BY_DOCSET) const;
+
+    entry_range find(const std::string &query,
+                     ::DocSetOrder order = ::DOCSET_ORDER_BY_DOCSET) const;
+
+private:
+    std::shared_ptr<::DocSetLibrary> library_;
+};
+
+/// @brief Represents a sequence of searches refined by the user, see
+/// ::docset_session_find().
+class search_session
+{
+public:
+    explicit search_session(const doc_set &docset);
+
+    /// @brief Returns range of entries matching the given query, the
+    /// entries found by the previous query are reused if possible.
+    entry_range find(const std::string &query);
+
+private:
+    std::shared_ptr<::DocSetSearchSession> session_;
+};
+
 }
 
 #endif
@@ -0,0 +1,120 @@
+/* memmem() is POSIX.1-2024, older C libraries declare it as an
+ * extension. */
+#define _GNU_SOURCE
+
+#include "docset.h"
+#include "document.h"
+
+#include <ctype.h>
+#include <string.h>
+
+static int is_attr_name(const char *data, size_t end, const char *name);
+
+static int is_anchor_attr(const char *data, size_t quote);
+
+/* Checks that the attribute name ending at the offset is the name,
+ * ignoring case. */
+static int is_attr_name(const char *data, size_t end, const char *name)
+{
+    size_t len = strlen(name);
+    size_t i;
+
+    /* The name must follow a space. */
+    if (end <= len) {
+        return 0;
+    }
+    for (i = 0; i < len; ++i) {
+        if (tolower((unsigned char)data[end - len + i]) != name[i]) {
+            return 0;
+        }
+    }
+    return isspace((unsigned char)data[end - len - 1]);
+}
+
+/* Checks that the quote at the offset starts an id or name attribute
+ * value. */
+static int is_anchor_attr(const char *data, size_t quote)
+{
+    size_t i = quote;
+
+    while (i > 0 && isspace((unsigned char)data[i - 1])) {
+        --i;
+    }
+    if (i == 0 || data[--i] != '=') {
+        return 0;
+    }
+    while (i > 0 && isspace((unsigned char)data[i - 1])) {
+        --i;
+    }
+
+    return is_attr_name(data, i, "id") || is_attr_name(data, i, "name");
+}
+
+int docset_doc_split_path(const char  *path,
+                          const char **file,
+                          size_t      *file_len,
+                          const char **anchor)
+{
+    const char *p, *end, *segment;
+    size_t len;
+
+    while (*path == '<') {
+        if (!(path = strchr(path, '>'))) {
+            return 0;
+        }
+        ++path;
+    }
+
+    *file = path;
+    *file_len = strcspn(path, "?#");
+    p = strchr(path + *file_len, '#');
+    *anchor = p ? p + 1 : "";
+
+    if (*file_len == 0 || *path == '/') {
+        return 0;
+    }
+
+    end = path + *file_len;
+    for (segment = path; segment < end; segment = p + 1) {
+        p = (const char *) memchr(segment, '/', (size_t)(end - segment));
+        if (!p) {
+            p = end;
+        }
+        len = (size_t)(p - segment);
+        if ((len == 2 && segment[0] == '.' && segment[1] == '.')
+            || (segment == path && memchr(segment, ':', len))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+size_t docset_doc_find_anchor(const char *data,
+                              size_t      size,
+                              const char *anchor)
+{
+    size_t len = strlen(anchor);
+    const char *v;
+    size_t i = 1;
+
+    if (len == 0) {
+        return DOCSET_NO_ANCHOR;
+    }
+
+    /* The value at i is enclosed in quotes at i - 1 and i + len. */
+    while (i + len < size
+           && (v = (const char *) memmem(data + i, size - i - 1,
+                                         anchor, len))) {
+        i = (size_t)(v - data);
+        if ((data[i - 1] == '"' || data[i - 1] == '\'')
+            && data[i + len] == data[i - 1]
+            && is_anchor_attr(data, i - 1)) {
+            while (i > 0 && data[i] != '<') {
+                --i;
+            }
+            return i;
+        }
+        ++i;
+    }
+    return DOCSET_NO_ANCHOR;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file
+ *
+ * This file provides parsing of entry paths and lookup of anchors in
+ * HTML documents.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_DOCUMENT_H
+#define DOCSET_DOCUMENT_H
+
+#include <stddef.h>
+
+/**
+ * @brief Splits the entry @p path into the file path relative to the
+ * documents directory and the anchor.
+ *
+ * Leading @c <dash_entry_...> tags and the query string are skipped.
+ *
+ * @param file set to the start of the file path.
+ * @param file_len set to the length of the file path.
+ * @param anchor set to the zero-terminated anchor, empty if the path
+ *        has none.
+ * @return non-zero if the path names a file inside the documents
+ *         directory, i.e. it is neither a URL nor an absolute path and
+ *         it has no @c ".." components.
+ */
+int
+docset_doc_split_path(const char  *path,
+                      const char **file,
+                      size_t      *file_len,
+                      const char **anchor);
+
+/**
+ * @brief Finds the tag whose @c id or @c name attribute is equal to the
+ * @p anchor.
+ * @return offset of the tag in the @p data or ::DOCSET_NO_ANCHOR.
+ */
+size_t
+docset_doc_find_anchor(const char *data,
+                       size_t      size,
+                       const char *anchor);
+
+#endif
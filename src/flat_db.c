@@ -0,0 +1,153 @@
+#define _XOPEN_SOURCE 700
+
+#include "flat_db.h"
+#include "alloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *SCHEMA[] = {
+    "create table " DOCSET_FLAT_TABLE "(id integer primary key, name text, "
+    "type text, parent text, path text)",
+    "create table meta(stamp text)"
+};
+
+/* The index is created after the table is filled, LIKE patterns with a
+ * constant prefix use it since it folds case the same way. */
+static const char INDEX_QUERY[] =
+    "create index " DOCSET_FLAT_TABLE "_name on "
+    DOCSET_FLAT_TABLE "(name collate nocase)";
+
+static int exec(sqlite3 *db, const char *sql)
+{
+    return sqlite3_exec(db, sql, NULL, NULL, NULL) == SQLITE_OK;
+}
+
+/* Executes the query with a single text parameter. */
+static int exec_text(sqlite3 *db, const char *sql, const char *text)
+{
+    sqlite3_stmt *stmt;
+    int ok;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return 0;
+    }
+    ok = sqlite3_bind_text(stmt, 1, text, -1, SQLITE_STATIC) == SQLITE_OK
+         && sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+/* Copies the entries of the docset database attached to the flat
+ * database. */
+static int fill(sqlite3 *db,
+                const char *db_path,
+                const char *select,
+                const char *stamp)
+{
+    static const char INSERT[] = "insert into " DOCSET_FLAT_TABLE " ";
+    char *insert;
+    size_t i;
+    int ok;
+
+    insert = (char *) docset_malloc(sizeof(INSERT) + strlen(select));
+    if (!insert) {
+        return 0;
+    }
+    strcpy(insert, INSERT);
+    strcat(insert, select);
+
+    ok = exec_text(db, "attach database ? as src", db_path)
+         && exec(db, "begin");
+
+    for (i = 0; ok && i < sizeof(SCHEMA) / sizeof(SCHEMA[0]); ++i) {
+        ok = exec(db, SCHEMA[i]);
+    }
+
+    ok = ok
+         && exec(db, insert)
+         && exec(db, INDEX_QUERY)
+         && exec_text(db, "insert into meta values (?)", stamp ? stamp : "")
+         && exec(db, "commit")
+         && exec(db, "detach database src");
+
+    docset_free(insert);
+    return ok;
+}
+
+sqlite3 *docset_flat_build(const char *db_path, const char *select)
+{
+    sqlite3 *db = NULL;
+
+    if (sqlite3_open(":memory:", &db) != SQLITE_OK
+        || !fill(db, db_path, select, NULL)) {
+        sqlite3_close(db);
+        return NULL;
+    }
+    return db;
+}
+
+int docset_flat_save(const char *path,
+                     const char *db_path,
+                     const char *select,
+                     const char *stamp)
+{
+    sqlite3 *db = NULL;
+    char *tmp_path;
+    int fd;
+    int ok;
+
+    tmp_path = (char *) docset_malloc(strlen(path) + sizeof(".XXXXXX"));
+    if (!tmp_path) {
+        return 0;
+    }
+    sprintf(tmp_path, "%s.XXXXXX", path);
+
+    /* Readers never see a partially written database, SQLite treats the
+     * empty file as an empty database. */
+    fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        docset_free(tmp_path);
+        return 0;
+    }
+    close(fd);
+
+    ok = sqlite3_open(tmp_path, &db) == SQLITE_OK
+         && exec(db, "pragma journal_mode=off")
+         && exec(db, "pragma synchronous=off")
+         && fill(db, db_path, select, stamp);
+
+    ok = sqlite3_close(db) == SQLITE_OK && ok;
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) {
+        unlink(tmp_path);
+    }
+
+    docset_free(tmp_path);
+    return ok;
+}
+
+int docset_flat_check(const char *path, const char *stamp)
+{
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    const char *s;
+    int ok;
+
+    if (access(path, R_OK) != 0) {
+        return 0;
+    }
+
+    ok = sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK
+         && sqlite3_prepare_v2(db, "select stamp from meta", -1, &stmt,
+                               NULL) == SQLITE_OK
+         && sqlite3_step(stmt) == SQLITE_ROW
+         && (s = (const char *)sqlite3_column_text(stmt, 0)) != NULL
+         && strcmp(s, stamp) == 0;
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return ok;
+}
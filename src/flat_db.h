@@ -0,0 +1,59 @@
+/**
+ * @file
+ *
+ * This file provides flattening of ZDASH docsets: the entries of the
+ * normalized ZDASH schema are materialized into a single table with an
+ * index on names, so queries don't join four tables per row.
+ *
+ * A flat database is either kept in memory or saved to a cache
+ * directory, saved databases remember the version of the docset
+ * database they were built from (see docset_if_db_stamp()).
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_FLAT_DB_H
+#define DOCSET_FLAT_DB_H
+
+#include <sqlite3.h>
+
+/**
+ * @brief Name of the table with the flattened entries, it has the
+ * columns @c id, @c name, @c type, @c parent and @c path.
+ */
+#define DOCSET_FLAT_TABLE "entries"
+
+/**
+ * @brief Builds the flat database in memory.
+ *
+ * @param db_path docset database
+ * @param select query selecting id, name, type, parent and path of all
+ *        the entries from the docset database
+ * @return new connection to the flat database or NULL on error.
+ */
+sqlite3 *
+docset_flat_build(const char *db_path,
+                  const char *select);
+
+/**
+ * @brief Builds the flat database and saves it to the @p path, the file
+ * is replaced atomically.
+ *
+ * @param stamp version of the docset database
+ * @return non-zero on success.
+ */
+int
+docset_flat_save(const char *path,
+                 const char *db_path,
+                 const char *select,
+                 const char *stamp);
+
+/**
+ * @brief Checks that the flat database file at the @p path exists and
+ * was built from the @p stamp version of the docset database.
+ */
+int
+docset_flat_check(const char *path,
+                  const char *stamp);
+
+#endif
@@ -0,0 +1,219 @@
+#include "fuzzy.h"
+
+#include <string.h>
+
+#define FOLD(c) (('A' <= (c) && (c) <= 'Z') ? (c) + ('a' - 'A') : (c))
+#define IS_LOWER(c) ('a' <= (c) && (c) <= 'z')
+#define IS_UPPER(c) ('A' <= (c) && (c) <= 'Z')
+
+/* Only that many name characters take part in scoring, longer names
+ * that match beyond it get the lowest score. */
+#define MAX_NAME 256
+
+#define SCORE_MIN (-0x100000L)
+#define SCORE_MAX 0x100000L
+
+#define BONUS_START       90
+#define BONUS_SEPARATOR   90
+#define BONUS_WORD        80
+#define BONUS_CAMEL       70
+#define BONUS_CONSECUTIVE 100
+#define GAP_LEADING       (-1)
+#define GAP_INNER         (-2)
+#define GAP_TRAILING      (-1)
+
+/* Rank is the score turned upside down followed by the name length. */
+#define LENGTH_BITS 10
+#define MAX_LENGTH ((1UL << LENGTH_BITS) - 1)
+
+static long bonus(const unsigned char *name, size_t j)
+{
+    unsigned char prev;
+
+    if (j == 0) {
+        return BONUS_START;
+    }
+    prev = name[j - 1];
+    switch (prev) {
+    case ':':
+    case '/':
+        return BONUS_SEPARATOR;
+    case '_':
+    case '-':
+    case '.':
+    case ' ':
+    case '(':
+        return BONUS_WORD;
+    default:
+        return IS_LOWER(prev) && IS_UPPER(name[j]) ? BONUS_CAMEL : 0;
+    }
+}
+
+static unsigned long make_rank(long score, size_t len)
+{
+    if (score < SCORE_MIN) {
+        score = SCORE_MIN;
+    }
+    if (score > SCORE_MAX) {
+        score = SCORE_MAX;
+    }
+    return ((unsigned long)(SCORE_MAX - score) << LENGTH_BITS)
+           | (len < MAX_LENGTH ? len : MAX_LENGTH);
+}
+
+/* Finds the leftmost (first) and the rightmost (last) positions every
+ * query character could be matched at, returns 0 if the query is not a
+ * subsequence of the name. */
+static int match_bounds(const unsigned char *q,
+                        size_t               n,
+                        const unsigned char *name,
+                        size_t               len,
+                        size_t              *first,
+                        size_t              *last)
+{
+    size_t i, j;
+
+    for (i = 0, j = 0; i < n; ++i, ++j) {
+        while (j < len && FOLD(name[j]) != FOLD(q[i])) {
+            ++j;
+        }
+        if (j == len) {
+            return 0;
+        }
+        first[i] = j;
+    }
+
+    for (i = n, j = len; i-- > 0;) {
+        do {
+            --j;
+        } while (FOLD(name[j]) != FOLD(q[i]));
+        last[i] = j;
+    }
+    return 1;
+}
+
+/* The optimal alignment is computed row by row (one row per query
+ * character): d[j] is the best score of the alignment ending with a
+ * match at name[j], m[j] is the best score of the query prefix within
+ * name[0..j]. The row i only needs the columns from first[i] to
+ * last[i + 1], the rest can't be a part of any match. */
+static int score(const unsigned char *q,
+                 size_t               n,
+                 const unsigned char *name,
+                 size_t               len,
+                 long                *result)
+{
+    long d[MAX_NAME], m[MAX_NAME];
+    size_t first[DOCSET_FUZZY_MAX_QUERY], last[DOCSET_FUZZY_MAX_QUERY];
+    long prev_d, prev_m, d_diag, m_diag, cur, gap, best = SCORE_MIN;
+    size_t i, j, end = 0;
+
+    if (!match_bounds(q, n, name, len, first, last)) {
+        return 0;
+    }
+
+    for (i = 0; i < n; ++i) {
+        gap = (i + 1 == n) ? GAP_TRAILING : GAP_INNER;
+        end = (i + 1 == n) ? last[i] + 1 : last[i + 1];
+        best = SCORE_MIN;
+        j = first[i];
+        prev_d = (i > 0) ? d[j - 1] : SCORE_MIN;
+        prev_m = (i > 0) ? m[j - 1] : SCORE_MIN;
+
+        for (; j < end; ++j) {
+            d_diag = prev_d;
+            m_diag = prev_m;
+
+            /* Keep the previous row values needed by the next column. */
+            prev_d = d[j];
+            prev_m = m[j];
+
+            cur = SCORE_MIN;
+            if (j <= last[i] && FOLD(name[j]) == FOLD(q[i])) {
+                if (i == 0) {
+                    cur = (long)j * GAP_LEADING + bonus(name, j);
+                } else if (m_diag > SCORE_MIN) {
+                    cur = m_diag + bonus(name, j);
+                    if (d_diag > SCORE_MIN
+                        && d_diag + BONUS_CONSECUTIVE > cur) {
+                        cur = d_diag + BONUS_CONSECUTIVE;
+                    }
+                }
+            }
+
+            d[j] = cur;
+            best = (best > SCORE_MIN) ? best + gap : SCORE_MIN;
+            if (cur > best) {
+                best = cur;
+            }
+            m[j] = best;
+        }
+    }
+
+    *result = best + (long)(len - end) * GAP_TRAILING;
+    return 1;
+}
+
+unsigned long docset_fuzzy_best_rank(size_t query_len, size_t name_len)
+{
+    long best;
+
+    if (name_len == query_len) {
+        return make_rank(SCORE_MAX, name_len);
+    }
+
+    /* Every character matches as a part of a consecutive run and every
+     * other character costs at least one point. */
+    if (name_len > MAX_NAME) {
+        name_len = MAX_NAME;
+    }
+    best = BONUS_START + (long)(query_len - 1) * BONUS_CONSECUTIVE;
+    if (name_len > query_len) {
+        best -= (long)(name_len - query_len);
+    }
+    return make_rank(best, name_len);
+}
+
+int docset_fuzzy_rank(const char    *query,
+                      size_t         query_len,
+                      const char    *name,
+                      size_t         name_len,
+                      unsigned long *rank)
+{
+    const unsigned char *q = (const unsigned char *)query;
+    const unsigned char *s = (const unsigned char *)name;
+    size_t first[DOCSET_FUZZY_MAX_QUERY], last[DOCSET_FUZZY_MAX_QUERY];
+    size_t i;
+    long result;
+
+    if (query_len == 0 || query_len > DOCSET_FUZZY_MAX_QUERY
+        || query_len > name_len) {
+        return 0;
+    }
+
+    if (name_len == query_len) {
+        /* The only possible match is the whole name. */
+        for (i = 0; i < name_len && FOLD(s[i]) == FOLD(q[i]); ++i) {
+        }
+        if (i == name_len) {
+            *rank = make_rank(SCORE_MAX, name_len);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (name_len <= MAX_NAME) {
+        if (!score(q, query_len, s, name_len, &result)) {
+            return 0;
+        }
+    } else if (!score(q, query_len, s, MAX_NAME, &result)) {
+        /* Long names matching past the scored part rank last. */
+        if (!match_bounds(q, query_len, s, name_len, first, last)) {
+            return 0;
+        }
+        result = SCORE_MIN;
+    }
+
+    *rank = make_rank(result, name_len);
+    return 1;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file
+ *
+ * This file provides fuzzy matching of entry names: a name matches a
+ * query if it contains all the query characters in the same order,
+ * e.g. "vecpb" matches "std::vector::push_back".
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_FUZZY_H
+#define DOCSET_FUZZY_H
+
+#include <stddef.h>
+
+/** Longest query the matcher accepts. */
+#define DOCSET_FUZZY_MAX_QUERY 64
+
+/**
+ * @brief Returns the best rank a name of @p name_len characters could
+ * get for a query of @p query_len characters.
+ *
+ * It allows to skip scoring names that can't make it to the result.
+ */
+unsigned long
+docset_fuzzy_best_rank(size_t query_len,
+                       size_t name_len);
+
+/**
+ * @brief Scores the @p name against the fuzzy @p query.
+ *
+ * Characters matched at the start of the name, after separators and at
+ * camel case humps score better, so do runs of consecutive characters.
+ * Gaps between matched characters are penalized. Comparison is ASCII
+ * case-insensitive.
+ *
+ * @param query_len query length, at most DOCSET_FUZZY_MAX_QUERY
+ * @param name_len name length
+ * @param rank sink for the match rank, smaller is better. Better
+ *        matches of the same quality go to shorter names.
+ * @return non-zero if the name matches the query.
+ */
+int
+docset_fuzzy_rank(const char    *query,
+                  size_t         query_len,
+                  const char    *name,
+                  size_t         name_len,
+                  unsigned long *rank);
+
+#endif
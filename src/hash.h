@@ -0,0 +1,30 @@
+/**
+ * @file
+ *
+ * This file provides the FNV-1a hash of strings, shared by the hash
+ * tables of the library, the perfect hash of type names generated by
+ * type_hash_gen.c and the names of index files.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_HASH_H
+#define DOCSET_HASH_H
+
+#include <stddef.h>
+
+/* FNV-1a, 32 bits whatever the size of long is. The hash is stable,
+ * index file names and generated tables depend on it. */
+static unsigned long docset_hash(const char *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    unsigned long h = 2166136261UL;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        h = ((h ^ p[i]) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return h;
+}
+
+#endif
@@ -0,0 +1,295 @@
+#define _XOPEN_SOURCE 700
+
+#include "index_file.h"
+#include "alloc.h"
+#include "hash.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INDEX_MAGIC "DSNIDX\r\n"
+#define INDEX_VERSION 1
+#define ENDIAN_CHECK 0x01020304UL
+
+#define ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+typedef struct {
+    char magic[8];
+    unsigned long version;
+    unsigned long endian_check;
+    unsigned long item_size;
+    unsigned long mask_size;
+    unsigned long num_items;
+    unsigned long names_size;
+    /* The database file the index was built from. */
+    unsigned long db_size;
+    unsigned long db_inode;
+    long db_mtime;
+    long db_mtime_nsec;
+    unsigned long path_len;
+} IndexHeader;
+
+/* File layout: the header, the database path, items, masks and names,
+ * every part is 8-byte aligned. */
+typedef struct {
+    size_t path;
+    size_t items;
+    size_t masks;
+    size_t names;
+    size_t total;
+} IndexLayout;
+
+static void layout(const IndexHeader *h, IndexLayout *l)
+{
+    l->path = ALIGN(sizeof(*h));
+    l->items = l->path + ALIGN(h->path_len + 1);
+    l->masks = l->items + ALIGN(h->num_items * sizeof(DocSetNameIndexItem));
+    l->names = l->masks + ALIGN(h->num_items * sizeof(unsigned long));
+    l->total = l->names + h->names_size;
+}
+
+static int fill_db_info(IndexHeader *h, const char *db_path)
+{
+    struct stat st;
+
+    if (stat(db_path, &st) != 0) {
+        return 0;
+    }
+    h->db_size = (unsigned long)st.st_size;
+    h->db_inode = (unsigned long)st.st_ino;
+    h->db_mtime = (long)st.st_mtim.tv_sec;
+    h->db_mtime_nsec = (long)st.st_mtim.tv_nsec;
+    return 1;
+}
+
+/* Returns newly allocated canonical path of the database, so that the
+ * same docset opened by different paths shares the index file. */
+static char *canonical_path(const char *db_path)
+{
+    char *real = realpath(db_path, NULL);
+    const char *src = real ? real : db_path;
+    char *path = (char *) docset_malloc(strlen(src) + 1);
+
+    if (path) {
+        strcpy(path, src);
+    }
+    /* realpath() memory comes from the C library. */
+    free(real);
+    return path;
+}
+
+/* Every name offset must point into the names block, which ends with a
+ * terminator, so that a corrupted file can't make names run past it. */
+static int valid_names(const DocSetNameIndexItem *items,
+                       size_t                     num_items,
+                       size_t                     names_size)
+{
+    size_t i;
+
+    for (i = 0; i < num_items; ++i) {
+        if (items[i].name >= names_size) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int write_all(int fd, const void *data, size_t size)
+{
+    const char *p = (const char *)data;
+    ssize_t n;
+
+    while (size > 0) {
+        n = write(fd, p, size);
+        if (n < 0) {
+            return 0;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+static int write_padded(int fd, const void *data, size_t size)
+{
+    static const char zeros[8] = { 0 };
+
+    return write_all(fd, data, size)
+           && write_all(fd, zeros, ALIGN(size) - size);
+}
+
+char *docset_if_path(const char *cache_dir,
+                     const char *db_path,
+                     const char *suffix)
+{
+    char *key = canonical_path(db_path);
+    char *path = NULL;
+
+    if (key) {
+        path = (char *) docset_malloc(strlen(cache_dir) + strlen(suffix) + 32);
+    }
+    if (path) {
+        sprintf(path, "%s/%08lx%s", cache_dir, docset_hash(key, strlen(key)),
+                suffix);
+    }
+    docset_free(key);
+    return path;
+}
+
+char *docset_if_db_stamp(const char *db_path)
+{
+    IndexHeader h;
+    char *key;
+    char *stamp = NULL;
+
+    if (!fill_db_info(&h, db_path) || !(key = canonical_path(db_path))) {
+        return NULL;
+    }
+
+    stamp = (char *) docset_malloc(strlen(key) + 96);
+    if (stamp) {
+        sprintf(stamp, "%s:%lu:%lu:%ld.%09ld", key, h.db_size, h.db_inode,
+                h.db_mtime, h.db_mtime_nsec);
+    }
+    docset_free(key);
+    return stamp;
+}
+
+DocSetNameIndex *docset_if_load(const char *path, const char *db_path)
+{
+    DocSetNameIndex *index = NULL;
+    IndexHeader db, *h;
+    IndexLayout l;
+    struct stat st;
+    char *data = MAP_FAILED;
+    char *key;
+    int fd;
+
+    if (!fill_db_info(&db, db_path) || !(key = canonical_path(db_path))) {
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        docset_free(key);
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(*h)) {
+        goto done;
+    }
+
+    data = (char *) mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED,
+                         fd, 0);
+    if (data == MAP_FAILED) {
+        goto done;
+    }
+
+    h = (IndexHeader *)data;
+    if (memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) != 0
+        || h->version != INDEX_VERSION
+        || h->endian_check != ENDIAN_CHECK
+        || h->item_size != sizeof(DocSetNameIndexItem)
+        || h->mask_size != sizeof(unsigned long)
+        || h->db_size != db.db_size
+        || h->db_inode != db.db_inode
+        || h->db_mtime != db.db_mtime
+        || h->db_mtime_nsec != db.db_mtime_nsec
+        || h->path_len != strlen(key)
+        || h->num_items > (size_t)st.st_size / sizeof(DocSetNameIndexItem)
+        || h->names_size > (size_t)st.st_size) {
+        goto done;
+    }
+
+    layout(h, &l);
+    if (l.total != (size_t)st.st_size
+        || memcmp(data + l.path, key, h->path_len + 1) != 0
+        || (h->names_size > 0 && data[l.total - 1] != '\0')
+        || !valid_names((DocSetNameIndexItem *)(data + l.items),
+                        h->num_items, h->names_size)) {
+        goto done;
+    }
+
+    index = (DocSetNameIndex *) docset_calloc(1, sizeof(*index));
+    if (!index) {
+        goto done;
+    }
+
+    index->items = (DocSetNameIndexItem *)(data + l.items);
+    index->masks = (unsigned long *)(data + l.masks);
+    index->num_items = h->num_items;
+    index->names = data + l.names;
+    index->names_size = h->names_size;
+    index->mapping = data;
+    index->mapping_size = (size_t)st.st_size;
+    data = MAP_FAILED;
+
+done:
+    if (data != MAP_FAILED) {
+        munmap(data, (size_t)st.st_size);
+    }
+    close(fd);
+    docset_free(key);
+    return index;
+}
+
+int docset_if_save(const DocSetNameIndex *index,
+                   const char            *path,
+                   const char            *db_path)
+{
+    IndexHeader h;
+    char *tmp_path;
+    char *key;
+    int fd;
+    int ok;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+    h.version = INDEX_VERSION;
+    h.endian_check = ENDIAN_CHECK;
+    h.item_size = sizeof(DocSetNameIndexItem);
+    h.mask_size = sizeof(unsigned long);
+    h.num_items = index->num_items;
+    h.names_size = index->names_size;
+    if (!fill_db_info(&h, db_path) || !(key = canonical_path(db_path))) {
+        return 0;
+    }
+    h.path_len = strlen(key);
+
+    tmp_path = (char *) docset_malloc(strlen(path) + sizeof(".XXXXXX"));
+    if (!tmp_path) {
+        docset_free(key);
+        return 0;
+    }
+    sprintf(tmp_path, "%s.XXXXXX", path);
+
+    /* Readers never see a partially written file. */
+    fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        docset_free(tmp_path);
+        docset_free(key);
+        return 0;
+    }
+
+    ok = write_padded(fd, &h, sizeof(h))
+         && write_padded(fd, key, h.path_len + 1)
+         && write_padded(fd, index->items,
+                         index->num_items * sizeof(*index->items))
+         && write_padded(fd, index->masks,
+                         index->num_items * sizeof(*index->masks))
+         && write_all(fd, index->names, index->names_size);
+
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) {
+        unlink(tmp_path);
+    }
+
+    docset_free(tmp_path);
+    docset_free(key);
+    return ok;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file
+ *
+ * This file provides persistence of the name index: the index is saved
+ * to a cache directory once built and mapped into memory by later
+ * processes instead of scanning the database again.
+ *
+ * Index files are keyed by the database path, size, inode and
+ * modification time, stale files are ignored.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_INDEX_FILE_H
+#define DOCSET_INDEX_FILE_H
+
+#include "name_index.h"
+
+/**
+ * @brief Returns newly allocated path of the cache file with the
+ * @p suffix for the database @p db_path in the @p cache_dir, NULL on
+ * memory allocation error.
+ */
+char *
+docset_if_path(const char *cache_dir,
+               const char *db_path,
+               const char *suffix);
+
+/**
+ * @brief Returns newly allocated string identifying the current version
+ * of the database file: its canonical path, size, inode and
+ * modification time. NULL if the file can't be accessed.
+ */
+char *
+docset_if_db_stamp(const char *db_path);
+
+/**
+ * @brief Maps the index file into memory.
+ *
+ * @return index backed by the file mapping or NULL if the file is
+ *         missing, stale or damaged.
+ */
+DocSetNameIndex *
+docset_if_load(const char *path,
+               const char *db_path);
+
+/**
+ * @brief Saves the index to the file, the file is replaced atomically.
+ * @return non-zero on success.
+ */
+int
+docset_if_save(const DocSetNameIndex *index,
+               const char            *path,
+               const char            *db_path);
+
+#endif
@@ -0,0 +1,206 @@
+#include "docset.h"
+#include "alloc.h"
+#include "rank.h"
+#include "rowset.h"
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DOCSETS_INIT_SIZE 16
+
+struct DocSetLibrary
+{
+    DocSet **docsets;
+    unsigned num_docsets;
+    unsigned capacity;
+    DocSetThreadPool *pool;
+};
+
+typedef struct SearchTask
+{
+    DocSetRows rows;
+    int ok;
+} SearchTask;
+
+typedef struct SearchJob
+{
+    DocSetLibrary *library;
+    const char *pattern;
+    DocSetOrder order;
+    const char *needle;
+    size_t needle_len;
+    SearchTask *tasks;
+} SearchJob;
+
+/* Searches a single docset, every task writes only to its own slot of
+ * the job, so no locking is required. Failures are reported to the
+ * error handler of the docset. */
+static void search_docset(void *ctx, unsigned i)
+{
+    SearchJob *job = (SearchJob *)ctx;
+    SearchTask *task = job->tasks + i;
+    DocSet *docset = job->library->docsets[i];
+    DocSetCursor *cursor;
+    DocSetRow *row;
+    const char *name;
+    size_t j;
+
+    cursor = docset_find(docset, job->pattern);
+    task->ok = cursor && docset_cursor_collect(cursor, &task->rows);
+    docset_cursor_dispose(cursor);
+
+    for (j = 0; task->ok && j < task->rows.num_rows; ++j) {
+        row = task->rows.rows + j;
+        row->source = i;
+        if (job->order == DOCSET_ORDER_BY_RANK) {
+            name = task->rows.strings.data + row->name;
+            row->rank = docset_rank_score(name, strlen(name),
+                                          job->needle, job->needle_len,
+                                          docset_type_weight(
+                                              docset, row->entry_type));
+        }
+    }
+}
+
+DocSetError docset_library_create(DocSetLibrary **library,
+                                  unsigned        num_threads)
+{
+    if (!library) {
+        return DOCSET_BAD_CALL;
+    }
+
+    *library = (DocSetLibrary *) docset_calloc(1, sizeof(**library));
+    if (!*library) {
+        return DOCSET_NO_MEM;
+    }
+
+    (*library)->pool = docset_tp_create(num_threads);
+    if (!(*library)->pool) {
+        docset_free(*library);
+        *library = NULL;
+        return DOCSET_NO_MEM;
+    }
+
+    return DOCSET_OK;
+}
+
+DocSetError docset_library_add(DocSetLibrary *library, const char *basedir)
+{
+    DocSet *docset;
+    DocSetError err;
+
+    if (!library || !basedir) {
+        return DOCSET_BAD_CALL;
+    }
+
+    if (library->num_docsets == library->capacity) {
+        unsigned new_cap =
+            library->capacity ? library->capacity * 2 : DOCSETS_INIT_SIZE;
+        DocSet **docsets = (DocSet **)
+            docset_realloc(library->docsets, new_cap * sizeof(*docsets));
+        if (!docsets) {
+            return DOCSET_NO_MEM;
+        }
+        library->docsets = docsets;
+        library->capacity = new_cap;
+    }
+
+    if ((err = docset_try_open(&docset, basedir)) != DOCSET_OK) {
+        return err;
+    }
+
+    library->docsets[library->num_docsets++] = docset;
+    return DOCSET_OK;
+}
+
+unsigned docset_library_size(DocSetLibrary *library)
+{
+    return library ? library->num_docsets : 0;
+}
+
+DocSet *docset_library_docset(DocSetLibrary *library, unsigned i)
+{
+    if (!library || i >= library->num_docsets) {
+        return NULL;
+    }
+    return library->docsets[i];
+}
+
+DocSetCursor *docset_library_find(DocSetLibrary *library,
+                                  const char    *pattern,
+                                  DocSetOrder    order)
+{
+    SearchJob job;
+    DocSetRows *result;
+    unsigned i;
+    int ok;
+
+    if (!library || !pattern) {
+        return NULL;
+    }
+
+    result = (DocSetRows *) docset_malloc(sizeof(*result));
+    if (!result) {
+        return NULL;
+    }
+    if (!docset_rows_init(result)) {
+        docset_free(result);
+        return NULL;
+    }
+
+    job.library = library;
+    job.pattern = pattern;
+    job.order = order;
+    job.needle_len = docset_rank_needle(pattern, &job.needle);
+    job.tasks = (SearchTask *)
+        docset_calloc(library->num_docsets + 1, sizeof(SearchTask));
+
+    ok = job.tasks != NULL;
+    for (i = 0; ok && i < library->num_docsets; ++i) {
+        ok = docset_rows_init(&job.tasks[i].rows);
+    }
+    if (ok) {
+        docset_tp_run(library->pool, search_docset, &job,
+                      library->num_docsets);
+    }
+
+    /* Results of every docset are already ordered by id, the docsets
+     * that failed are skipped. */
+    for (i = 0; job.tasks && i < library->num_docsets; ++i) {
+        ok = ok
+             && (!job.tasks[i].ok
+                 || docset_rows_concat(result, &job.tasks[i].rows));
+        docset_rows_destroy(&job.tasks[i].rows);
+    }
+    docset_free(job.tasks);
+
+    if (!ok) {
+        docset_rows_destroy(result);
+        docset_free(result);
+        return NULL;
+    }
+
+    if (order == DOCSET_ORDER_BY_RANK) {
+        docset_rows_sort_by_rank(result);
+    }
+
+    return docset_cursor_for_rows(result, library->docsets,
+                                  library->num_docsets);
+}
+
+void docset_library_close(DocSetLibrary *library)
+{
+    unsigned i;
+
+    if (!library) {
+        return;
+    }
+
+    docset_tp_destroy(library->pool);
+    for (i = 0; i < library->num_docsets; ++i) {
+        docset_close(library->docsets[i]);
+    }
+    docset_free(library->docsets);
+    docset_free(library);
+}
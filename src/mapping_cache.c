@@ -0,0 +1,210 @@
+#define _XOPEN_SOURCE 700
+
+#include "mapping_cache.h"
+#include "alloc.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct CachedMapping
+{
+    /* Must be the first member, mappings are handed out by pointer. */
+    DocSetMapping mapping;
+    /* Mappings are listed from the most to the least recently used. */
+    struct CachedMapping *prev;
+    struct CachedMapping *next;
+    /* Number of unreleased docset_mc_acquire() calls. */
+    size_t refs;
+    char *path;
+} CachedMapping;
+
+struct DocSetMappingCache
+{
+    CachedMapping *first;
+    CachedMapping *last;
+    size_t num_idle;
+    size_t max_idle;
+};
+
+static CachedMapping *map_file(const char *path, DocSetError *err);
+
+static void unmap_file(CachedMapping *m);
+
+static void unlink_mapping(DocSetMappingCache *cache, CachedMapping *m);
+
+static void push_front(DocSetMappingCache *cache, CachedMapping *m);
+
+static void trim_idle(DocSetMappingCache *cache);
+
+static CachedMapping *map_file(const char *path, DocSetError *err)
+{
+    CachedMapping *m;
+    struct stat st;
+    void *data;
+    int fd;
+
+    *err = DOCSET_NO_DOCUMENT;
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    /* Empty files can't be mapped. */
+    data = (void *)"";
+    if (st.st_size > 0) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    *err = DOCSET_NO_MEM;
+    m = (CachedMapping *) docset_calloc(1, sizeof(*m));
+    if (m) {
+        m->path = (char *) docset_malloc(strlen(path) + 1);
+    }
+    if (!m || !m->path) {
+        if (st.st_size > 0) {
+            munmap(data, (size_t)st.st_size);
+        }
+        docset_free(m);
+        return NULL;
+    }
+
+    strcpy(m->path, path);
+    m->mapping.data = (const char *)data;
+    m->mapping.size = (size_t)st.st_size;
+    *err = DOCSET_OK;
+    return m;
+}
+
+static void unmap_file(CachedMapping *m)
+{
+    if (m->mapping.size > 0) {
+        munmap((void *)m->mapping.data, m->mapping.size);
+    }
+    docset_free(m->path);
+    docset_free(m);
+}
+
+static void unlink_mapping(DocSetMappingCache *cache, CachedMapping *m)
+{
+    if (m->prev) {
+        m->prev->next = m->next;
+    } else {
+        cache->first = m->next;
+    }
+    if (m->next) {
+        m->next->prev = m->prev;
+    } else {
+        cache->last = m->prev;
+    }
+    m->prev = m->next = NULL;
+}
+
+static void push_front(DocSetMappingCache *cache, CachedMapping *m)
+{
+    m->prev = NULL;
+    m->next = cache->first;
+    if (cache->first) {
+        cache->first->prev = m;
+    } else {
+        cache->last = m;
+    }
+    cache->first = m;
+}
+
+/* Unmaps the least recently used idle mappings over the limit. */
+static void trim_idle(DocSetMappingCache *cache)
+{
+    CachedMapping *m = cache->last;
+    CachedMapping *prev;
+
+    for (; m && cache->num_idle > cache->max_idle; m = prev) {
+        prev = m->prev;
+        if (m->refs == 0) {
+            unlink_mapping(cache, m);
+            unmap_file(m);
+            cache->num_idle--;
+        }
+    }
+}
+
+DocSetMappingCache *docset_mc_create(size_t max_idle)
+{
+    DocSetMappingCache *cache;
+
+    cache = (DocSetMappingCache *) docset_calloc(1, sizeof(*cache));
+    if (cache) {
+        cache->max_idle = max_idle;
+    }
+    return cache;
+}
+
+void docset_mc_free(DocSetMappingCache *cache)
+{
+    CachedMapping *m, *next;
+
+    if (!cache) {
+        return;
+    }
+
+    for (m = cache->first; m; m = next) {
+        next = m->next;
+        unmap_file(m);
+    }
+    docset_free(cache);
+}
+
+void docset_mc_set_max_idle(DocSetMappingCache *cache, size_t max_idle)
+{
+    cache->max_idle = max_idle;
+    trim_idle(cache);
+}
+
+const DocSetMapping *docset_mc_acquire(DocSetMappingCache *cache,
+                                       const char         *path,
+                                       int                *hit,
+                                       DocSetError        *err)
+{
+    CachedMapping *m;
+
+    /* The cache holds few mappings, a linear search is enough. */
+    m = cache->first;
+    while (m && strcmp(m->path, path) != 0) {
+        m = m->next;
+    }
+
+    *hit = m != NULL;
+    if (m) {
+        unlink_mapping(cache, m);
+        if (m->refs == 0) {
+            cache->num_idle--;
+        }
+    } else if (!(m = map_file(path, err))) {
+        return NULL;
+    }
+
+    m->refs++;
+    push_front(cache, m);
+    *err = DOCSET_OK;
+    return &m->mapping;
+}
+
+void docset_mc_release(DocSetMappingCache  *cache,
+                       const DocSetMapping *mapping)
+{
+    CachedMapping *m = (CachedMapping *)mapping;
+
+    if (--m->refs == 0) {
+        cache->num_idle++;
+        trim_idle(cache);
+    }
+}
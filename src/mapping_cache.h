@@ -0,0 +1,70 @@
+/**
+ * @file
+ *
+ * This file provides a cache of read-only file mappings, mappings of
+ * recently used files are kept after they are released.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_MAPPING_CACHE_H
+#define DOCSET_MAPPING_CACHE_H
+
+#include "docset.h"
+
+#include <stddef.h>
+
+typedef struct DocSetMappingCache DocSetMappingCache;
+
+typedef struct DocSetMapping
+{
+    /** Contents of the file, not zero-terminated. */
+    const char *data;
+    size_t      size;
+} DocSetMapping;
+
+/**
+ * @brief Creates an empty cache keeping at most @p max_idle mappings
+ * nobody refers to.
+ * @return new cache or NULL if memory could not be allocated.
+ */
+DocSetMappingCache *
+docset_mc_create(size_t max_idle);
+
+/**
+ * @brief Unmaps all the files and frees the cache, all the mappings
+ * MUST be released before.
+ */
+void
+docset_mc_free(DocSetMappingCache *cache);
+
+/**
+ * @brief Changes the number of idle mappings kept, the least recently
+ * used ones are unmapped.
+ */
+void
+docset_mc_set_max_idle(DocSetMappingCache *cache,
+                       size_t              max_idle);
+
+/**
+ * @brief Maps the file at @p path or returns its cached mapping.
+ *
+ * @param hit set to non-zero if the mapping was cached.
+ * @param err set to ::DOCSET_NO_DOCUMENT if the file could not be
+ *        mapped, to ::DOCSET_NO_MEM on memory allocation failure.
+ * @return mapping or NULL on failure.
+ */
+const DocSetMapping *
+docset_mc_acquire(DocSetMappingCache *cache,
+                  const char         *path,
+                  int                *hit,
+                  DocSetError        *err);
+
+/**
+ * @brief Releases the mapping returned by docset_mc_acquire().
+ */
+void
+docset_mc_release(DocSetMappingCache  *cache,
+                  const DocSetMapping *mapping);
+
+#endif
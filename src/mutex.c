@@ -0,0 +1,45 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "mutex.h"
+#include "alloc.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+struct DocSetMutex
+{
+    pthread_mutex_t lock;
+};
+
+DocSetMutex *docset_mutex_create(void)
+{
+    DocSetMutex *mutex = (DocSetMutex *) docset_malloc(sizeof(*mutex));
+
+    if (mutex && pthread_mutex_init(&mutex->lock, NULL) != 0) {
+        docset_free(mutex);
+        return NULL;
+    }
+    return mutex;
+}
+
+void docset_mutex_destroy(DocSetMutex *mutex)
+{
+    if (mutex) {
+        pthread_mutex_destroy(&mutex->lock);
+        docset_free(mutex);
+    }
+}
+
+void docset_mutex_lock(DocSetMutex *mutex)
+{
+    if (mutex) {
+        pthread_mutex_lock(&mutex->lock);
+    }
+}
+
+void docset_mutex_unlock(DocSetMutex *mutex)
+{
+    if (mutex) {
+        pthread_mutex_unlock(&mutex->lock);
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * @file
+ *
+ * This file provides a mutex used to guard docsets shared between
+ * threads.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_MUTEX_H
+#define DOCSET_MUTEX_H
+
+typedef struct DocSetMutex DocSetMutex;
+
+/**
+ * @brief Creates a new mutex.
+ *
+ * @return new mutex or NULL on error.
+ */
+DocSetMutex *
+docset_mutex_create(void);
+
+/**
+ * @brief Destroys the mutex, the mutex pointer is allowed to be NULL.
+ */
+void
+docset_mutex_destroy(DocSetMutex *mutex);
+
+/**
+ * @brief Locks the mutex, does nothing if the mutex is NULL.
+ */
+void
+docset_mutex_lock(DocSetMutex *mutex);
+
+/**
+ * @brief Unlocks the mutex, does nothing if the mutex is NULL.
+ */
+void
+docset_mutex_unlock(DocSetMutex *mutex);
+
+#endif
@@ -0,0 +1,386 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "name_index.h"
+#include "alloc.h"
+#include "stringbuf.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define NAMES_INIT_SIZE 4096
+#define ITEMS_INIT_SIZE 1024
+
+/* SQLite LIKE operator folds only ASCII characters by default. */
+#define FOLD(c) (('A' <= (c) && (c) <= 'Z') ? (c) + ('a' - 'A') : (c))
+
+typedef enum {
+    PLAN_NONE,
+    PLAN_EXACT,
+    PLAN_PREFIX
+} PlanKind;
+
+static int compare_names(const char *a, const char *b)
+{
+    const unsigned char *x = (const unsigned char *)a;
+    const unsigned char *y = (const unsigned char *)b;
+    int d;
+
+    for (;; ++x, ++y) {
+        d = FOLD(*x) - FOLD(*y);
+        if (d != 0 || *x == '\0') {
+            return d;
+        }
+    }
+}
+
+static int compare_prefix(const char *name, const char *prefix, size_t n)
+{
+    const unsigned char *x = (const unsigned char *)name;
+    const unsigned char *y = (const unsigned char *)prefix;
+    int d;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        d = FOLD(x[i]) - FOLD(y[i]);
+        if (d != 0 || x[i] == '\0') {
+            return d;
+        }
+    }
+    return 0;
+}
+
+static int compare_items(const DocSetNameIndex    *index,
+                         const DocSetNameIndexItem *a,
+                         const DocSetNameIndexItem *b)
+{
+    int d = compare_names(index->names + a->name, index->names + b->name);
+    if (d != 0) {
+        return d;
+    }
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+static int compare_ids(const void *a, const void *b)
+{
+    DocSetEntryId x = *(const DocSetEntryId *)a;
+    DocSetEntryId y = *(const DocSetEntryId *)b;
+    return (x > y) - (x < y);
+}
+
+/* The standard qsort doesn't allow to pass the names block to the
+ * comparator, so here is a plain top-down merge sort. */
+static void sort_items(const DocSetNameIndex *index,
+                       DocSetNameIndexItem   *items,
+                       DocSetNameIndexItem   *tmp,
+                       size_t                 n)
+{
+    size_t m, i, j, k;
+
+    if (n < 2) {
+        return;
+    }
+
+    m = n / 2;
+    sort_items(index, items, tmp, m);
+    sort_items(index, items + m, tmp, n - m);
+
+    for (i = 0, j = m, k = 0; i < m && j < n; ++k) {
+        if (compare_items(index, items + j, items + i) < 0) {
+            tmp[k] = items[j++];
+        } else {
+            tmp[k] = items[i++];
+        }
+    }
+    while (i < m) {
+        tmp[k++] = items[i++];
+    }
+    while (j < n) {
+        tmp[k++] = items[j++];
+    }
+    memcpy(items, tmp, n * sizeof(*items));
+}
+
+/* Lays out the names in the order of items, so that scans over the
+ * index read the names block sequentially. */
+static int sort_names(DocSetNameIndex *index)
+{
+    char *names = (char *) docset_malloc(index->names_size);
+    size_t offset = 0;
+    size_t i, len;
+
+    if (!names) {
+        return 0;
+    }
+
+    for (i = 0; i < index->num_items; ++i) {
+        const char *name = index->names + index->items[i].name;
+
+        len = strlen(name) + 1;
+        memcpy(names + offset, name, len);
+        index->items[i].name = (unsigned int)offset;
+        offset += len;
+    }
+
+    docset_free(index->names);
+    index->names = names;
+    index->names_size = offset;
+    return 1;
+}
+
+static PlanKind plan_pattern(const char *pattern, size_t *literal_len)
+{
+    size_t n = strcspn(pattern, "%_");
+    const char *p;
+
+    *literal_len = n;
+
+    if (pattern[n] == '\0') {
+        return PLAN_EXACT;
+    }
+    if (pattern[n] == '_' || n == 0) {
+        /* Single character wildcards can't be answered by the index,
+         * patterns without literal prefix match almost everything. */
+        return PLAN_NONE;
+    }
+    for (p = pattern + n; *p != '\0'; ++p) {
+        if (*p != '%') {
+            return PLAN_NONE;
+        }
+    }
+    return PLAN_PREFIX;
+}
+
+/* Returns the first item for which the comparison result is greater
+ * than (strict = 1) or greater or equal to (strict = 0) zero. */
+static size_t bound(const DocSetNameIndex *index,
+                    PlanKind               plan,
+                    const char            *literal,
+                    size_t                 literal_len,
+                    int                    strict)
+{
+    size_t l = 0;
+    size_t h = index->num_items;
+
+    while (l < h) {
+        size_t m = l + (h - l) / 2;
+        const char *name = index->names + index->items[m].name;
+        int cmp = (plan == PLAN_EXACT)
+                  ? compare_names(name, literal)
+                  : compare_prefix(name, literal, literal_len);
+
+        if (cmp > 0 || (!strict && cmp == 0)) {
+            h = m;
+        } else {
+            l = m + 1;
+        }
+    }
+    return l;
+}
+
+static unsigned long char_class_bit(unsigned char c)
+{
+    c = FOLD(c);
+    if ('a' <= c && c <= 'z') {
+        return 1UL << (c - 'a');
+    }
+    if ('0' <= c && c <= '9') {
+        return 1UL << 26;
+    }
+    switch (c) {
+    case '_':
+        return 1UL << 27;
+    case ':':
+        return 1UL << 28;
+    case '.':
+        return 1UL << 29;
+    default:
+        return 1UL << 30;
+    }
+}
+
+DocSetNameIndex *docset_ni_build(sqlite3 *db, const char *query)
+{
+    DocSetNameIndex *index;
+    DocSetNameIndexItem *tmp;
+    DocSetStringBuf names;
+    sqlite3_stmt *stmt = NULL;
+    size_t capacity = 0;
+    size_t i;
+    int rc;
+
+    index = (DocSetNameIndex *) docset_calloc(1, sizeof(*index));
+    if (!index) {
+        return NULL;
+    }
+
+    if (!docset_sb_init(&names, NAMES_INIT_SIZE)) {
+        docset_free(index);
+        return NULL;
+    }
+
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) != SQLITE_OK) {
+        goto fail;
+    }
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *name = (const char *)sqlite3_column_text(stmt, 1);
+        size_t len = (size_t)sqlite3_column_bytes(stmt, 1);
+        DocSetNameIndexItem *item;
+
+        if (!name) {
+            continue;
+        }
+
+        if (index->num_items == capacity) {
+            size_t new_cap = capacity ? capacity * 2 : ITEMS_INIT_SIZE;
+            DocSetNameIndexItem *items = (DocSetNameIndexItem *)
+                docset_realloc(index->items, new_cap * sizeof(*items));
+            if (!items) {
+                goto fail;
+            }
+            index->items = items;
+            capacity = new_cap;
+        }
+
+        /* Name offsets must fit into the item. */
+        if (names.size + len + 1 > UINT_MAX
+            || !docset_sb_reserve(&names, names.size + len + 1)) {
+            goto fail;
+        }
+
+        item = index->items + index->num_items++;
+        item->id = sqlite3_column_int(stmt, 0);
+        item->name = (unsigned int)names.size;
+
+        memcpy(names.data + names.size, name, len);
+        names.data[names.size + len] = '\0';
+        names.size += len + 1;
+    }
+
+    if (rc != SQLITE_DONE) {
+        goto fail;
+    }
+
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+
+    index->names = names.data;
+    index->names_size = names.size;
+    names.data = NULL;
+
+    if (index->num_items > 1) {
+        tmp = (DocSetNameIndexItem *)
+            docset_malloc(index->num_items * sizeof(*tmp));
+        if (!tmp) {
+            goto fail;
+        }
+        sort_items(index, index->items, tmp, index->num_items);
+        docset_free(tmp);
+    }
+
+    if (index->num_items > 1 && !sort_names(index)) {
+        goto fail;
+    }
+
+    if (index->num_items > 0) {
+        index->masks = (unsigned long *)
+            docset_malloc(index->num_items * sizeof(*index->masks));
+        if (!index->masks) {
+            goto fail;
+        }
+        for (i = 0; i < index->num_items; ++i) {
+            index->masks[i] =
+                docset_ni_char_mask(index->names + index->items[i].name);
+        }
+    }
+
+    return index;
+
+fail:
+    sqlite3_finalize(stmt);
+    docset_sb_destroy(&names);
+    docset_ni_free(index);
+    return NULL;
+}
+
+void docset_ni_free(DocSetNameIndex *index)
+{
+    if (!index) {
+        return;
+    }
+    if (index->mapping) {
+        munmap(index->mapping, index->mapping_size);
+    } else {
+        docset_free(index->items);
+        docset_free(index->masks);
+        docset_free(index->names);
+    }
+    docset_free(index);
+}
+
+int docset_ni_lookup(const DocSetNameIndex *index,
+                     const char            *pattern,
+                     DocSetEntryId        **ids,
+                     size_t                *num_ids)
+{
+    size_t literal_len;
+    size_t lo, hi, i;
+    PlanKind plan = plan_pattern(pattern, &literal_len);
+
+    *ids = NULL;
+    *num_ids = 0;
+
+    if (plan == PLAN_NONE) {
+        return 0;
+    }
+
+    lo = bound(index, plan, pattern, literal_len, 0);
+    hi = bound(index, plan, pattern, literal_len, 1);
+
+    if (lo == hi) {
+        return 1;
+    }
+
+    *ids = (DocSetEntryId *) docset_malloc((hi - lo) * sizeof(**ids));
+    if (!*ids) {
+        return -1;
+    }
+
+    for (i = lo; i < hi; ++i) {
+        (*ids)[i - lo] = index->items[i].id;
+    }
+    *num_ids = hi - lo;
+
+    qsort(*ids, *num_ids, sizeof(**ids), compare_ids);
+
+    return 1;
+}
+
+void docset_ni_prefix_range(const DocSetNameIndex *index,
+                            const char            *prefix,
+                            size_t                 len,
+                            size_t                *lo,
+                            size_t                *hi)
+{
+    *lo = bound(index, PLAN_PREFIX, prefix, len, 0);
+    *hi = bound(index, PLAN_PREFIX, prefix, len, 1);
+}
+
+unsigned long docset_ni_char_mask(const char *s)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    unsigned long mask = 0;
+
+    for (; *p; ++p) {
+        mask |= char_class_bit(*p);
+    }
+    return mask;
+}
+
+const char *docset_ni_name(const DocSetNameIndex     *index,
+                           const DocSetNameIndexItem *item)
+{
+    return index->names + item->name;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file
+ *
+ * This file provides an in-memory index of entry names sorted in the
+ * order used by the SQL LIKE operator (ASCII case-insensitive).
+ *
+ * The index allows to answer exact and prefix patterns with a binary
+ * search instead of a full index table scan.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_NAME_INDEX_H
+#define DOCSET_NAME_INDEX_H
+
+#include "docset.h"
+
+#include <stddef.h>
+#include <sqlite3.h>
+
+typedef struct {
+    /** Offset of the zero-terminated name in the names block. */
+    unsigned int name;
+    DocSetEntryId id;
+} DocSetNameIndexItem;
+
+typedef struct {
+    DocSetNameIndexItem *items;
+    /** Character masks of the item names, see docset_ni_char_mask(). */
+    unsigned long       *masks;
+    size_t               num_items;
+    char                *names;
+    size_t               names_size;
+    /** If not NULL, all the arrays point into this read-only file
+     * mapping, see index_file.h. */
+    void                *mapping;
+    size_t               mapping_size;
+} DocSetNameIndex;
+
+/**
+ * @brief Builds a name index from the results of the @p query.
+ *
+ * The query must return entry id in the first column and entry name in
+ * the second one.
+ *
+ * @return new index or NULL on error.
+ */
+DocSetNameIndex *
+docset_ni_build(sqlite3    *db,
+                const char *query);
+
+/**
+ * @brief Deallocates the memory owned by an index.
+ * The index pointer is allowed to be NULL.
+ */
+void
+docset_ni_free(DocSetNameIndex *index);
+
+/**
+ * @brief Looks up all the entries matching the LIKE @p pattern.
+ *
+ * Only exact and prefix (`abc%`) patterns could be answered by the
+ * index.
+ *
+ * @param ids sink for a newly allocated vector of matching entry ids
+ *        sorted in ascending order. It's set to NULL if nothing was
+ *        found.
+ * @param num_ids sink for the number of matching entries
+ * @return 1 if the pattern was answered by the index,
+ *         0 if the pattern must be answered by the database,
+ *        -1 on memory allocation error.
+ */
+int
+docset_ni_lookup(const DocSetNameIndex *index,
+                 const char            *pattern,
+                 DocSetEntryId        **ids,
+                 size_t                *num_ids);
+
+/**
+ * @brief Finds the range [@p lo, @p hi) of items whose names start with
+ * the @p prefix of @p len characters (ASCII case-insensitive).
+ */
+void
+docset_ni_prefix_range(const DocSetNameIndex *index,
+                       const char            *prefix,
+                       size_t                 len,
+                       size_t                *lo,
+                       size_t                *hi);
+
+/**
+ * @brief Returns the set of character classes occurring in @p s.
+ *
+ * Letters are case-folded and have a bit each, digits and some
+ * punctuation characters share bits. If a name contains all the
+ * characters of a query in any order, its mask includes the mask of the
+ * query.
+ */
+unsigned long
+docset_ni_char_mask(const char *s);
+
+/**
+ * @brief Returns name of the index item.
+ */
+const char *
+docset_ni_name(const DocSetNameIndex     *index,
+               const DocSetNameIndexItem *item);
+
+#endif
@@ -1,112 +1,478 @@
 #include "prop_parser.h"
+#include "alloc.h"
 #include "stringbuf.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <libxml/parser.h>
-#include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 
 #define NAME_EQ(x, y) \
-    (xmlStrcmp((x)->name, (const xmlChar *)(y)) == 0)
+    (xmlStrcmp((x), (const xmlChar *)(y)) == 0)
 
 #define STR_EQ(x, y) \
     (strcmp(x, y) == 0)
 
-static xmlNode *advance_to_dict(xmlNode *root)
+#define BPLIST_MAGIC "bplist00"
+#define BPLIST_MAGIC_SIZE 8
+#define BPLIST_TRAILER_SIZE 32
+#define BPLIST_MAX_SIZE (16 * 1024 * 1024)
+
+/* Object markers of the binary property list format. */
+#define BP_FALSE 0x08
+#define BP_TRUE 0x09
+#define BP_INT 0x1
+#define BP_ASCII 0x5
+#define BP_UTF16 0x6
+#define BP_DICT 0xD
+
+typedef struct PropSet
 {
-    if (root && NAME_EQ(root, "plist")) {
-        for (root = root->children;
-             root != NULL;
-             root = root->next) {
-            if (NAME_EQ(root, "dict")) {
-                return root->children;
-            }
-        }
+    DocSetProp *begin;
+    DocSetProp *end;
+    unsigned char *found;
+    size_t remaining;
+    DocSetStringBuf buf;
+} PropSet;
+
+typedef struct BinaryPlist
+{
+    const unsigned char *data;
+    size_t size;
+    size_t offset_size;
+    size_t ref_size;
+    size_t num_objects;
+    size_t offsets;
+    size_t limit;
+} BinaryPlist;
+
+static int props_init(PropSet *set, DocSetProp *begin, DocSetProp *end);
+
+static void props_destroy(PropSet *set);
+
+static DocSetProp *find_prop(PropSet *set, const char *name);
+
+static int set_string(PropSet *set, DocSetProp *prop);
+
+static void set_bool(PropSet *set, DocSetProp *prop, int value);
+
+static int parse_xml(const char *path, PropSet *set);
+
+static int parse_binary(FILE *f, PropSet *set);
+
+static int read_binary_dict(BinaryPlist *bp, PropSet *set, size_t ref);
+
+static int read_uint(const unsigned char *p, size_t n, size_t *value);
+
+static int fits(const BinaryPlist *bp, const unsigned char *p, size_t n);
+
+static int read_object(BinaryPlist *bp, size_t ref, unsigned *type,
+                       const unsigned char **payload, size_t *count);
+
+static int read_string(BinaryPlist *bp, size_t ref, DocSetStringBuf *buf);
+
+static int utf16_to_utf8(const unsigned char *s, size_t n,
+                         DocSetStringBuf *buf);
+
+int docset_parse_properties(const char *path,
+                            DocSetProp *begin,
+                            DocSetProp *end)
+{
+    char magic[BPLIST_MAGIC_SIZE];
+    PropSet set;
+    FILE *f;
+    int success = 0;
+
+    if (!props_init(&set, begin, end)) {
+        return 0;
+    }
+
+    if (!(f = fopen(path, "rb"))) {
+        goto exit;
     }
-    return NULL;
+
+    if (fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+        && memcmp(magic, BPLIST_MAGIC, sizeof(magic)) == 0) {
+        success = parse_binary(f, &set);
+        fclose(f);
+    } else {
+        fclose(f);
+        success = parse_xml(path, &set);
+    }
+
+exit:
+    props_destroy(&set);
+    return success;
 }
 
-static void copy_tag_value_to(xmlDoc          *doc,
-                              xmlNode         *node,
-                              DocSetStringBuf *buf)
+static int props_init(PropSet *set, DocSetProp *begin, DocSetProp *end)
 {
-    xmlChar * name =
-        xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
+    set->begin = begin;
+    set->end = end;
+    set->remaining = (size_t)(end - begin);
+    set->found = (unsigned char *) docset_calloc(set->remaining + 1, 1);
 
-    const char * name_string = (const char *)name;
-
-    docset_sb_assign(buf, name_string, (size_t)strlen(name_string));
+    if (!set->found) {
+        return 0;
+    }
+    if (!docset_sb_init(&set->buf, 32)) {
+        docset_free(set->found);
+        return 0;
+    }
+    return 1;
+}
 
-    xmlFree(name);
+static void props_destroy(PropSet *set)
+{
+    docset_free(set->found);
+    docset_sb_destroy(&set->buf);
 }
 
-static DocSetProp *find_prop(const char *name,
-                             DocSetProp *begin,
-                             DocSetProp *end)
+/* Returns the property with the given name that has no value yet. */
+static DocSetProp *find_prop(PropSet *set, const char *name)
 {
     DocSetProp *prop;
-    for (prop = begin; prop != end; ++prop) {
-        if (STR_EQ(name, prop->name)) break;
+
+    for (prop = set->begin; prop != set->end; ++prop) {
+        if (STR_EQ(name, prop->name)) {
+            return set->found[prop - set->begin] ? set->end : prop;
+        }
     }
-    return prop;
+    return set->end;
 }
 
-int docset_parse_properties(const char *path,
-                            DocSetProp *begin,
-                            DocSetProp *end)
+/* Moves the string accumulated in the buffer to the property. */
+static int set_string(PropSet *set, DocSetProp *prop)
 {
-    xmlDoc     *doc;
-    xmlNode    *root;
-    xmlNode    *dict;
-    DocSetProp *prop = end;
-    int      success = 0;
-    DocSetStringBuf buf;
-
-    doc = xmlParseFile(path);
+    char *value = docset_sb_new_string(&set->buf);
 
-    if (!doc)
+    if (!value) {
         return 0;
+    }
+    *prop->target.str_target = value;
+    set->found[prop - set->begin] = 1;
+    set->remaining--;
+    return 1;
+}
 
-    root = xmlDocGetRootElement(doc);
+static void set_bool(PropSet *set, DocSetProp *prop, int value)
+{
+    *prop->target.bool_target = value;
+    set->found[prop - set->begin] = 1;
+    set->remaining--;
+}
 
-    if (root == NULL)
-        goto exit;
+/* Reads the top-level dictionary of an XML property list element by
+ * element, the rest of the file is skipped once all the properties are
+ * found. */
+static int parse_xml(const char *path, PropSet *set)
+{
+    xmlTextReaderPtr reader;
+    const xmlChar *name;
+    xmlChar *text;
+    DocSetProp *prop = set->end;
+    int in_dict = 0;
+    int seen_dict = 0;
+    int depth;
+    int rc = 1;
+    int success = 1;
 
-    if (!docset_sb_init(&buf, 20))
-        goto exit;
+    reader = xmlReaderForFile(path, NULL, XML_PARSE_NONET);
+    if (!reader) {
+        return 0;
+    }
 
-    for (dict = advance_to_dict(root);
-         dict != NULL;
-         dict = dict->next) {
+    while (set->remaining > 0 && (rc = xmlTextReaderRead(reader)) == 1) {
+        depth = xmlTextReaderDepth(reader);
+        name = xmlTextReaderConstName(reader);
 
-        if (NAME_EQ(dict, "key")) {
-            copy_tag_value_to(doc, dict, &buf);
-            prop = find_prop(buf.data, begin, end);
+        if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_END_ELEMENT) {
+            if (in_dict && depth == 1) {
+                break;
+            }
             continue;
         }
 
-        if (prop != end
-            && NAME_EQ(dict, "string")
-            && prop->type == DOCSET_PROP_STRING) {
+        if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+            continue;
+        }
+
+        if (depth == 0 && !NAME_EQ(name, "plist")) {
+            break;
+        }
 
-            copy_tag_value_to(doc, dict, &buf);
-            *prop->target.str_target = docset_sb_new_string(&buf);
-            prop = end;
+        if (depth == 1 && NAME_EQ(name, "dict") && !seen_dict) {
+            seen_dict = 1;
+            in_dict = !xmlTextReaderIsEmptyElement(reader);
+            if (!in_dict) {
+                break;
+            }
             continue;
         }
 
-        if (prop != end
-            && (NAME_EQ(dict, "true") || NAME_EQ(dict, "false"))
-            && prop->type == DOCSET_PROP_BOOL) {
+        if (!in_dict || depth != 2) {
+            continue;
+        }
 
-            *prop->target.bool_target = NAME_EQ(dict, "true");
+        if (NAME_EQ(name, "key")) {
+            text = xmlTextReaderReadString(reader);
+            prop = text ? find_prop(set, (const char *)text) : set->end;
+            xmlFree(text);
+            continue;
         }
+
+        if (prop != set->end
+            && NAME_EQ(name, "string")
+            && prop->type == DOCSET_PROP_STRING) {
+            text = xmlTextReaderReadString(reader);
+            docset_sb_assign(&set->buf,
+                             text ? (const char *)text : "",
+                             text ? strlen((const char *)text) : 0);
+            xmlFree(text);
+            if (!set_string(set, prop)) {
+                success = 0;
+                break;
+            }
+        } else if (prop != set->end
+                   && (NAME_EQ(name, "true") || NAME_EQ(name, "false"))
+                   && prop->type == DOCSET_PROP_BOOL) {
+            set_bool(set, prop, NAME_EQ(name, "true"));
+        }
+        prop = set->end;
+    }
+
+    if (set->remaining > 0 && rc < 0) {
+        success = 0;
     }
 
-    success = 1;
-    docset_sb_destroy(&buf);
+    xmlFreeTextReader(reader);
+    return success;
+}
+
+static int parse_binary(FILE *f, PropSet *set)
+{
+    const unsigned char *trailer;
+    unsigned char *data = NULL;
+    BinaryPlist bp;
+    size_t top;
+    long size;
+    int success = 0;
+
+    if (fseek(f, 0, SEEK_END) != 0
+        || (size = ftell(f)) < BPLIST_MAGIC_SIZE + BPLIST_TRAILER_SIZE
+        || size > BPLIST_MAX_SIZE
+        || fseek(f, 0, SEEK_SET) != 0) {
+        return 0;
+    }
+
+    if (!(data = (unsigned char *) docset_malloc((size_t)size))) {
+        return 0;
+    }
+    if (fread(data, 1, (size_t)size, f) != (size_t)size) {
+        goto exit;
+    }
+
+    bp.data = data;
+    bp.size = (size_t)size;
+
+    /* The trailer: 6 unused bytes, the offset and the object reference
+     * sizes, then 64-bit object count, top object and offset table. */
+    trailer = data + bp.size - BPLIST_TRAILER_SIZE;
+    bp.offset_size = trailer[6];
+    bp.ref_size = trailer[7];
+
+    if (bp.offset_size == 0 || bp.ref_size == 0
+        || !read_uint(trailer + 8, 8, &bp.num_objects)
+        || !read_uint(trailer + 16, 8, &top)
+        || !read_uint(trailer + 24, 8, &bp.offsets)
+        || bp.offsets >= bp.size
+        || bp.offset_size > sizeof(size_t)
+        || bp.ref_size > sizeof(size_t)
+        || bp.num_objects > (bp.size - bp.offsets) / bp.offset_size) {
+        goto exit;
+    }
+
+    /* Objects are stored between the header and the offset table. */
+    bp.limit = bp.offsets;
+
+    success = read_binary_dict(&bp, set, top);
 
 exit:
-    xmlFreeDoc(doc);
+    docset_free(data);
     return success;
 }
+
+/* Looks up the top-level dictionary for the properties, the values of
+ * other keys are never decoded. */
+static int read_binary_dict(BinaryPlist *bp, PropSet *set, size_t ref)
+{
+    const unsigned char *dict;
+    const unsigned char *value;
+    DocSetProp *prop;
+    unsigned type;
+    size_t n, i, key_ref, value_ref, len;
+
+    if (!read_object(bp, ref, &type, &dict, &n)
+        || type != BP_DICT
+        || n > bp->limit / (2 * bp->ref_size)
+        || !fits(bp, dict, 2 * n * bp->ref_size)) {
+        return 0;
+    }
+
+    for (i = 0; set->remaining > 0 && i < n; ++i) {
+        if (!read_uint(dict + i * bp->ref_size, bp->ref_size, &key_ref)
+            || !read_uint(dict + (n + i) * bp->ref_size, bp->ref_size,
+                          &value_ref)
+            || !read_string(bp, key_ref, &set->buf)) {
+            return 0;
+        }
+
+        prop = find_prop(set, set->buf.data);
+        if (prop == set->end) {
+            continue;
+        }
+
+        if (!read_object(bp, value_ref, &type, &value, &len)) {
+            return 0;
+        }
+
+        if (prop->type == DOCSET_PROP_STRING
+            && (type == BP_ASCII || type == BP_UTF16)) {
+            if (!read_string(bp, value_ref, &set->buf)
+                || !set_string(set, prop)) {
+                return 0;
+            }
+        } else if (prop->type == DOCSET_PROP_BOOL && type == 0
+                   && (len == BP_TRUE || len == BP_FALSE)) {
+            set_bool(set, prop, len == BP_TRUE);
+        }
+    }
+    return 1;
+}
+
+/* Reads a big-endian unsigned integer of n bytes. */
+static int read_uint(const unsigned char *p, size_t n, size_t *value)
+{
+    size_t v = 0;
+
+    for (; n > 0; --n, ++p) {
+        if (v > ((size_t)-1 >> 8)) {
+            return 0;
+        }
+        v = (v << 8) | *p;
+    }
+    *value = v;
+    return 1;
+}
+
+static int fits(const BinaryPlist *bp, const unsigned char *p, size_t n)
+{
+    return p >= bp->data && p <= bp->data + bp->limit
+           && n <= (size_t)(bp->data + bp->limit - p);
+}
+
+/* Finds the object by its reference, returns its type, the start of its
+ * payload and the number of items in it. For the simple objects the
+ * count is the low nibble of the marker. */
+static int read_object(BinaryPlist *bp, size_t ref, unsigned *type,
+                       const unsigned char **payload, size_t *count)
+{
+    const unsigned char *p;
+    size_t offset, size;
+
+    if (ref >= bp->num_objects
+        || !read_uint(bp->data + bp->offsets + ref * bp->offset_size,
+                      bp->offset_size, &offset)
+        || offset < BPLIST_MAGIC_SIZE
+        || offset >= bp->limit) {
+        return 0;
+    }
+
+    p = bp->data + offset;
+    *type = *p >> 4;
+    *count = *p & 0xF;
+    ++p;
+
+    /* Larger counts follow the marker as an integer object. */
+    if (*type != 0 && *count == 0xF) {
+        if (!fits(bp, p, 1) || (*p >> 4) != BP_INT) {
+            return 0;
+        }
+        size = (size_t)1 << (*p & 0xF);
+        ++p;
+        if (size > sizeof(size_t) || !fits(bp, p, size)
+            || !read_uint(p, size, count)) {
+            return 0;
+        }
+        p += size;
+    }
+
+    *payload = p;
+    return 1;
+}
+
+static int read_string(BinaryPlist *bp, size_t ref, DocSetStringBuf *buf)
+{
+    const unsigned char *s;
+    unsigned type;
+    size_t n;
+
+    if (!read_object(bp, ref, &type, &s, &n)) {
+        return 0;
+    }
+
+    if (type == BP_ASCII && fits(bp, s, n)) {
+        return docset_sb_assign(buf, (const char *)s, n);
+    }
+    if (type == BP_UTF16 && n <= bp->limit / 2 && fits(bp, s, 2 * n)) {
+        return utf16_to_utf8(s, n, buf);
+    }
+    return 0;
+}
+
+static int utf16_to_utf8(const unsigned char *s, size_t n,
+                         DocSetStringBuf *buf)
+{
+    unsigned long c, low;
+    size_t i;
+    char *out;
+
+    /* A UTF-16 unit takes at most 3 bytes in UTF-8, a surrogate pair
+     * takes 4 bytes for 2 units. */
+    if (!docset_sb_reserve(buf, 3 * n + 1)) {
+        return 0;
+    }
+    out = buf->data;
+
+    for (i = 0; i < n; ++i) {
+        c = ((unsigned long)s[2 * i] << 8) | s[2 * i + 1];
+
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < n) {
+            low = ((unsigned long)s[2 * i + 2] << 8) | s[2 * i + 3];
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                ++i;
+            }
+        }
+
+        if (c < 0x80) {
+            *out++ = (char)c;
+        } else if (c < 0x800) {
+            *out++ = (char)(0xC0 | (c >> 6));
+            *out++ = (char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            *out++ = (char)(0xE0 | (c >> 12));
+            *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+            *out++ = (char)(0x80 | (c & 0x3F));
+        } else {
+            *out++ = (char)(0xF0 | (c >> 18));
+            *out++ = (char)(0x80 | ((c >> 12) & 0x3F));
+            *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+            *out++ = (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    *out = '\0';
+    buf->size = (size_t)(out - buf->data);
+    return 1;
+}
@@ -15,6 +15,9 @@ typedef struct {
     } target;
 } DocSetProp;
 
+/* Reads values of the given properties from the top-level dictionary of
+ * an XML or a binary property list. Parsing stops as soon as all the
+ * properties are found. */
 int docset_parse_properties(const char *path,
                             DocSetProp *begin,
                             DocSetProp *end);
@@ -0,0 +1,106 @@
+#include "rank.h"
+
+#include <string.h>
+
+#define FOLD(c) (('A' <= (c) && (c) <= 'Z') ? (c) + ('a' - 'A') : (c))
+
+#define IS_LOWER(c) ('a' <= (c) && (c) <= 'z')
+#define IS_UPPER(c) ('A' <= (c) && (c) <= 'Z')
+#define IS_DIGIT(c) ('0' <= (c) && (c) <= '9')
+
+#define MAX_LENGTH 0xFFFFUL
+
+/* Score layout: match class, type weight, name length. */
+#define SCORE(m, weight, len)                                   \
+    (((unsigned long)(m) << 24)                                 \
+     | ((unsigned long)((weight) < DOCSET_RANK_MAX_WEIGHT       \
+                        ? (weight) : DOCSET_RANK_MAX_WEIGHT) << 16) \
+     | ((len) < MAX_LENGTH ? (unsigned long)(len) : MAX_LENGTH))
+
+typedef enum {
+    MATCH_EXACT,
+    MATCH_PREFIX,
+    MATCH_WORD,
+    MATCH_SUBSTRING,
+    MATCH_OTHER
+} MatchClass;
+
+static int starts_with(const char *s, const char *prefix, size_t n)
+{
+    const unsigned char *x = (const unsigned char *)s;
+    const unsigned char *y = (const unsigned char *)prefix;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        if (x[i] == '\0' || FOLD(x[i]) != FOLD(y[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Returns non-zero if a word starts at the position i > 0. */
+static int is_word_start(const unsigned char *s, size_t i)
+{
+    unsigned char prev = s[i - 1];
+
+    if (IS_LOWER(prev) && IS_UPPER(s[i])) {
+        return 1;
+    }
+    return !IS_LOWER(prev) && !IS_UPPER(prev) && !IS_DIGIT(prev);
+}
+
+size_t docset_rank_needle(const char *pattern, const char **needle)
+{
+    size_t best = 0;
+    size_t n;
+
+    *needle = pattern;
+
+    while (*pattern) {
+        n = strcspn(pattern, "%_");
+        if (n > best) {
+            best = n;
+            *needle = pattern;
+        }
+        pattern += n;
+        if (*pattern) {
+            ++pattern;
+        }
+    }
+    return best;
+}
+
+unsigned long docset_rank_score(const char *name,
+                                size_t      name_len,
+                                const char *needle,
+                                size_t      needle_len,
+                                unsigned    weight)
+{
+    MatchClass m = MATCH_OTHER;
+    size_t i;
+
+    if (starts_with(name, needle, needle_len)) {
+        m = (name_len == needle_len) ? MATCH_EXACT : MATCH_PREFIX;
+    } else {
+        for (i = 1; i + needle_len <= name_len; ++i) {
+            if (starts_with(name + i, needle, needle_len)) {
+                if (is_word_start((const unsigned char *)name, i)) {
+                    m = MATCH_WORD;
+                    break;
+                }
+                m = MATCH_SUBSTRING;
+            }
+        }
+    }
+
+    return SCORE(m, weight, name_len);
+}
+
+unsigned long docset_rank_best(size_t   name_len,
+                               size_t   needle_len,
+                               unsigned weight)
+{
+    return SCORE(name_len == needle_len ? MATCH_EXACT : MATCH_PREFIX,
+                 weight, name_len);
+}
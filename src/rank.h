@@ -0,0 +1,56 @@
+/**
+ * @file
+ *
+ * This file provides functions to rank entry names against a search
+ * pattern.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_RANK_H
+#define DOCSET_RANK_H
+
+#include <stddef.h>
+
+/**
+ * @brief Finds the longest run of literal characters in a LIKE
+ * pattern, i.e. the part of the pattern names are ranked against.
+ *
+ * @return length of the needle.
+ */
+size_t
+docset_rank_needle(const char  *pattern,
+                   const char **needle);
+
+/** Largest type weight, see docset_set_type_weight(). */
+#define DOCSET_RANK_MAX_WEIGHT 0xFFU
+
+/**
+ * @brief Ranks the @p name against the @p needle.
+ *
+ * Exact matches rank better than prefix matches, which rank better
+ * than matches at a word boundary (after a separator or at a camel case
+ * hump), which rank better than other substring matches. Matches of the
+ * same kind are ordered by the @p weight, then shorter names rank
+ * better than longer ones. Comparison is ASCII case-insensitive.
+ *
+ * @param weight type weight, at most DOCSET_RANK_MAX_WEIGHT
+ * @return ranking score, smaller is better.
+ */
+unsigned long
+docset_rank_score(const char *name,
+                  size_t      name_len,
+                  const char *needle,
+                  size_t      needle_len,
+                  unsigned    weight);
+
+/**
+ * @brief Returns the best score a name of @p name_len characters could
+ * get, it allows to skip ranking hopeless names.
+ */
+unsigned long
+docset_rank_best(size_t   name_len,
+                 size_t   needle_len,
+                 unsigned weight);
+
+#endif
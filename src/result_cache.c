@@ -0,0 +1,240 @@
+#include "result_cache.h"
+#include "alloc.h"
+#include "hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BUCKETS_INIT_SIZE 64
+
+typedef struct CacheItem
+{
+    /* Items are listed from the most to the least recently used. */
+    struct CacheItem *prev;
+    struct CacheItem *next;
+    /* Next item of the same bucket. */
+    struct CacheItem *chain;
+    unsigned long hash;
+    size_t size;
+    DocSetSharedRows *rows;
+    char *key;
+} CacheItem;
+
+struct DocSetResultCache
+{
+    CacheItem **buckets;
+    size_t num_buckets;
+    size_t num_items;
+    CacheItem *first;
+    CacheItem *last;
+    size_t size;
+    size_t max_size;
+};
+
+static CacheItem **find_item(DocSetResultCache *cache,
+                             const char        *key,
+                             unsigned long      hash);
+
+static void unlink_item(DocSetResultCache *cache, CacheItem *item);
+
+static void push_front(DocSetResultCache *cache, CacheItem *item);
+
+static void free_item(CacheItem *item);
+
+static void evict_last(DocSetResultCache *cache);
+
+static int grow_buckets(DocSetResultCache *cache);
+
+/* Returns the link pointing to the item with the key, the link points
+ * to NULL if there is no such item. */
+static CacheItem **find_item(DocSetResultCache *cache,
+                             const char        *key,
+                             unsigned long      hash)
+{
+    CacheItem **link = cache->buckets + hash % cache->num_buckets;
+
+    while (*link && ((*link)->hash != hash || strcmp((*link)->key, key))) {
+        link = &(*link)->chain;
+    }
+    return link;
+}
+
+static void unlink_item(DocSetResultCache *cache, CacheItem *item)
+{
+    if (item->prev) {
+        item->prev->next = item->next;
+    } else {
+        cache->first = item->next;
+    }
+    if (item->next) {
+        item->next->prev = item->prev;
+    } else {
+        cache->last = item->prev;
+    }
+    item->prev = item->next = NULL;
+}
+
+static void push_front(DocSetResultCache *cache, CacheItem *item)
+{
+    item->prev = NULL;
+    item->next = cache->first;
+    if (cache->first) {
+        cache->first->prev = item;
+    } else {
+        cache->last = item;
+    }
+    cache->first = item;
+}
+
+static void free_item(CacheItem *item)
+{
+    docset_rows_release_shared(item->rows);
+    docset_free(item->key);
+    docset_free(item);
+}
+
+static void evict_last(DocSetResultCache *cache)
+{
+    CacheItem *item = cache->last;
+    CacheItem **link = find_item(cache, item->key, item->hash);
+
+    *link = item->chain;
+    unlink_item(cache, item);
+    cache->size -= item->size;
+    cache->num_items--;
+    free_item(item);
+}
+
+static int grow_buckets(DocSetResultCache *cache)
+{
+    size_t n = cache->num_buckets * 2;
+    CacheItem **buckets = (CacheItem **) docset_calloc(n, sizeof(*buckets));
+    CacheItem *item;
+
+    if (!buckets) {
+        return 0;
+    }
+
+    for (item = cache->first; item; item = item->next) {
+        item->chain = buckets[item->hash % n];
+        buckets[item->hash % n] = item;
+    }
+
+    docset_free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = n;
+    return 1;
+}
+
+DocSetResultCache *docset_rc_create(size_t max_bytes)
+{
+    DocSetResultCache *cache;
+
+    cache = (DocSetResultCache *) docset_calloc(1, sizeof(*cache));
+    if (!cache) {
+        return NULL;
+    }
+
+    cache->buckets = (CacheItem **)
+        docset_calloc(BUCKETS_INIT_SIZE, sizeof(*cache->buckets));
+    if (!cache->buckets) {
+        docset_free(cache);
+        return NULL;
+    }
+
+    cache->num_buckets = BUCKETS_INIT_SIZE;
+    cache->max_size = max_bytes;
+    return cache;
+}
+
+void docset_rc_free(DocSetResultCache *cache)
+{
+    CacheItem *item, *next;
+
+    if (!cache) {
+        return;
+    }
+
+    for (item = cache->first; item; item = next) {
+        next = item->next;
+        free_item(item);
+    }
+    docset_free(cache->buckets);
+    docset_free(cache);
+}
+
+void docset_rc_clear(DocSetResultCache *cache)
+{
+    while (cache->last) {
+        evict_last(cache);
+    }
+}
+
+DocSetSharedRows *docset_rc_lookup(DocSetResultCache *cache,
+                                   const char        *key)
+{
+    unsigned long hash = docset_hash(key, strlen(key));
+    CacheItem *item = *find_item(cache, key, hash);
+
+    if (!item) {
+        return NULL;
+    }
+
+    unlink_item(cache, item);
+    push_front(cache, item);
+    item->rows->refs++;
+    return item->rows;
+}
+
+int docset_rc_insert(DocSetResultCache *cache,
+                     const char        *key,
+                     DocSetSharedRows  *rows)
+{
+    size_t key_len = strlen(key);
+    unsigned long hash = docset_hash(key, key_len);
+    CacheItem **link;
+    CacheItem *item;
+    size_t size;
+
+    size = sizeof(CacheItem) + key_len + 1
+           + rows->rows.num_rows * sizeof(DocSetRow) + rows->rows.strings.size;
+    if (size > cache->max_size) {
+        return 1;
+    }
+
+    link = find_item(cache, key, hash);
+    if (*link) {
+        return 1;
+    }
+
+    item = (CacheItem *) docset_calloc(1, sizeof(*item));
+    if (!item) {
+        return 0;
+    }
+
+    item->key = (char *) docset_malloc(key_len + 1);
+    if (!item->key) {
+        free_item(item);
+        return 0;
+    }
+    memcpy(item->key, key, key_len + 1);
+    item->rows = rows;
+    rows->refs++;
+    item->hash = hash;
+    item->size = size;
+
+    while (cache->size + size > cache->max_size) {
+        evict_last(cache);
+    }
+
+    /* A failure to grow only makes the chains longer. */
+    if (cache->num_items >= cache->num_buckets) {
+        grow_buckets(cache);
+    }
+    link = find_item(cache, key, hash);
+    *link = item;
+    push_front(cache, item);
+    cache->size += size;
+    cache->num_items++;
+    return 1;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file
+ *
+ * This file provides a cache of query results bounded by the memory
+ * they take, the least recently used results are evicted first.
+ *
+ * The results are shared with the cursors, their references are counted
+ * under the lock that guards the cache.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_RESULT_CACHE_H
+#define DOCSET_RESULT_CACHE_H
+
+#include "rowset.h"
+
+#include <stddef.h>
+
+typedef struct DocSetResultCache DocSetResultCache;
+
+/**
+ * @brief Creates an empty cache of at most @p max_bytes.
+ * @return new cache or NULL if memory could not be allocated.
+ */
+DocSetResultCache *
+docset_rc_create(size_t max_bytes);
+
+/**
+ * @brief Frees the cache and all the results it holds.
+ */
+void
+docset_rc_free(DocSetResultCache *cache);
+
+/**
+ * @brief Evicts all the results.
+ */
+void
+docset_rc_clear(DocSetResultCache *cache);
+
+/**
+ * @brief Returns the result of the query described by the @p key or
+ * NULL if it's not cached, the result becomes the most recently used.
+ *
+ * A reference to the result is added for the caller, so it stays valid
+ * after it's evicted.
+ */
+DocSetSharedRows *
+docset_rc_lookup(DocSetResultCache *cache,
+                 const char        *key);
+
+/**
+ * @brief Adds a reference to the @p rows to the cache, evicting the
+ * least recently used results if the cache gets over its budget.
+ *
+ * Results larger than the whole budget are not cached.
+ *
+ * @return non-zero on success.
+ */
+int
+docset_rc_insert(DocSetResultCache *cache,
+                 const char        *key,
+                 DocSetSharedRows  *rows);
+
+#endif
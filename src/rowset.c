@@ -0,0 +1,298 @@
+#include "rowset.h"
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ROWS_INIT_SIZE 64
+#define STRINGS_INIT_SIZE 1024
+
+static int append_string(DocSetStringBuf *buf, const char *s, size_t *offset)
+{
+    size_t n;
+
+    if (!s) {
+        s = "";
+    }
+    n = strlen(s);
+
+    if (!docset_sb_reserve(buf, buf->size + n + 1)) {
+        return 0;
+    }
+
+    *offset = buf->size;
+    memcpy(buf->data + buf->size, s, n + 1);
+    buf->size += n + 1;
+    return 1;
+}
+
+/* Copies the string to *out, returns its offset from the base. */
+static size_t copy_string(const char *base, char **out, const char *s)
+{
+    size_t n = strlen(s) + 1;
+    size_t offset = (size_t)(*out - base);
+
+    memcpy(*out, s, n);
+    *out += n;
+    return offset;
+}
+
+static int reserve_rows(DocSetRows *rows, size_t n)
+{
+    DocSetRow *r;
+    size_t new_cap;
+
+    if (n <= rows->capacity) {
+        return 1;
+    }
+
+    new_cap = rows->capacity ? rows->capacity * 2 : ROWS_INIT_SIZE;
+    if (new_cap < n) {
+        new_cap = n;
+    }
+
+    r = (DocSetRow *) docset_realloc(rows->rows, new_cap * sizeof(*r));
+    if (!r) {
+        return 0;
+    }
+
+    rows->rows = r;
+    rows->capacity = new_cap;
+    return 1;
+}
+
+static int compare_ranked(const void *a, const void *b)
+{
+    const DocSetRow *x = (const DocSetRow *)a;
+    const DocSetRow *y = (const DocSetRow *)b;
+
+    if (x->rank != y->rank) {
+        return x->rank < y->rank ? -1 : 1;
+    }
+    if (x->source != y->source) {
+        return x->source < y->source ? -1 : 1;
+    }
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+int docset_rows_init(DocSetRows *rows)
+{
+    memset(rows, 0, sizeof(*rows));
+    return docset_sb_init(&rows->strings, STRINGS_INIT_SIZE);
+}
+
+void docset_rows_destroy(DocSetRows *rows)
+{
+    if (rows) {
+        docset_free(rows->rows);
+        docset_sb_destroy(&rows->strings);
+        memset(rows, 0, sizeof(*rows));
+    }
+}
+
+DocSetRow *docset_rows_append(DocSetRows *rows, DocSetEntry *entry)
+{
+    DocSetRow *row;
+
+    if (!reserve_rows(rows, rows->num_rows + 1)) {
+        return NULL;
+    }
+
+    row = rows->rows + rows->num_rows;
+    row->id = docset_entry_id(entry);
+    row->source = 0;
+    row->rank = 0;
+    row->entry_type = docset_entry_type(entry);
+
+    if (!append_string(&rows->strings, docset_entry_name(entry), &row->name)
+        || !append_string(&rows->strings,
+                          docset_entry_type_name(entry), &row->type)
+        || !append_string(&rows->strings,
+                          docset_entry_path(entry), &row->path)) {
+        return NULL;
+    }
+
+    rows->num_rows++;
+    return row;
+}
+
+DocSetRow *docset_rows_append_row(DocSetRows       *dst,
+                                  const DocSetRows *src,
+                                  size_t            i)
+{
+    const DocSetRow *from = src->rows + i;
+    const char *strings = src->strings.data;
+    DocSetRow *row;
+
+    if (!reserve_rows(dst, dst->num_rows + 1)) {
+        return NULL;
+    }
+
+    row = dst->rows + dst->num_rows;
+    *row = *from;
+
+    if (!append_string(&dst->strings, strings + from->name, &row->name)
+        || !append_string(&dst->strings, strings + from->type, &row->type)
+        || !append_string(&dst->strings, strings + from->path, &row->path)) {
+        return NULL;
+    }
+
+    dst->num_rows++;
+    return row;
+}
+
+int docset_rows_concat(DocSetRows *dst, const DocSetRows *src)
+{
+    size_t base = dst->strings.size;
+    size_t i;
+
+    if (!reserve_rows(dst, dst->num_rows + src->num_rows)
+        || !docset_sb_reserve(&dst->strings, base + src->strings.size)) {
+        return 0;
+    }
+
+    memcpy(dst->strings.data + base, src->strings.data, src->strings.size);
+    dst->strings.size += src->strings.size;
+
+    for (i = 0; i < src->num_rows; ++i) {
+        DocSetRow *row = dst->rows + dst->num_rows++;
+        *row = src->rows[i];
+        row->name += base;
+        row->type += base;
+        row->path += base;
+    }
+    return 1;
+}
+
+DocSetRows *docset_rows_pack(const DocSetRows *src,
+                             size_t            first,
+                             DocSetArena      *arena)
+{
+    const char *strings = src->strings.data;
+    size_t n = src->num_rows - first;
+    size_t strings_size = 0;
+    DocSetRows *rows;
+    char *out;
+    size_t i;
+    int whole;
+
+    for (i = first; i < src->num_rows; ++i) {
+        strings_size += strlen(strings + src->rows[i].name)
+                        + strlen(strings + src->rows[i].type)
+                        + strlen(strings + src->rows[i].path) + 3;
+    }
+    /* All the strings are copied at once if they belong to the rows,
+     * views and skipped rows leave strings of other rows behind. */
+    whole = first == 0 && strings_size == src->strings.size;
+
+    /* The header is followed by the rows, then by the strings. */
+    rows = (DocSetRows *) docset_arena_alloc(
+        arena, sizeof(*rows) + n * sizeof(DocSetRow) + strings_size);
+    if (!rows) {
+        return NULL;
+    }
+
+    rows->rows = (DocSetRow *)(rows + 1);
+    rows->num_rows = rows->capacity = n;
+    rows->strings.data = (char *)(rows->rows + n);
+    rows->strings.size = rows->strings.capacity = strings_size;
+
+    /* An empty result set may have no storage at all. */
+    if (whole) {
+        if (n > 0) {
+            memcpy(rows->rows, src->rows, n * sizeof(DocSetRow));
+        }
+        if (strings_size > 0) {
+            memcpy(rows->strings.data, strings, strings_size);
+        }
+        return rows;
+    }
+
+    out = rows->strings.data;
+    for (i = 0; i < n; ++i) {
+        const DocSetRow *from = src->rows + first + i;
+        DocSetRow *row = rows->rows + i;
+
+        *row = *from;
+        row->name = copy_string(rows->strings.data, &out,
+                                strings + from->name);
+        row->type = copy_string(rows->strings.data, &out,
+                                strings + from->type);
+        row->path = copy_string(rows->strings.data, &out,
+                                strings + from->path);
+    }
+    return rows;
+}
+
+DocSetSharedRows *docset_rows_create_shared(void)
+{
+    DocSetSharedRows *shared;
+
+    shared = (DocSetSharedRows *) docset_malloc(sizeof(*shared));
+    if (!shared) {
+        return NULL;
+    }
+    if (!docset_rows_init(&shared->rows)) {
+        docset_free(shared);
+        return NULL;
+    }
+
+    shared->refs = 1;
+    shared->base = NULL;
+    return shared;
+}
+
+DocSetSharedRows *docset_rows_create_view(DocSetSharedRows *src)
+{
+    DocSetSharedRows *base = src->base ? src->base : src;
+    DocSetSharedRows *view;
+
+    view = (DocSetSharedRows *) docset_malloc(sizeof(*view));
+    if (!view) {
+        return NULL;
+    }
+
+    memset(&view->rows, 0, sizeof(view->rows));
+    view->rows.strings = base->rows.strings;
+    view->refs = 1;
+    view->base = base;
+    base->refs++;
+    return view;
+}
+
+DocSetRow *docset_rows_append_ref(DocSetRows       *dst,
+                                  const DocSetRows *src,
+                                  size_t            i)
+{
+    DocSetRow *row;
+
+    if (!reserve_rows(dst, dst->num_rows + 1)) {
+        return NULL;
+    }
+
+    row = dst->rows + dst->num_rows++;
+    *row = src->rows[i];
+    return row;
+}
+
+void docset_rows_release_shared(DocSetSharedRows *rows)
+{
+    if (!rows || --rows->refs != 0) {
+        return;
+    }
+
+    if (rows->base) {
+        docset_free(rows->rows.rows);
+        docset_rows_release_shared(rows->base);
+    } else {
+        docset_rows_destroy(&rows->rows);
+    }
+    docset_free(rows);
+}
+
+void docset_rows_sort_by_rank(DocSetRows *rows)
+{
+    if (rows->num_rows > 1) {
+        qsort(rows->rows, rows->num_rows, sizeof(DocSetRow), compare_ranked);
+    }
+}
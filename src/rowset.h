@@ -0,0 +1,191 @@
+/**
+ * @file
+ *
+ * This file provides materialized result sets, i.e. entries copied
+ * out of the database into memory.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_ROWSET_H
+#define DOCSET_ROWSET_H
+
+#include "docset.h"
+#include "stringbuf.h"
+
+#include <stddef.h>
+
+typedef struct {
+    DocSetEntryId id;
+    /** Index of the docset the entry comes from. */
+    unsigned int  source;
+    /** Ranking score, smaller is better. */
+    unsigned long rank;
+    DocSetEntryType entry_type;
+    /** Offsets of zero-terminated strings in the strings block. */
+    size_t        name;
+    size_t        type;
+    size_t        path;
+} DocSetRow;
+
+typedef struct {
+    DocSetRow      *rows;
+    size_t          num_rows;
+    size_t          capacity;
+    DocSetStringBuf strings;
+} DocSetRows;
+
+/**
+ * Result set shared by the cursors that traverse it and the session or
+ * the cache that keeps it, the rows are immutable once shared.
+ *
+ * A view has rows of its own but refers to the strings of its base and
+ * holds a reference to it, see docset_rows_create_view().
+ *
+ * References to the rows shared with the cursors of a docset are
+ * counted under the docset lock, see docset_release_rows().
+ */
+typedef struct DocSetSharedRows {
+    DocSetRows               rows;
+    size_t                   refs;
+    struct DocSetSharedRows *base;
+} DocSetSharedRows;
+
+/**
+ * @brief Initializes an empty result set.
+ * @return non-zero on success.
+ */
+int
+docset_rows_init(DocSetRows *rows);
+
+/**
+ * @brief Deallocates the memory owned by a result set.
+ */
+void
+docset_rows_destroy(DocSetRows *rows);
+
+/**
+ * @brief Copies the entry to the end of a result set.
+ * @return new row or NULL if memory could not be allocated.
+ */
+DocSetRow *
+docset_rows_append(DocSetRows  *rows,
+                   DocSetEntry *entry);
+
+/**
+ * @brief Copies the @p i-th row of @p src to the end of @p dst.
+ * @return new row or NULL if memory could not be allocated.
+ */
+DocSetRow *
+docset_rows_append_row(DocSetRows       *dst,
+                       const DocSetRows *src,
+                       size_t            i);
+
+/**
+ * @brief Appends all the rows of @p src to @p dst.
+ * @return non-zero on success.
+ */
+int
+docset_rows_concat(DocSetRows       *dst,
+                   const DocSetRows *src);
+
+/**
+ * @brief Copies the rows of @p src starting at the @p first one into a
+ * single arena allocation.
+ *
+ * The copy MUST NOT be destroyed or grown, its memory is freed with
+ * the arena.
+ * @return the copy or NULL if memory could not be allocated.
+ */
+DocSetRows *
+docset_rows_pack(const DocSetRows *src,
+                 size_t            first,
+                 DocSetArena      *arena);
+
+/**
+ * @brief Creates an empty result set with a single reference.
+ * @return new result set or NULL if memory could not be allocated.
+ */
+DocSetSharedRows *
+docset_rows_create_shared(void);
+
+/**
+ * @brief Creates an empty view of the strings of @p src, with a single
+ * reference, and adds a reference to the base of the view.
+ * @return new view or NULL if memory could not be allocated.
+ */
+DocSetSharedRows *
+docset_rows_create_view(DocSetSharedRows *src);
+
+/**
+ * @brief Appends the i-th row of @p src to the @p dst that refers to
+ * the same strings, the strings are not copied.
+ * @return new row or NULL if memory could not be allocated.
+ */
+DocSetRow *
+docset_rows_append_ref(DocSetRows       *dst,
+                       const DocSetRows *src,
+                       size_t            i);
+
+/**
+ * @brief Drops a reference to the result set, the last one frees it.
+ */
+void
+docset_rows_release_shared(DocSetSharedRows *rows);
+
+/**
+ * @brief Sorts rows by rank, then by source, then by id.
+ */
+void
+docset_rows_sort_by_rank(DocSetRows *rows);
+
+/**
+ * @brief Returns a cursor of the @p docset that traverses the shared
+ * result set, the cursor adds a reference to the @p rows.
+ */
+DocSetCursor *
+docset_cursor_for_shared_rows(DocSet           *docset,
+                              DocSetSharedRows *rows);
+
+/**
+ * @brief Creates a view of the result set shared with the cursors of
+ * the @p docset, see docset_rows_create_view().
+ */
+DocSetSharedRows *
+docset_view_rows(DocSet           *docset,
+                 DocSetSharedRows *rows);
+
+/**
+ * @brief Drops a reference to the result set shared with the cursors
+ * of the @p docset, taking the docset lock.
+ */
+void
+docset_release_rows(DocSet           *docset,
+                    DocSetSharedRows *rows);
+
+/**
+ * @brief Appends the remaining entries of the @p cursor to the @p rows.
+ *
+ * Memory allocation failures are reported to the error handler of the
+ * cursor docset.
+ * @return non-zero on success, zero if memory could not be allocated or
+ *         the query failed.
+ */
+int
+docset_cursor_collect(DocSetCursor *cursor,
+                      DocSetRows   *rows);
+
+/**
+ * @brief Returns a cursor that traverses the result set.
+ *
+ * The cursor takes ownership of the @p rows, which must be allocated
+ * with docset_malloc(). If @p sources is not NULL, the cursor keeps a
+ * copy of its @p num_sources docsets and docset_cursor_docset() returns
+ * sources[row->source] for the current row.
+ */
+DocSetCursor *
+docset_cursor_for_rows(DocSetRows    *rows,
+                       DocSet *const *sources,
+                       unsigned       num_sources);
+
+#endif
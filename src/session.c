@@ -0,0 +1,195 @@
+#include "docset.h"
+#include "alloc.h"
+#include "rowset.h"
+#include "stringbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PATTERN_INIT_SIZE 64
+
+/* SQLite LIKE operator folds only ASCII characters by default. */
+#define FOLD(c) (('A' <= (c) && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
+
+struct DocSetSearchSession
+{
+    DocSet *docset;
+    /* Entries matching the pattern, shared with the cursors returned by
+     * docset_session_find(), NULL if the last search failed. */
+    DocSetStringBuf pattern;
+    DocSetSharedRows *candidates;
+};
+
+static const char *next_char(const char *s);
+
+static int like_match(const char *pattern, const char *name);
+
+static int refines(const DocSetStringBuf *prev, const char *pattern);
+
+static DocSetSharedRows *fetch_candidates(DocSetSearchSession *session,
+                                          const char          *pattern);
+
+static DocSetSharedRows *filter_candidates(DocSetSearchSession *session,
+                                           const char          *pattern);
+
+/* Skips a single UTF-8 encoded character. */
+static const char *next_char(const char *s)
+{
+    ++s;
+    while ((*s & 0xC0) == 0x80) {
+        ++s;
+    }
+    return s;
+}
+
+/* Matches the name the way the LIKE operator of SQLite does: '%' matches
+ * any sequence of characters, '_' matches a single character. */
+static int like_match(const char *pattern, const char *name)
+{
+    const char *star = NULL;
+    const char *retry = NULL;
+    unsigned char p, c;
+
+    while (*name) {
+        p = (unsigned char)*pattern;
+        c = (unsigned char)*name;
+        if (p == '%') {
+            star = ++pattern;
+            retry = name;
+        } else if (p == '_') {
+            ++pattern;
+            name = next_char(name);
+        } else if (p != '\0' && FOLD(p) == FOLD(c)) {
+            ++pattern;
+            ++name;
+        } else if (star) {
+            pattern = star;
+            name = retry = next_char(retry);
+        } else {
+            return 0;
+        }
+    }
+
+    while (*pattern == '%') {
+        ++pattern;
+    }
+    return *pattern == '\0';
+}
+
+/* Every name matching the pattern also matches the previous one if the
+ * previous pattern ends with '%' and the rest of it is a prefix of the
+ * pattern. */
+static int refines(const DocSetStringBuf *prev, const char *pattern)
+{
+    if (strcmp(prev->data, pattern) == 0) {
+        return 1;
+    }
+    return prev->size > 0
+           && prev->data[prev->size - 1] == '%'
+           && strncmp(prev->data, pattern, prev->size - 1) == 0;
+}
+
+static DocSetSharedRows *fetch_candidates(DocSetSearchSession *session,
+                                          const char          *pattern)
+{
+    DocSetSharedRows *found = docset_rows_create_shared();
+    DocSetCursor *cursor = docset_find(session->docset, pattern);
+    int ok = found && cursor && docset_cursor_collect(cursor, &found->rows);
+
+    docset_cursor_dispose(cursor);
+    if (!ok) {
+        docset_rows_release_shared(found);
+        return NULL;
+    }
+    return found;
+}
+
+/* The candidates are immutable once shared with cursors, the matches
+ * are a view that refers to their strings. */
+static DocSetSharedRows *filter_candidates(DocSetSearchSession *session,
+                                           const char          *pattern)
+{
+    const DocSetRows *rows = &session->candidates->rows;
+    DocSetSharedRows *matches;
+    size_t i;
+
+    matches = docset_view_rows(session->docset, session->candidates);
+    for (i = 0; matches && i < rows->num_rows; ++i) {
+        if (like_match(pattern, rows->strings.data + rows->rows[i].name)
+            && !docset_rows_append_ref(&matches->rows, rows, i)) {
+            docset_release_rows(session->docset, matches);
+            matches = NULL;
+        }
+    }
+    return matches;
+}
+
+DocSetError docset_session_create(DocSetSearchSession **session,
+                                  DocSet               *docset)
+{
+    if (!session || !docset) {
+        return DOCSET_BAD_CALL;
+    }
+
+    *session = (DocSetSearchSession *) docset_calloc(1, sizeof(**session));
+    if (!*session) {
+        return DOCSET_NO_MEM;
+    }
+
+    if (!docset_sb_init(&(*session)->pattern, PATTERN_INIT_SIZE)) {
+        docset_free(*session);
+        *session = NULL;
+        return DOCSET_NO_MEM;
+    }
+
+    (*session)->docset = docset;
+    return DOCSET_OK;
+}
+
+DocSetCursor *docset_session_find(DocSetSearchSession *session,
+                                  const char          *pattern)
+{
+    DocSetSharedRows *found;
+    size_t len;
+
+    if (!session || !pattern) {
+        return NULL;
+    }
+
+    if (session->candidates && refines(&session->pattern, pattern)) {
+        found = filter_candidates(session, pattern);
+    } else {
+        found = fetch_candidates(session, pattern);
+    }
+
+    if (session->candidates) {
+        docset_release_rows(session->docset, session->candidates);
+    }
+    session->candidates = found;
+
+    len = strlen(pattern);
+    if (found && !docset_sb_reserve(&session->pattern, len + 1)) {
+        docset_release_rows(session->docset, found);
+        session->candidates = found = NULL;
+    }
+    if (!found) {
+        return NULL;
+    }
+    docset_sb_assign(&session->pattern, pattern, len);
+
+    /* The cursor shares the candidates with the session. */
+    return docset_cursor_for_shared_rows(session->docset, found);
+}
+
+void docset_session_close(DocSetSearchSession *session)
+{
+    if (!session) {
+        return;
+    }
+
+    if (session->candidates) {
+        docset_release_rows(session->docset, session->candidates);
+    }
+    docset_sb_destroy(&session->pattern);
+    docset_free(session);
+}
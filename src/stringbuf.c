@@ -1,4 +1,5 @@
 #include "stringbuf.h"
+#include "alloc.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -10,7 +11,7 @@ docset_sb_init(DocSetStringBuf *buf,
 
     memset(buf, 0, sizeof(*buf));
 
-    data = calloc(capacity, sizeof(*data));
+    data = docset_calloc(capacity, sizeof(*data));
 
     if (!data) return 0;
 
@@ -25,7 +26,7 @@ void
 docset_sb_destroy(DocSetStringBuf *buf)
 {
     if (buf) {
-        free(buf->data);
+        docset_free(buf->data);
         memset(buf, 0, sizeof(*buf));
     }
 }
@@ -54,7 +55,7 @@ docset_sb_append(DocSetStringBuf *buf,
     }
 
     memcpy(buf->data + buf->size, data, n);
-    buf->data[len + 1] = '\0';
+    buf->data[len] = '\0';
     buf->size = len;
     return 1;
 }
@@ -65,7 +66,7 @@ int docset_sb_reserve(DocSetStringBuf *buf,
     if (buf->capacity < size) {
         size_t capx2 = buf->capacity * 2;
         size_t new_cap = capx2 > size ? capx2 : size;
-        char *n = realloc(buf->data, new_cap);
+        char *n = docset_realloc(buf->data, new_cap);
         if (!n) return 0;
         buf->capacity = new_cap;
         buf->data = n;
@@ -76,7 +77,7 @@ int docset_sb_reserve(DocSetStringBuf *buf,
 char *docset_sb_new_string(DocSetStringBuf *buf)
 {
     size_t n = buf->size + 1;
-    char *copy = malloc(n);
+    char *copy = docset_malloc(n);
 
     if (!copy) return NULL;
 
@@ -0,0 +1,171 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "thread_pool.h"
+#include "alloc.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct DocSetThreadPool
+{
+    pthread_mutex_t lock;
+    /* Signalled when a new batch is available or on shutdown. */
+    pthread_cond_t work_cv;
+    /* Signalled when the current batch is finished. */
+    pthread_cond_t done_cv;
+
+    pthread_t *threads;
+    unsigned num_threads;
+
+    docset_task_fn fn;
+    void *ctx;
+    unsigned num_tasks;
+    unsigned next_task;
+    unsigned pending;
+    int busy;
+    int shutdown;
+};
+
+/* Executes tasks of the current batch until there is nothing to
+ * take, must be called with the lock held. */
+static void drain_tasks(DocSetThreadPool *pool)
+{
+    while (pool->next_task < pool->num_tasks) {
+        unsigned task = pool->next_task++;
+
+        pthread_mutex_unlock(&pool->lock);
+        pool->fn(pool->ctx, task);
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->done_cv);
+        }
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    DocSetThreadPool *pool = (DocSetThreadPool *)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutdown && pool->next_task >= pool->num_tasks) {
+            pthread_cond_wait(&pool->work_cv, &pool->lock);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        drain_tasks(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static unsigned online_processors(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+}
+
+DocSetThreadPool *docset_tp_create(unsigned num_threads)
+{
+    DocSetThreadPool *pool;
+    unsigned i;
+
+    pool = (DocSetThreadPool *) docset_calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+
+    if (num_threads == 0) {
+        num_threads = online_processors();
+    }
+
+    /* The caller thread executes tasks too. */
+    pool->threads = (pthread_t *)
+        docset_calloc(num_threads, sizeof(pthread_t));
+    if (!pool->threads) {
+        docset_free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cv, NULL);
+    pthread_cond_init(&pool->done_cv, NULL);
+
+    for (i = 0; i + 1 < num_threads; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+            break;
+        }
+    }
+    pool->num_threads = i;
+
+    return pool;
+}
+
+void docset_tp_destroy(DocSetThreadPool *pool)
+{
+    unsigned i;
+
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->num_threads; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done_cv);
+    pthread_cond_destroy(&pool->work_cv);
+    pthread_mutex_destroy(&pool->lock);
+    docset_free(pool->threads);
+    docset_free(pool);
+}
+
+void docset_tp_run(DocSetThreadPool *pool,
+                   docset_task_fn    fn,
+                   void             *ctx,
+                   unsigned          num_tasks)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->busy) {
+        pthread_cond_wait(&pool->done_cv, &pool->lock);
+    }
+
+    pool->busy = 1;
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->num_tasks = num_tasks;
+    pool->next_task = 0;
+    pool->pending = num_tasks;
+
+    if (num_tasks > 1) {
+        pthread_cond_broadcast(&pool->work_cv);
+    }
+
+    drain_tasks(pool);
+
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done_cv, &pool->lock);
+    }
+
+    pool->busy = 0;
+    pool->num_tasks = 0;
+    pool->next_task = 0;
+    pthread_cond_broadcast(&pool->done_cv);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+unsigned docset_tp_size(DocSetThreadPool *pool)
+{
+    return pool->num_threads + 1;
+}
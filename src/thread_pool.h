@@ -0,0 +1,53 @@
+/**
+ * @file
+ *
+ * This file provides a fixed-size pool of worker threads executing
+ * batches of independent tasks.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_THREAD_POOL_H
+#define DOCSET_THREAD_POOL_H
+
+typedef struct DocSetThreadPool DocSetThreadPool;
+
+typedef void (*docset_task_fn)(void *ctx, unsigned task);
+
+/**
+ * @brief Creates a pool of worker threads.
+ *
+ * @param num_threads total number of threads executing tasks including
+ *        the calling one, zero means the number of online processors.
+ * @return new pool or NULL on error.
+ */
+DocSetThreadPool *
+docset_tp_create(unsigned num_threads);
+
+/**
+ * @brief Stops all the worker threads and deallocates the pool.
+ * The pool pointer is allowed to be NULL.
+ */
+void
+docset_tp_destroy(DocSetThreadPool *pool);
+
+/**
+ * @brief Executes fn(ctx, i) for every i in [0, num_tasks) and waits
+ * until all the tasks are finished.
+ *
+ * The calling thread executes tasks as well. Concurrent calls are
+ * serialized.
+ */
+void
+docset_tp_run(DocSetThreadPool *pool,
+              docset_task_fn    fn,
+              void             *ctx,
+              unsigned          num_tasks);
+
+/**
+ * @brief Returns total number of threads executing tasks.
+ */
+unsigned
+docset_tp_size(DocSetThreadPool *pool);
+
+#endif
@@ -0,0 +1,119 @@
+#include "topk.h"
+#include "alloc.h"
+
+#include <stdlib.h>
+
+#define WORSE(a, b) \
+    ((a).rank > (b).rank || ((a).rank == (b).rank && (a).id > (b).id))
+
+static void sift_up(DocSetTopKItem *items, size_t i)
+{
+    DocSetTopKItem item = items[i];
+    size_t parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (!WORSE(item, items[parent])) {
+            break;
+        }
+        items[i] = items[parent];
+        i = parent;
+    }
+    items[i] = item;
+}
+
+static void sift_down(DocSetTopKItem *items, size_t n, size_t i)
+{
+    DocSetTopKItem item = items[i];
+    size_t child;
+
+    while ((child = 2 * i + 1) < n) {
+        if (child + 1 < n && WORSE(items[child + 1], items[child])) {
+            ++child;
+        }
+        if (!WORSE(items[child], item)) {
+            break;
+        }
+        items[i] = items[child];
+        i = child;
+    }
+    items[i] = item;
+}
+
+static int compare_ids(const void *a, const void *b)
+{
+    DocSetEntryId x = ((const DocSetTopKItem *)a)->id;
+    DocSetEntryId y = ((const DocSetTopKItem *)b)->id;
+    return (x > y) - (x < y);
+}
+
+int docset_topk_init(DocSetTopK *topk, size_t k)
+{
+    topk->size = 0;
+    topk->capacity = k;
+    topk->items = NULL;
+
+    if (k == 0) {
+        return 1;
+    }
+
+    topk->items = (DocSetTopKItem *) docset_malloc(k * sizeof(*topk->items));
+    return topk->items != NULL;
+}
+
+void docset_topk_destroy(DocSetTopK *topk)
+{
+    if (topk) {
+        docset_free(topk->items);
+        topk->items = NULL;
+        topk->size = topk->capacity = 0;
+    }
+}
+
+int docset_topk_accepts(const DocSetTopK *topk, unsigned long rank)
+{
+    /* Equal ranks are still accepted, ids break the tie on push. */
+    return topk->size < topk->capacity
+           || (topk->capacity > 0 && rank <= topk->items[0].rank);
+}
+
+void docset_topk_push(DocSetTopK *topk, unsigned long rank, DocSetEntryId id)
+{
+    DocSetTopKItem item;
+
+    item.rank = rank;
+    item.id = id;
+
+    if (topk->size < topk->capacity) {
+        topk->items[topk->size] = item;
+        sift_up(topk->items, topk->size++);
+    } else if (topk->capacity > 0 && WORSE(topk->items[0], item)) {
+        topk->items[0] = item;
+        sift_down(topk->items, topk->size, 0);
+    }
+}
+
+void docset_topk_sort_by_id(DocSetTopK *topk)
+{
+    if (topk->size > 1) {
+        qsort(topk->items, topk->size, sizeof(*topk->items), compare_ids);
+    }
+}
+
+unsigned long docset_topk_rank(const DocSetTopK *topk, DocSetEntryId id)
+{
+    size_t l = 0;
+    size_t h = topk->size;
+
+    while (l < h) {
+        size_t m = l + (h - l) / 2;
+        if (topk->items[m].id < id) {
+            l = m + 1;
+        } else {
+            h = m;
+        }
+    }
+    return (l < topk->size && topk->items[l].id == id)
+           ? topk->items[l].rank
+           : (unsigned long)-1;
+}
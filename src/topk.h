@@ -0,0 +1,77 @@
+/**
+ * @file
+ *
+ * This file provides a bounded heap keeping the K best ranked entries
+ * of a stream.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_TOPK_H
+#define DOCSET_TOPK_H
+
+#include "docset.h"
+
+#include <stddef.h>
+
+typedef struct {
+    /** Ranking score, smaller is better. */
+    unsigned long rank;
+    DocSetEntryId id;
+} DocSetTopKItem;
+
+typedef struct {
+    /** Max-heap ordered by (rank, id), the worst item is the first. */
+    DocSetTopKItem *items;
+    size_t          size;
+    size_t          capacity;
+} DocSetTopK;
+
+/**
+ * @brief Initializes an empty heap keeping at most @p k items.
+ * @return non-zero on success.
+ */
+int
+docset_topk_init(DocSetTopK *topk,
+                 size_t      k);
+
+/**
+ * @brief Deallocates the memory owned by a heap.
+ */
+void
+docset_topk_destroy(DocSetTopK *topk);
+
+/**
+ * @brief Returns non-zero if an item with the @p rank would be kept,
+ * i.e. the heap is not full or the item beats the worst one.
+ *
+ * It allows to skip computing anything else for hopeless items.
+ */
+int
+docset_topk_accepts(const DocSetTopK *topk,
+                    unsigned long     rank);
+
+/**
+ * @brief Offers an item to the heap.
+ */
+void
+docset_topk_push(DocSetTopK    *topk,
+                 unsigned long  rank,
+                 DocSetEntryId  id);
+
+/**
+ * @brief Sorts the items by id, nothing can be pushed to the heap
+ * after that.
+ */
+void
+docset_topk_sort_by_id(DocSetTopK *topk);
+
+/**
+ * @brief Returns rank of the item with the @p id, the items must be
+ * sorted by id.
+ */
+unsigned long
+docset_topk_rank(const DocSetTopK *topk,
+                 DocSetEntryId     id);
+
+#endif
@@ -0,0 +1,61 @@
+#include "type_dict.h"
+#include "alloc.h"
+#include "hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+DocSetEntryType docset_td_lookup(DocSetTypeDict *dict,
+                                 const char     *name,
+                                 size_t          len)
+{
+    unsigned long h = docset_hash(name, len);
+    size_t i = h % DOCSET_TYPE_DICT_SIZE;
+    DocSetTypeDictSlot *slot;
+    DocSetEntryType type;
+    char *copy;
+
+    for (;;) {
+        slot = dict->slots + i;
+        if (!slot->name) {
+            break;
+        }
+        if (slot->hash == h && slot->len == len
+            && memcmp(slot->name, name, len) == 0) {
+            return slot->type;
+        }
+        i = (i + 1) % DOCSET_TYPE_DICT_SIZE;
+    }
+
+    /* The name must be zero-terminated for the lookup, it's copied
+     * anyway. */
+    copy = (char *) docset_malloc(len + 1);
+    if (!copy) {
+        return DOCSET_TYPE_UNKNOWN;
+    }
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    type = docset_type_by_name(copy);
+
+    /* One slot is always left empty to terminate the probing. */
+    if (dict->size + 1 < DOCSET_TYPE_DICT_SIZE) {
+        slot->hash = h;
+        slot->name = copy;
+        slot->len = len;
+        slot->type = type;
+        dict->size++;
+    } else {
+        docset_free(copy);
+    }
+    return type;
+}
+
+void docset_td_clear(DocSetTypeDict *dict)
+{
+    size_t i;
+
+    for (i = 0; i < DOCSET_TYPE_DICT_SIZE; ++i) {
+        docset_free(dict->slots[i].name);
+    }
+    memset(dict, 0, sizeof(*dict));
+}
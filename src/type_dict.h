@@ -0,0 +1,53 @@
+/**
+ * @file
+ *
+ * This file provides a dictionary of the native type names met in a
+ * docset, every distinct name is resolved with docset_type_by_name()
+ * only once, later rows of the same type cost a hash lookup.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_TYPE_DICT_H
+#define DOCSET_TYPE_DICT_H
+
+#include "docset.h"
+
+#include <stddef.h>
+
+/* Docsets use a few dozen type names, names beyond the capacity are
+ * resolved on every lookup. */
+#define DOCSET_TYPE_DICT_SIZE 256
+
+typedef struct {
+    unsigned long hash;
+    char *name;
+    size_t len;
+    DocSetEntryType type;
+} DocSetTypeDictSlot;
+
+/**
+ * @brief Open addressing hash table of type names, a zero-filled
+ * dictionary is empty.
+ */
+typedef struct {
+    DocSetTypeDictSlot slots[DOCSET_TYPE_DICT_SIZE];
+    size_t size;
+} DocSetTypeDict;
+
+/**
+ * @brief Returns the type of the name @p len bytes long, adds the name
+ * to the dictionary when it's met for the first time.
+ */
+DocSetEntryType
+docset_td_lookup(DocSetTypeDict *dict,
+                 const char     *name,
+                 size_t          len);
+
+/**
+ * @brief Deallocates the names and makes the dictionary empty.
+ */
+void
+docset_td_clear(DocSetTypeDict *dict);
+
+#endif
@@ -0,0 +1,30 @@
+/**
+ * @file
+ *
+ * This file provides the perfect hash of type names. The hash tables
+ * are generated at build time by type_hash_gen.c from
+ * ::DOCSET_TYPE_NAMES and ::DOCSET_TYPE_ALIASES: the docset_hash() of
+ * a name selects its bucket, the hash mixed with the seed of the bucket
+ * selects its slot, the generator picks bucket seeds so that every name
+ * gets a slot of its own.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_TYPE_HASH_H
+#define DOCSET_TYPE_HASH_H
+
+#include "hash.h"
+
+/* Mixes the name hash with the bucket seed, so the name is scanned only
+ * once. */
+static unsigned long docset_type_mix(unsigned long h, unsigned long seed)
+{
+    h = (h ^ (seed * 2654435761UL)) & 0xFFFFFFFFUL;
+    h ^= h >> 16;
+    h = (h * 2246822507UL) & 0xFFFFFFFFUL;
+    h ^= h >> 13;
+    return h;
+}
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Generates the perfect hash tables of type names, see type_hash.h.
+ * Usage: type_hash_gen OUTPUT
+ */
+#include "docset.h"
+#include "type_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define MAX_SEED 65535UL
+
+typedef struct {
+    const char *name;
+    DocSetEntryType type;
+} TypeName;
+
+#define TYPE_NAME(name, type) { name, type },
+
+static const TypeName NAMES[] = {
+    DOCSET_TYPE_NAMES(TYPE_NAME)
+    DOCSET_TYPE_ALIASES(TYPE_NAME)
+};
+
+enum {
+    NUM_NAMES = ARRAY_SIZE(NAMES),
+    NUM_BUCKETS = (ARRAY_SIZE(NAMES) + 1) / 2
+};
+
+static size_t buckets[NUM_BUCKETS][NUM_NAMES];
+static size_t bucket_sizes[NUM_BUCKETS];
+static unsigned long seeds[NUM_BUCKETS];
+static int slots[NUM_NAMES];
+
+/* The canonical names must follow the enum, they double as the table
+ * of canonical names. */
+static int check_names(void)
+{
+    size_t i, j;
+
+    for (i = 0; i <= DOCSET_TYPE_LAST; ++i) {
+        if (NAMES[i].type != (DocSetEntryType)i) {
+            fprintf(stderr, "%s: out of the DocSetEntryType order\n",
+                    NAMES[i].name);
+            return 0;
+        }
+    }
+    for (i = 0; i < NUM_NAMES; ++i) {
+        for (j = 0; j < i; ++j) {
+            if (strcmp(NAMES[i].name, NAMES[j].name) == 0) {
+                fprintf(stderr, "%s: duplicate type name\n", NAMES[i].name);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Tries to place all the names of the bucket with the seed. */
+static int place(size_t b, unsigned long seed)
+{
+    size_t i, j, s[NUM_NAMES];
+    const char *name;
+
+    for (i = 0; i < bucket_sizes[b]; ++i) {
+        name = NAMES[buckets[b][i]].name;
+        s[i] = docset_type_mix(docset_hash(name, strlen(name)), seed)
+               % NUM_NAMES;
+        if (slots[s[i]] >= 0) {
+            return 0;
+        }
+        for (j = 0; j < i; ++j) {
+            if (s[j] == s[i]) {
+                return 0;
+            }
+        }
+    }
+    for (i = 0; i < bucket_sizes[b]; ++i) {
+        slots[s[i]] = (int)buckets[b][i];
+    }
+    return 1;
+}
+
+static int generate(void)
+{
+    size_t order[NUM_BUCKETS];
+    size_t i, j, b, t;
+    unsigned long seed;
+
+    for (i = 0; i < NUM_NAMES; ++i) {
+        b = docset_hash(NAMES[i].name, strlen(NAMES[i].name)) % NUM_BUCKETS;
+        buckets[b][bucket_sizes[b]++] = i;
+        slots[i] = -1;
+    }
+
+    /* Larger buckets are placed first while most slots are free. */
+    for (i = 0; i < NUM_BUCKETS; ++i) {
+        order[i] = i;
+    }
+    for (i = 1; i < NUM_BUCKETS; ++i) {
+        for (j = i; j > 0
+             && bucket_sizes[order[j]] > bucket_sizes[order[j - 1]]; --j) {
+            t = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = t;
+        }
+    }
+
+    for (i = 0; i < NUM_BUCKETS; ++i) {
+        b = order[i];
+        for (seed = 1; seed <= MAX_SEED && !place(b, seed); ++seed) {
+        }
+        if (seed > MAX_SEED) {
+            fprintf(stderr, "Can't find a perfect hash seed\n");
+            return 0;
+        }
+        seeds[b] = bucket_sizes[b] ? seed : 0;
+    }
+    return 1;
+}
+
+static int write_tables(FILE *f)
+{
+    size_t i;
+
+    fprintf(f, "/* Generated by type_hash_gen.c, do not edit. */\n\n");
+    fprintf(f, "#define TYPE_HASH_NAMES %u\n", (unsigned)NUM_NAMES);
+    fprintf(f, "#define TYPE_HASH_BUCKETS %u\n\n", (unsigned)NUM_BUCKETS);
+
+    fprintf(f, "static const unsigned short "
+               "TYPE_HASH_SEEDS[TYPE_HASH_BUCKETS] = {");
+    for (i = 0; i < NUM_BUCKETS; ++i) {
+        fprintf(f, "%s%lu", i == 0 ? "\n    " : i % 12 ? ", " : ",\n    ",
+                seeds[i]);
+    }
+    fprintf(f, "\n};\n\n");
+
+    fprintf(f, "static const unsigned char "
+               "TYPE_HASH_SLOTS[TYPE_HASH_NAMES] = {");
+    for (i = 0; i < NUM_NAMES; ++i) {
+        fprintf(f, "%s%d", i == 0 ? "\n    " : i % 12 ? ", " : ",\n    ",
+                slots[i]);
+    }
+    fprintf(f, "\n};\n");
+
+    return !ferror(f);
+}
+
+int main(int argc, char **argv)
+{
+    FILE *f;
+    int ok;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s OUTPUT\n", argv[0]);
+        return 2;
+    }
+
+    if (!check_names() || !generate()) {
+        return 1;
+    }
+
+    if (!(f = fopen(argv[1], "w"))) {
+        perror(argv[1]);
+        return 1;
+    }
+    ok = write_tables(f);
+    ok = fclose(f) == 0 && ok;
+    return !ok;
+}
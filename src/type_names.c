@@ -1,246 +1,73 @@
-#include "docset.h"
+#include "type_names.h"
+#include "type_hash.h"
+#include "type_hash_table.h"
 
 #include <string.h>
 #include <assert.h>
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
-#define Attribute "Attribute"
-#define Binding "Binding"
-#define Builtin "Builtin"
-#define Callback "Callback"
-#define Category "Category"
-#define Class "Class"
-#define Command "Command"
-#define Component "Component"
-#define Constant "Constant"
-#define Constructor "Constructor"
-#define Define "Define"
-#define Delegate "Delegate"
-#define Directive "Directive"
-#define Element "Element"
-#define Entry "Entry"
-#define Enum "Enum"
-#define Error "Error"
-#define Event "Event"
-#define Exception "Exception"
-#define Field "Field"
-#define File "File"
-#define Filter "Filter"
-#define Framework "Framework"
-#define Function "Function"
-#define Global "Global"
-#define Guide "Guide"
-#define Instance "Instance"
-#define Instruction "Instruction"
-#define Interface "Interface"
-#define Keyword "Keyword"
-#define Library "Library"
-#define Literal "Literal"
-#define Macro "Macro"
-#define Method "Method"
-#define Mixin "Mixin"
-#define Module "Module"
-#define Namespace "Namespace"
-#define Notation "Notation"
-#define Object "Object"
-#define Operator "Operator"
-#define Option "Option"
-#define Package "Package"
-#define Parameter "Parameter"
-#define Procedure "Procedure"
-#define Property "Property"
-#define Protocol "Protocol"
-#define Record "Record"
-#define Resource "Resource"
-#define Sample "Sample"
-#define Section "Section"
-#define Service "Service"
-#define Struct "Struct"
-#define Style "Style"
-#define Subroutine "Subroutine"
-#define Tag "Tag"
-#define Trait "Trait"
-#define Type "Type"
-#define Union "Union"
-#define Value "Value"
-#define Variable "Variable"
-
 typedef struct {
     const char * type_name;
     DocSetEntryType type;
 } TypeNameMapping;
 
-/*
- * NB(roman): Entries in this table MUST be sorted.
- */
-static TypeNameMapping TYPE_NAME_TO_ID[] = {
-    { Attribute, DOCSET_TYPE_ATTRIBUTE },
-    { Binding, DOCSET_TYPE_BINDING },
-    { Builtin, DOCSET_TYPE_BUILTIN },
-    { Callback, DOCSET_TYPE_CALLBACK },
-    { Category, DOCSET_TYPE_CATEGORY },
-    { Class, DOCSET_TYPE_CLASS },
-    { Command, DOCSET_TYPE_COMMAND },
-    { Component, DOCSET_TYPE_COMPONENT },
-    { Constant, DOCSET_TYPE_CONSTANT },
-    { Constructor, DOCSET_TYPE_CONSTRUCTOR },
-    { Define, DOCSET_TYPE_DEFINE },
-    { Delegate, DOCSET_TYPE_DELEGATE },
-    { Directive, DOCSET_TYPE_DIRECTIVE },
-    { Element, DOCSET_TYPE_ELEMENT },
-    { Entry, DOCSET_TYPE_ENTRY },
-    { Enum, DOCSET_TYPE_ENUM },
-    { Error, DOCSET_TYPE_ERROR },
-    { Event, DOCSET_TYPE_EVENT },
-    { Exception, DOCSET_TYPE_EXCEPTION },
-    { Field, DOCSET_TYPE_FIELD },
-    { File, DOCSET_TYPE_FILE },
-    { Filter, DOCSET_TYPE_FILTER },
-    { Framework, DOCSET_TYPE_FRAMEWORK },
-    { Function, DOCSET_TYPE_FUNCTION },
-    { Global, DOCSET_TYPE_GLOBAL },
-    { Guide, DOCSET_TYPE_GUIDE },
-    { Instance, DOCSET_TYPE_INSTANCE },
-    { Instruction, DOCSET_TYPE_INSTRUCTION },
-    { Interface, DOCSET_TYPE_INTERFACE },
-    { Keyword, DOCSET_TYPE_KEYWORD },
-    { Library, DOCSET_TYPE_LIBRARY },
-    { Literal, DOCSET_TYPE_LITERAL },
-    { Macro, DOCSET_TYPE_MACRO },
-    { Method, DOCSET_TYPE_METHOD },
-    { Mixin, DOCSET_TYPE_MIXIN },
-    { Module, DOCSET_TYPE_MODULE },
-    { Namespace, DOCSET_TYPE_NAMESPACE },
-    { Notation, DOCSET_TYPE_NOTATION },
-    { Object, DOCSET_TYPE_OBJECT },
-    { Operator, DOCSET_TYPE_OPERATOR },
-    { Option, DOCSET_TYPE_OPTION },
-    { Package, DOCSET_TYPE_PACKAGE },
-    { Parameter, DOCSET_TYPE_PARAMETER },
-    { Procedure, DOCSET_TYPE_PROCEDURE },
-    { Property, DOCSET_TYPE_PROPERTY },
-    { Protocol, DOCSET_TYPE_PROTOCOL },
-    { Record, DOCSET_TYPE_RECORD },
-    { Resource, DOCSET_TYPE_RESOURCE },
-    { Sample, DOCSET_TYPE_SAMPLE },
-    { Section, DOCSET_TYPE_SECTION },
-    { Service, DOCSET_TYPE_SERVICE },
-    { Struct, DOCSET_TYPE_STRUCT },
-    { Style, DOCSET_TYPE_STYLE },
-    { Subroutine, DOCSET_TYPE_SUBROUTINE },
-    { Tag, DOCSET_TYPE_TAG },
-    { Trait, DOCSET_TYPE_TRAIT },
-    { Type, DOCSET_TYPE_TYPE },
-    { Union, DOCSET_TYPE_UNION },
-    { Value, DOCSET_TYPE_VALUE },
-    { Variable, DOCSET_TYPE_VARIABLE },
-};
+#define TYPE_NAME(name, type) { name, type },
 
-static TypeNameMapping EXTRA_NAME_TO_ID[] = {
-    { "Word", DOCSET_TYPE_KEYWORD },
-    { "cat", DOCSET_TYPE_CATEGORY },
-    { "cl", DOCSET_TYPE_CLASS },
-    { "clconst", DOCSET_TYPE_CONSTANT },
-    { "clm", DOCSET_TYPE_METHOD },
-    { "func", DOCSET_TYPE_FUNCTION },
-    { "instp", DOCSET_TYPE_INSTRUCTION },
-    { "macro", DOCSET_TYPE_MACRO },
-    { "specialization", DOCSET_TYPE_TYPE },
-    { "tdef", DOCSET_TYPE_TYPE },
+/* Canonical names go first in the order of types, see
+ * DOCSET_TYPE_NAMES, type_hash_gen.c checks the order. */
+static const TypeNameMapping TYPE_NAMES[] = {
+    DOCSET_TYPE_NAMES(TYPE_NAME)
+    DOCSET_TYPE_ALIASES(TYPE_NAME)
 };
 
-static const char * TYPE_ID_TO_NAME[] = {
-    Attribute,
-    Binding,
-    Builtin,
-    Callback,
-    Category,
-    Class,
-    Command,
-    Component,
-    Constant,
-    Constructor,
-    Define,
-    Delegate,
-    Directive,
-    Element,
-    Entry,
-    Enum,
-    Error,
-    Event,
-    Exception,
-    Field,
-    File,
-    Filter,
-    Framework,
-    Function,
-    Global,
-    Guide,
-    Instance,
-    Instruction,
-    Interface,
-    Keyword,
-    Library,
-    Literal,
-    Macro,
-    Method,
-    Mixin,
-    Module,
-    Namespace,
-    Notation,
-    Object,
-    Operator,
-    Option,
-    Package,
-    Parameter,
-    Procedure,
-    Property,
-    Protocol,
-    Record,
-    Resource,
-    Sample,
-    Section,
-    Service,
-    Struct,
-    Style,
-    Subroutine,
-    Tag,
-    Trait,
-    Type,
-    Union,
-    Value,
-    Variable,
-};
+DocSetEntryType docset_type_by_name(const char *name)
+{
+    unsigned long h = docset_hash(name, strlen(name));
+    unsigned long slot =
+        docset_type_mix(h, TYPE_HASH_SEEDS[h % TYPE_HASH_BUCKETS])
+        % TYPE_HASH_NAMES;
+    const TypeNameMapping *m = TYPE_NAMES + TYPE_HASH_SLOTS[slot];
 
-static DocSetEntryType
-find(const char *name, TypeNameMapping *map, int l, int h)
+    return strcmp(name, m->type_name) == 0 ? m->type : DOCSET_TYPE_UNKNOWN;
+}
+
+const char * docset_canonical_type_name(DocSetEntryType type)
 {
-     /* Actually, reimplement binary search here is much
-     * simpler than to use bsearch from the standard library. */
-    while (l < h) {
-        int m = (h + l) / 2; /* We know that upper bound, no int overflow here. */
-        int cmp = strcmp(name, map[m].type_name);
-        if (cmp == 0) return map[m].type;
-        if (cmp < 0) h = m;
-        else l = m + 1;
+    if (DOCSET_TYPE_FIRST <= type && type <= DOCSET_TYPE_LAST) {
+        return TYPE_NAMES[type].type_name;
     }
-    return DOCSET_TYPE_UNKNOWN;
+    return "Unknown";
 }
 
-DocSetEntryType docset_type_by_name(const char *name)
+void docset_type_mask_clear(DocSetTypeMask *mask)
 {
-    DocSetEntryType t;
-    t = find(name, TYPE_NAME_TO_ID, 0, ARRAY_SIZE(TYPE_NAME_TO_ID));
-    return (t != DOCSET_TYPE_UNKNOWN)
-           ? t
-           : find(name, EXTRA_NAME_TO_ID, 0, ARRAY_SIZE(EXTRA_NAME_TO_ID));
+    memset(mask, 0, sizeof(*mask));
 }
 
-const char * docset_canonical_type_name(DocSetEntryType type)
+void docset_type_mask_add(DocSetTypeMask *mask, DocSetEntryType type)
 {
     if (DOCSET_TYPE_FIRST <= type && type <= DOCSET_TYPE_LAST) {
-        return TYPE_ID_TO_NAME[type];
+        mask->bits[type / 32] |= 1UL << (type % 32);
     }
-    return "Unknown";
+}
+
+int docset_type_mask_has(const DocSetTypeMask *mask, DocSetEntryType type)
+{
+    return DOCSET_TYPE_FIRST <= type && type <= DOCSET_TYPE_LAST
+           && (mask->bits[type / 32] & (1UL << (type % 32))) != 0;
+}
+
+size_t docset_type_names(const DocSetTypeMask *mask, const char **names)
+{
+    size_t i, n = 0;
+
+    assert(ARRAY_SIZE(TYPE_NAMES) <= DOCSET_MAX_TYPE_NAMES);
+
+    for (i = 0; i < ARRAY_SIZE(TYPE_NAMES); ++i) {
+        if (docset_type_mask_has(mask, TYPE_NAMES[i].type)) {
+            names[n++] = TYPE_NAMES[i].type_name;
+        }
+    }
+    return n;
 }
@@ -0,0 +1,35 @@
+/**
+ * @file
+ *
+ * This file provides the mapping of entry types back to the type names
+ * docsets use for them.
+ *
+ * This file is part of the docset library implementation and is not a
+ * public API.
+ */
+#ifndef DOCSET_TYPE_NAMES_H
+#define DOCSET_TYPE_NAMES_H
+
+#include "docset.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Upper bound of the number of type names, canonical names and
+ * aliases together.
+ */
+enum { DOCSET_MAX_TYPE_NAMES = 128 };
+
+/**
+ * @brief Collects all the names of the types in the @p mask, both the
+ * canonical names and the aliases, that docset_type_by_name() maps to
+ * these types.
+ *
+ * @param names vector of at least ::DOCSET_MAX_TYPE_NAMES elements
+ * @return number of names stored, the names are static strings.
+ */
+size_t
+docset_type_names(const DocSetTypeMask *mask,
+                  const char          **names);
+
+#endif
@@ -0,0 +1,340 @@
+#define _XOPEN_SOURCE 700
+
+#include "fixture.h"
+
+#include <dirent.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *NAME_HEADS[] = {
+    "std::vector::", "printf", "Print", "malloc", "NSString",
+    "push_back", "qsort", "PRINTF", "str", "Str_", "fopen",
+    "fprintf", "zz"
+};
+
+static const char *NAME_TAILS[] = {
+    "", "push_back", "_at", "Size", "begin", "x%", "Copy"
+};
+
+/* Pairs of canonical (Dash) and Xcode type names. */
+static const char *TYPE_NAMES[][2] = {
+    { "Function", "func" },
+    { "Class", "cl" },
+    { "Method", "clm" },
+    { "Type", "tdef" },
+    { "Macro", "macro" },
+    { "Constant", "clconst" },
+    { "Guide", "Guide" },
+    { "Keyword", "Word" }
+};
+
+static const char PLIST[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<plist version=\"1.0\">\n"
+    "<dict>\n"
+    "  <key>CFBundleIdentifier</key><string>%s</string>\n"
+    "  <key>CFBundleName</key><string>Fixture %s</string>\n"
+    "  <key>DocSetPlatformFamily</key><string>fixture</string>\n"
+    "  <key>isDashDocset</key><%s/>\n"
+    "  <key>isJavaScriptEnabled</key><false/>\n"
+    "</dict>\n"
+    "</plist>\n";
+
+static const char *DASH_SCHEMA[] = {
+    "create table searchIndex(id integer primary key, name text, "
+    "type text, path text)",
+    NULL
+};
+
+static const char *ZDASH_SCHEMA[] = {
+    "create table ZTOKENTYPE(z_pk integer primary key, ztypename text)",
+    "create table ZFILEPATH(z_pk integer primary key, zpath text)",
+    "create table ZTOKENMETAINFORMATION(z_pk integer primary key, "
+    "zfile integer, zanchor text)",
+    "create table ZTOKEN(z_pk integer primary key, ztokenname text, "
+    "ztokentype integer, zmetainformation integer)",
+    NULL
+};
+
+void fixture_entry_name(unsigned i, char *buf, size_t size)
+{
+    const char *head = NAME_HEADS[i % ARRAY_SIZE(NAME_HEADS)];
+    const char *tail =
+        NAME_TAILS[(i / ARRAY_SIZE(NAME_HEADS)) % ARRAY_SIZE(NAME_TAILS)];
+
+    /* Every tenth name is not unique. */
+    if (i % 10 == 0) {
+        snprintf(buf, size, "%s%s", head, tail);
+    } else {
+        snprintf(buf, size, "%s%s%u", head, tail, i);
+    }
+}
+
+static int exec_all(sqlite3 *db, const char **stmts)
+{
+    for (; *stmts; ++stmts) {
+        if (sqlite3_exec(db, *stmts, NULL, NULL, NULL) != SQLITE_OK) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int fill_dash(sqlite3 *db, unsigned num_entries)
+{
+    sqlite3_stmt *stmt = NULL;
+    char name[64];
+    char path[64];
+    unsigned i;
+    int ok = exec_all(db, DASH_SCHEMA)
+             && sqlite3_prepare_v2(db,
+                                   "insert into searchIndex values (?,?,?,?)",
+                                   -1, &stmt, NULL) == SQLITE_OK;
+
+    for (i = 0; ok && i < num_entries; ++i) {
+        fixture_entry_name(i, name, sizeof(name));
+        snprintf(path, sizeof(path), "file%u.html#anchor%u", i / 50, i);
+        sqlite3_bind_int(stmt, 1, (int)i + 1);
+        sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3,
+                          TYPE_NAMES[i % ARRAY_SIZE(TYPE_NAMES)][0],
+                          -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, path, -1, SQLITE_STATIC);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+static int insert_row(sqlite3_stmt *stmt,
+                      int           pk,
+                      const char   *text,
+                      int           ref1,
+                      int           ref2)
+{
+    int ok;
+
+    sqlite3_bind_int(stmt, 1, pk);
+    if (text) {
+        sqlite3_bind_text(stmt, 2, text, -1, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(stmt, 2);
+    }
+    if (ref1 >= 0) {
+        sqlite3_bind_int(stmt, 3, ref1);
+    }
+    if (ref2 >= 0) {
+        sqlite3_bind_int(stmt, 4, ref2);
+    }
+    ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_reset(stmt);
+    return ok;
+}
+
+static int fill_zdash(sqlite3 *db, unsigned num_entries)
+{
+    sqlite3_stmt *types = NULL;
+    sqlite3_stmt *files = NULL;
+    sqlite3_stmt *meta = NULL;
+    sqlite3_stmt *tokens = NULL;
+    char name[64];
+    char text[64];
+    unsigned i;
+    int ok = exec_all(db, ZDASH_SCHEMA)
+             && sqlite3_prepare_v2(db, "insert into ztokentype values (?,?)",
+                                   -1, &types, NULL) == SQLITE_OK
+             && sqlite3_prepare_v2(db, "insert into zfilepath values (?,?)",
+                                   -1, &files, NULL) == SQLITE_OK
+             && sqlite3_prepare_v2(db,
+                                   "insert into ztokenmetainformation "
+                                   "(z_pk, zanchor, zfile) values (?,?,?)",
+                                   -1, &meta, NULL) == SQLITE_OK
+             && sqlite3_prepare_v2(db, "insert into ztoken values (?,?,?,?)",
+                                   -1, &tokens, NULL) == SQLITE_OK;
+
+    for (i = 0; ok && i < ARRAY_SIZE(TYPE_NAMES); ++i) {
+        ok = insert_row(types, (int)i + 1, TYPE_NAMES[i][1], -1, -1);
+    }
+
+    for (i = 0; ok && i < num_entries; ++i) {
+        if (i % 50 == 0) {
+            snprintf(text, sizeof(text), "file%u.html", i / 50);
+            ok = insert_row(files, (int)(i / 50) + 1, text, -1, -1);
+        }
+
+        /* Some of the entries point to a file without an anchor. */
+        snprintf(text, sizeof(text), "anchor%u", i);
+        ok = ok && insert_row(meta, (int)i + 1,
+                              i % 7 == 0 ? NULL : text,
+                              (int)(i / 50) + 1, -1);
+
+        fixture_entry_name(i, name, sizeof(name));
+        ok = ok && insert_row(tokens, (int)i + 1, name,
+                              (int)(i % ARRAY_SIZE(TYPE_NAMES)) + 1,
+                              (int)i + 1);
+    }
+
+    sqlite3_finalize(types);
+    sqlite3_finalize(files);
+    sqlite3_finalize(meta);
+    sqlite3_finalize(tokens);
+    return ok;
+}
+
+int fixture_create(DocSetKind kind, unsigned num_entries, char *dir)
+{
+    char path[FIXTURE_PATH_MAX + 64];
+    sqlite3 *db = NULL;
+    FILE *f;
+    int ok;
+
+    strcpy(dir, "/tmp/libdocset-fixture-XXXXXX");
+    if (!mkdtemp(dir)) {
+        return 0;
+    }
+
+    snprintf(path, sizeof(path), "%s/Contents", dir);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/Contents/Resources", dir);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/Contents/Resources/Documents", dir);
+    mkdir(path, 0755);
+
+    snprintf(path, sizeof(path), "%s/Contents/Info.plist", dir);
+    if (!(f = fopen(path, "w"))) {
+        return 0;
+    }
+    fprintf(f, PLIST,
+            kind == DOCSET_KIND_DASH ? "fixture.dash" : "fixture.zdash",
+            docset_kind_name(kind),
+            kind == DOCSET_KIND_DASH ? "true" : "false");
+    fclose(f);
+
+    snprintf(path, sizeof(path), "%s/Contents/Resources/docSet.dsidx", dir);
+    if (sqlite3_open(path, &db) != SQLITE_OK) {
+        sqlite3_close(db);
+        return 0;
+    }
+
+    ok = sqlite3_exec(db, "begin", NULL, NULL, NULL) == SQLITE_OK
+         && (kind == DOCSET_KIND_DASH
+             ? fill_dash(db, num_entries)
+             : fill_zdash(db, num_entries))
+         && sqlite3_exec(db, "commit", NULL, NULL, NULL) == SQLITE_OK;
+
+    sqlite3_close(db);
+    return ok;
+}
+
+int fixture_break(const char *dir)
+{
+    char path[FIXTURE_PATH_MAX + 64];
+    sqlite3 *db = NULL;
+    int ok;
+
+    snprintf(path, sizeof(path), "%s/Contents/Resources/docSet.dsidx", dir);
+    ok = sqlite3_open(path, &db) == SQLITE_OK
+         && sqlite3_exec(db, "drop table searchIndex", NULL, NULL, NULL)
+            == SQLITE_OK;
+    sqlite3_close(db);
+    return ok;
+}
+
+void fixture_remove(const char *dir)
+{
+    char path[FIXTURE_PATH_MAX * 2];
+    struct dirent *ent;
+    struct stat st;
+    DIR *d = opendir(dir);
+
+    if (!d) {
+        return;
+    }
+
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            fixture_remove(path);
+        } else {
+            unlink(path);
+        }
+    }
+
+    closedir(d);
+    rmdir(dir);
+}
+
+static int same_string(const char *a, const char *b)
+{
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static int same_entry(DocSetCursor *expected,
+                      DocSetCursor *actual,
+                      unsigned      flags)
+{
+    DocSetEntry *e = docset_cursor_entry(expected);
+    DocSetEntry *a = docset_cursor_entry(actual);
+
+    return docset_entry_id(e) == docset_entry_id(a)
+           && docset_entry_type(e) == docset_entry_type(a)
+           && same_string(docset_entry_name(e), docset_entry_name(a))
+           && ((flags & FIXTURE_PATH_PRESENCE)
+               ? !docset_entry_path(e) == !docset_entry_path(a)
+               : same_string(docset_entry_path(e), docset_entry_path(a)))
+           && (!(flags & FIXTURE_SAME_DOCSET)
+               || docset_cursor_docset(expected)
+                  == docset_cursor_docset(actual));
+}
+
+int fixture_same_entries(DocSetCursor *expected,
+                         DocSetCursor *actual,
+                         const char   *label,
+                         unsigned      flags)
+{
+    int has_e, has_a;
+    int ok = expected && actual;
+
+    if (!ok) {
+        fprintf(stderr, "%s: no cursor\n", label);
+    }
+
+    while (ok) {
+        has_e = docset_cursor_step(expected);
+        has_a = docset_cursor_step(actual);
+        if (has_e != has_a) {
+            fprintf(stderr, "%s: result sizes differ\n", label);
+            ok = 0;
+            break;
+        }
+        if (!has_e) {
+            break;
+        }
+        ok = same_entry(expected, actual, flags);
+        if (!ok) {
+            fprintf(stderr, "%s: expected %d (%s), got %d (%s)\n", label,
+                    docset_entry_id(docset_cursor_entry(expected)),
+                    docset_entry_name(docset_cursor_entry(expected)),
+                    docset_entry_id(docset_cursor_entry(actual)),
+                    docset_entry_name(docset_cursor_entry(actual)));
+        }
+    }
+
+    docset_cursor_dispose(expected);
+    docset_cursor_dispose(actual);
+    return ok;
+}
+
+int fixture_check_kinds(int (*check)(DocSetKind kind))
+{
+    return check(DOCSET_KIND_DASH) && check(DOCSET_KIND_ZDASH);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file
+ *
+ * This file provides a generator of synthetic docsets used by the
+ * tests and the benchmarks.
+ */
+#ifndef DOCSET_TEST_FIXTURE_H
+#define DOCSET_TEST_FIXTURE_H
+
+#include "docset.h"
+
+#include <stddef.h>
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+enum { FIXTURE_PATH_MAX = 256 };
+
+/** Flags of fixture_same_entries(). */
+enum {
+    /** Paths are only checked to be both present or both missing. */
+    FIXTURE_PATH_PRESENCE = 1,
+    /** Entries must also come from the same docsets. */
+    FIXTURE_SAME_DOCSET = 2
+};
+
+/**
+ * @brief Creates a docset of given @p kind with @p num_entries entries
+ * in a new temporary directory.
+ *
+ * Entry names are generated deterministically, so docsets of the same
+ * size and kind have the same content.
+ *
+ * @param dir sink for the docset directory path, at least
+ *        FIXTURE_PATH_MAX bytes long.
+ * @return non-zero on success.
+ */
+int
+fixture_create(DocSetKind kind,
+               unsigned   num_entries,
+               char      *dir);
+
+/**
+ * @brief Writes the name of the i-th generated entry to @p buf.
+ */
+void
+fixture_entry_name(unsigned i,
+                   char    *buf,
+                   size_t   size);
+
+/**
+ * @brief Drops the index table of a DASH docset created by
+ * fixture_create(), so that the queries of a docset that is already
+ * open fail.
+ * @return non-zero on success.
+ */
+int
+fixture_break(const char *dir);
+
+/**
+ * @brief Removes the docset created by fixture_create().
+ */
+void
+fixture_remove(const char *dir);
+
+/**
+ * @brief Checks that both cursors produce the same entries, the first
+ * difference is printed with the @p label. Both cursors are disposed.
+ *
+ * @param flags see FIXTURE_PATH_PRESENCE and FIXTURE_SAME_DOCSET.
+ * @return non-zero if the entries are the same, 0 if they differ or a
+ *         cursor is NULL.
+ */
+int
+fixture_same_entries(DocSetCursor *expected,
+                     DocSetCursor *actual,
+                     const char   *label,
+                     unsigned      flags);
+
+/**
+ * @brief Runs the @p check for a DASH and then for a ZDASH docset.
+ * @return non-zero if both checks pass.
+ */
+int
+fixture_check_kinds(int (*check)(DocSetKind kind));
+
+#endif
@@ -0,0 +1,204 @@
+#include "docset.h"
+#include "fixture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Number of live and of all the allocations made by the library. */
+static long live_blocks;
+static long all_blocks;
+
+static void *counting_allocate(void *context, size_t size)
+{
+    void *p = malloc(size);
+
+    (void)context;
+    if (p) {
+        live_blocks++;
+        all_blocks++;
+    }
+    return p;
+}
+
+static void *counting_reallocate(void *context, void *ptr, size_t size)
+{
+    void *p = realloc(ptr, size);
+
+    (void)context;
+    if (p && !ptr) {
+        live_blocks++;
+        all_blocks++;
+    }
+    return p;
+}
+
+static void counting_deallocate(void *context, void *ptr)
+{
+    (void)context;
+    if (ptr) {
+        live_blocks--;
+    }
+    free(ptr);
+}
+
+static int same_entries(DocSetCursor *expected, DocSetCursor *actual,
+                        const char *what)
+{
+    return fixture_same_entries(expected, actual, what,
+                                FIXTURE_SAME_DOCSET);
+}
+
+/* Materializes the cursor after skipping @p skip entries. */
+static DocSetCursor *materialized(DocSetCursor *c, DocSetArena *arena,
+                                  int skip)
+{
+    while (skip-- > 0) {
+        docset_cursor_step(c);
+    }
+    if (!docset_cursor_materialize(c, arena)) {
+        fprintf(stderr, "Can't materialize cursor\n");
+    }
+    return c;
+}
+
+static DocSetCursor *skipped(DocSetCursor *c, int skip)
+{
+    while (skip-- > 0) {
+        docset_cursor_step(c);
+    }
+    return c;
+}
+
+static int check_materialize(DocSet *docset, DocSetArena *arena)
+{
+    static const DocSetEntryId ids[] = { 3, 1, 4, 1, 5, 9, 2, 6 };
+    int round, ok = 1;
+
+    /* Small blocks make the larger results take blocks of their own. */
+    for (round = 0; ok && round < 3; ++round) {
+        ok = same_entries(docset_find(docset, "%Size%"),
+                          materialized(docset_find(docset, "%Size%"),
+                                       arena, 0), "find")
+             && same_entries(skipped(docset_find(docset, "%"), 10),
+                             materialized(docset_find(docset, "%"),
+                                          arena, 10), "find skipped")
+             && same_entries(docset_find_top(docset, "print", 20),
+                             materialized(docset_find_top(docset, "print",
+                                                          20), arena, 0),
+                             "find_top")
+             && same_entries(docset_find_by_ids(docset, ids, 8),
+                             materialized(docset_find_by_ids(docset, ids, 8),
+                                          arena, 0), "find_by_ids")
+             && same_entries(docset_find(docset, "nosuch"),
+                             materialized(docset_find(docset, "nosuch"),
+                                          arena, 0), "empty");
+        docset_arena_reset(arena);
+    }
+    return ok;
+}
+
+/* A refined session cursor views the strings of all the candidates of
+ * the session, only the strings of its own rows are copied. */
+static int check_session(DocSet *docset, DocSetArena *arena)
+{
+    DocSetSearchSession *session;
+    DocSetCursor *c;
+    long blocks;
+    int ok;
+
+    if (docset_session_create(&session, docset) != DOCSET_OK) {
+        return 0;
+    }
+    docset_cursor_dispose(docset_session_find(session, "%"));
+    c = docset_session_find(session, "printf");
+
+    ok = docset_arena_alloc(arena, 1) != NULL;
+    blocks = all_blocks;
+    ok = ok && docset_cursor_materialize(c, arena);
+    if (ok && all_blocks != blocks) {
+        fprintf(stderr, "Strings of the other candidates are copied\n");
+        ok = 0;
+    }
+
+    docset_session_close(session);
+    ok = same_entries(docset_find(docset, "printf"), c, "session") && ok;
+    docset_arena_reset(arena);
+    return ok;
+}
+
+/* Allocations of any size are aligned for long double. */
+static int check_alignment(DocSetArena *arena)
+{
+    struct { char c; long double ld; } probe;
+    size_t align = (size_t)((char *)&probe.ld - (char *)&probe);
+    size_t size;
+    void *p;
+
+    for (size = 1; size < 64; ++size) {
+        p = docset_arena_alloc(arena, size);
+        if (!p || (size_t)p % align != 0) {
+            fprintf(stderr, "Allocation of %u bytes is misaligned\n",
+                    (unsigned)size);
+            return 0;
+        }
+    }
+    docset_arena_reset(arena);
+    return 1;
+}
+
+static int check_kind(DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *docset;
+    DocSetArena *arena;
+    int ok;
+
+    if (!fixture_create(kind, 2000, dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 0;
+    }
+
+    if (docset_try_open(&docset, dir) != DOCSET_OK) {
+        fprintf(stderr, "Can't open %s fixture\n", docset_kind_name(kind));
+        fixture_remove(dir);
+        return 0;
+    }
+
+    arena = docset_arena_create(4096);
+    ok = arena && live_blocks > 0 && check_alignment(arena)
+         && check_materialize(docset, arena)
+         && check_session(docset, arena);
+
+    docset_arena_destroy(arena);
+    docset_close(docset);
+    fixture_remove(dir);
+
+    if (live_blocks != 0) {
+        fprintf(stderr, "%s: %ld blocks leaked\n",
+                docset_kind_name(kind), live_blocks);
+        ok = 0;
+    }
+    return ok;
+}
+
+int main()
+{
+    DocSetAllocator allocator;
+    DocSetAllocator incomplete;
+
+    allocator.allocate = counting_allocate;
+    allocator.reallocate = counting_reallocate;
+    allocator.deallocate = counting_deallocate;
+    allocator.context = NULL;
+
+    incomplete = allocator;
+    incomplete.reallocate = NULL;
+
+    if (docset_set_allocator(&incomplete) != DOCSET_BAD_CALL
+        || docset_set_allocator(&allocator) != DOCSET_OK) {
+        fprintf(stderr, "Can't set allocator\n");
+        return 1;
+    }
+
+    return !fixture_check_kinds(check_kind);
+}
@@ -0,0 +1,193 @@
+#include <docset.hpp>
+
+extern "C" {
+#include "fixture.h"
+}
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const char *const patterns[] = { "printf", "%Size%", "Print%", "nosuch" };
+
+bool same_entries(const std::vector<docset::entry> &expected,
+                  const std::vector<docset::entry> &actual,
+                  const char *what, const char *pattern)
+{
+    if (expected.size() != actual.size()) {
+        std::fprintf(stderr, "%s: %s: expected %u entries, got %u\n",
+                     what, pattern, unsigned(expected.size()),
+                     unsigned(actual.size()));
+        return false;
+    }
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i].id() != actual[i].id() || !(expected[i] == actual[i])) {
+            std::fprintf(stderr, "%s: %s: entry %u differs\n",
+                         what, pattern, unsigned(i));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_pattern(const docset::doc_set &ds, docset::executor &ex,
+                   const char *pattern)
+{
+    std::vector<docset::entry> expected, batch, streamed;
+
+    ds.find(pattern).collect_into(expected);
+
+    auto future = ds.find_async(pattern, ex);
+    auto stream = ds.find_stream(pattern, ex, 7);
+    while (stream.next(batch)) {
+        if (batch.empty() || batch.size() > 7) {
+            std::fprintf(stderr, "%s: bad batch size %u\n",
+                         pattern, unsigned(batch.size()));
+            return false;
+        }
+        streamed.insert(streamed.end(), batch.begin(), batch.end());
+    }
+
+    return stream.done()
+        && same_entries(expected, future.get(), "find_async", pattern)
+        && same_entries(expected, streamed, "find_stream", pattern);
+}
+
+// Streams dropped before the end must stop their producers, otherwise
+// the executor never finishes.
+void drop_streams(const docset::doc_set &ds, docset::executor &ex)
+{
+    std::vector<docset::entry> batch;
+
+    for (int i = 0; i < 16; ++i) {
+        auto stream = ds.find_stream("%", ex, 1);
+        if (i % 2) {
+            stream.next(batch);
+        }
+    }
+}
+
+// Entries keep the name of their docset after it's closed.
+bool check_docset_name(const char *dir)
+{
+    std::vector<docset::entry> collected, iterated;
+    std::string name;
+
+    {
+        docset::doc_set ds(dir);
+        name = ds.name();
+        ds.find("%Size%").collect_into(collected);
+        for (const docset::entry &e : ds.find("%Size%")) {
+            iterated.push_back(e);
+        }
+    }
+
+    for (const auto *entries : { &collected, &iterated }) {
+        for (const docset::entry &e : *entries) {
+            if (e.docset_name() != name) {
+                std::fprintf(stderr, "%s: unexpected docset name %s\n",
+                             e.name().c_str(), e.docset_name().c_str());
+                return false;
+            }
+        }
+    }
+    return !collected.empty() && collected.size() == iterated.size();
+}
+
+template <typename F>
+bool throws(F f, const char *what)
+{
+    try {
+        f();
+    } catch (const docset::error &) {
+        return true;
+    }
+    std::fprintf(stderr, "%s: the failed query didn't throw\n", what);
+    return false;
+}
+
+// Failed queries throw instead of looking like empty results.
+bool check_failure(docset::executor &ex)
+{
+    char dir[FIXTURE_PATH_MAX];
+    std::vector<docset::entry> entries, batch;
+    bool ok;
+
+    if (!fixture_create(::DOCSET_KIND_DASH, 500, dir)) {
+        std::fprintf(stderr, "Can't create fixture\n");
+        return false;
+    }
+
+    {
+        docset::doc_set ds(dir, ::DOCSET_OPEN_CONCURRENT);
+
+        ds.find("%Size%").collect_into(entries);
+        ok = !entries.empty() && fixture_break(dir);
+
+        ok = ok
+            && throws([&] { ds.find("%Size%").collect_into(entries); },
+                      "collect_into")
+            && throws([&] { ds.find_async("%Size%", ex).get(); },
+                      "find_async")
+            && throws([&] {
+                   auto stream = ds.find_stream("%Size%", ex);
+                   while (stream.next(batch)) {
+                   }
+               }, "find_stream");
+    }
+
+    fixture_remove(dir);
+    return ok;
+}
+
+// Moved-from streams are empty and done.
+bool check_moved(const docset::doc_set &ds, docset::executor &ex)
+{
+    std::vector<docset::entry> batch;
+    auto stream = ds.find_stream("%", ex);
+    auto moved = std::move(stream);
+
+    return !stream.next(batch) && !stream.try_next(batch) && stream.done()
+        && moved.next(batch);
+}
+
+bool check_kind(::DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    bool ok = true;
+
+    if (!fixture_create(kind, 2000, dir)) {
+        std::fprintf(stderr, "Can't create fixture\n");
+        return false;
+    }
+
+    try {
+        docset::doc_set ds(dir, ::DOCSET_OPEN_CONCURRENT);
+        docset::thread_pool_executor ex(4);
+
+        for (const char *pattern : patterns) {
+            ok = ok && check_pattern(ds, ex, pattern);
+        }
+        drop_streams(ds, ex);
+        ok = ok && check_docset_name(dir) && check_moved(ds, ex);
+        ok = ok && (kind != ::DOCSET_KIND_DASH || check_failure(ex));
+    } catch (const docset::error &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        ok = false;
+    }
+
+    fixture_remove(dir);
+    return ok;
+}
+
+}
+
+int main()
+{
+    return !::fixture_check_kinds([](::DocSetKind kind) -> int {
+        return check_kind(kind);
+    });
+}
@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "docset.h"
+#include "fixture.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+enum { NUM_THREADS = 8, NUM_ROUNDS = 20 };
+
+static const char *PATTERNS[] = {
+    "printf", "malloc%", "%Size%", "std::vector::%", "nosuch", "Print%"
+};
+
+typedef struct Worker
+{
+    DocSet *docset;
+    const unsigned *expected;
+    unsigned long rows;
+    int ok;
+} Worker;
+
+static unsigned count_rows(DocSet *docset, const char *pattern)
+{
+    DocSetCursor *cursor = docset_find(docset, pattern);
+    unsigned n = 0;
+
+    while (docset_cursor_step(cursor)) {
+        n += docset_entry_name(docset_cursor_entry(cursor)) != NULL;
+    }
+    docset_cursor_dispose(cursor);
+    return n;
+}
+
+static void *run_worker(void *arg)
+{
+    Worker *w = (Worker *)arg;
+    unsigned i, round;
+
+    w->rows = 0;
+    w->ok = 1;
+    for (round = 0; w->ok && round < NUM_ROUNDS; ++round) {
+        for (i = 0; w->ok && i < ARRAY_SIZE(PATTERNS); ++i) {
+            unsigned n = count_rows(w->docset, PATTERNS[i]);
+            w->ok = n == w->expected[i];
+            w->rows += n;
+        }
+    }
+    return NULL;
+}
+
+static int check_kind(DocSetKind kind, int name_index)
+{
+    char dir[FIXTURE_PATH_MAX];
+    pthread_t threads[NUM_THREADS];
+    Worker workers[NUM_THREADS];
+    unsigned expected[ARRAY_SIZE(PATTERNS)];
+    DocSetStats stats;
+    DocSet *docset;
+    unsigned long rows = 0;
+    unsigned i;
+    int ok = 1;
+
+    if (!fixture_create(kind, 2000, dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 0;
+    }
+
+    if (docset_try_open_flags(&docset, dir, DOCSET_OPEN_LAZY
+                                            | DOCSET_OPEN_CONCURRENT)
+        != DOCSET_OK) {
+        fprintf(stderr, "Can't open fixture\n");
+        fixture_remove(dir);
+        return 0;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(PATTERNS); ++i) {
+        expected[i] = count_rows(docset, PATTERNS[i]);
+    }
+    docset_set_name_index(docset, name_index);
+    docset_reset_stats(docset);
+
+    for (i = 0; i < NUM_THREADS; ++i) {
+        workers[i].docset = docset;
+        workers[i].expected = expected;
+        if (pthread_create(&threads[i], NULL, run_worker, &workers[i])) {
+            fprintf(stderr, "Can't create thread\n");
+            return 0;
+        }
+    }
+
+    for (i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && workers[i].ok;
+        rows += workers[i].rows;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "%s: unexpected concurrent results\n",
+                docset_kind_name(kind));
+    }
+
+    docset_get_stats(docset, &stats);
+    if (ok && stats.rows_stepped != rows) {
+        fprintf(stderr, "%s: %lu rows stepped, %lu expected\n",
+                docset_kind_name(kind), stats.rows_stepped, rows);
+        ok = 0;
+    }
+
+    docset_close(docset);
+    fixture_remove(dir);
+    return ok;
+}
+
+int main()
+{
+    return !(check_kind(DOCSET_KIND_DASH, 0)
+             && check_kind(DOCSET_KIND_ZDASH, 0)
+             && check_kind(DOCSET_KIND_DASH, 1));
+}
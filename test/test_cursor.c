@@ -0,0 +1,435 @@
+#include "docset.h"
+#include "fixture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum { MAX_ROWS = 4096 };
+
+static const char *PATTERNS[] = {
+    "printf", "malloc%", "%Size%", "std::vector::%", "nosuch", "Print%"
+};
+
+/* Drains the cursor to the ids vector, returns the number of rows. */
+static size_t drain(DocSetCursor *cursor, DocSetEntryId *ids)
+{
+    size_t n = 0;
+
+    while (n < MAX_ROWS && docset_cursor_step(cursor)) {
+        ids[n++] = docset_entry_id(docset_cursor_entry(cursor));
+    }
+    return n;
+}
+
+static int check_rebind(DocSet *docset)
+{
+    static DocSetEntryId expected[MAX_ROWS];
+    static DocSetEntryId actual[MAX_ROWS];
+    DocSetCursor *reused;
+    DocSetCursor *fresh;
+    size_t i, n, m;
+    int ok = 1;
+
+    reused = docset_find(docset, "zz");
+
+    for (i = 0; ok && i < ARRAY_SIZE(PATTERNS); ++i) {
+        if (!docset_cursor_rebind(reused, PATTERNS[i])) {
+            fprintf(stderr, "%s: rebind failed\n", PATTERNS[i]);
+            ok = 0;
+            break;
+        }
+        /* Rebinding in the middle of a result set must restart it. */
+        docset_cursor_step(reused);
+        docset_cursor_rebind(reused, PATTERNS[i]);
+        n = drain(reused, actual);
+
+        fresh = docset_find(docset, PATTERNS[i]);
+        m = drain(fresh, expected);
+        docset_cursor_dispose(fresh);
+
+        if (n != m || memcmp(expected, actual, n * sizeof(*actual)) != 0) {
+            fprintf(stderr, "%s: expected %u rows, got %u\n",
+                    PATTERNS[i], (unsigned)m, (unsigned)n);
+            ok = 0;
+        }
+    }
+
+    docset_cursor_dispose(reused);
+    return ok;
+}
+
+static int check_find_by_ids(DocSet *docset)
+{
+    static const DocSetEntryId ids[] = { 7, 3, 100, 5000, 42 };
+    static const DocSetEntryId expected[] = { 3, 7, 42, 100 };
+    DocSetEntryId actual[ARRAY_SIZE(ids)];
+    DocSetCursor *cursor;
+    size_t n;
+    int round;
+
+    /* The second round uses the cached statement. */
+    for (round = 0; round < 2; ++round) {
+        cursor = docset_find_by_ids(docset, ids, ARRAY_SIZE(ids));
+        n = drain(cursor, actual);
+        docset_cursor_dispose(cursor);
+
+        if (n != ARRAY_SIZE(expected)
+            || memcmp(expected, actual, sizeof(expected)) != 0) {
+            fprintf(stderr, "find_by_ids: unexpected result\n");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* More ids than a single statement could bind, every id is given twice
+ * and ids past the end of the docset are skipped. */
+static int check_find_many_ids(DocSet *docset)
+{
+    static DocSetEntryId ids[2 * MAX_ROWS];
+    static DocSetEntryId actual[MAX_ROWS];
+    DocSetCursor *cursor;
+    size_t i, n;
+    int ok;
+
+    for (i = 0; i < MAX_ROWS; ++i) {
+        ids[i] = (DocSetEntryId)(MAX_ROWS - i);
+        ids[MAX_ROWS + i] = (DocSetEntryId)(i + 1);
+    }
+
+    cursor = docset_find_by_ids(docset, ids, ARRAY_SIZE(ids));
+    n = drain(cursor, actual);
+    docset_cursor_dispose(cursor);
+
+    ok = n == 1000;
+    for (i = 0; ok && i < n; ++i) {
+        ok = actual[i] == (DocSetEntryId)(i + 1);
+    }
+
+    if (!ok) {
+        fprintf(stderr, "find_by_ids: unexpected result for %u ids\n",
+                (unsigned)ARRAY_SIZE(ids));
+    }
+    return ok;
+}
+
+/* A typed search must return exactly the entries of the types, the
+ * types of ZDASH fixtures are aliases such as "clm" and "tdef". Rebound
+ * typed cursors keep their types. */
+static int check_find_typed(DocSet *docset)
+{
+    static DocSetEntryId expected[MAX_ROWS];
+    static DocSetEntryId actual[MAX_ROWS];
+    DocSetTypeMask types;
+    DocSetCursor *c, *reused;
+    DocSetEntryType t;
+    size_t i, n = 0, m, r = 0;
+    int ok = 1;
+
+    docset_type_mask_clear(&types);
+    docset_type_mask_add(&types, DOCSET_TYPE_METHOD);
+    docset_type_mask_add(&types, DOCSET_TYPE_TYPE);
+    reused = docset_find_typed(docset, "zz", &types);
+
+    for (i = 0; ok && i < ARRAY_SIZE(PATTERNS); ++i) {
+        c = docset_find(docset, PATTERNS[i]);
+        for (n = 0; docset_cursor_step(c); ) {
+            t = docset_entry_type(docset_cursor_entry(c));
+            if (t == DOCSET_TYPE_METHOD || t == DOCSET_TYPE_TYPE) {
+                expected[n++] = docset_entry_id(docset_cursor_entry(c));
+            }
+        }
+        docset_cursor_dispose(c);
+
+        c = docset_find_typed(docset, PATTERNS[i], &types);
+        m = drain(c, actual);
+        docset_cursor_dispose(c);
+
+        ok = n == m && memcmp(expected, actual, n * sizeof(*actual)) == 0;
+        if (ok && docset_cursor_rebind(reused, PATTERNS[i])) {
+            r = drain(reused, actual);
+            ok = n == r && memcmp(expected, actual, n * sizeof(*actual)) == 0;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s: expected %u typed rows, got %u and %u\n",
+                    PATTERNS[i], (unsigned)n, (unsigned)m, (unsigned)r);
+        }
+    }
+    docset_cursor_dispose(reused);
+
+    docset_type_mask_clear(&types);
+    c = docset_find_typed(docset, "%", &types);
+    ok = ok && c && !docset_cursor_step(c);
+    docset_cursor_dispose(c);
+    return ok;
+}
+
+static int same_string(const char *a, const char *b)
+{
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static int check_columns(DocSet *docset, unsigned columns)
+{
+    DocSetCursor *full = docset_find(docset, "%print%");
+    DocSetCursor *narrow = docset_find_ex(docset, "%print%", columns);
+    DocSetEntry *f, *n;
+    int ok = 1;
+
+    while (ok && docset_cursor_step(full)) {
+        ok = docset_cursor_step(narrow);
+        if (!ok) {
+            break;
+        }
+        f = docset_cursor_entry(full);
+        n = docset_cursor_entry(narrow);
+        ok = docset_entry_id(f) == docset_entry_id(n)
+             && same_string((columns & DOCSET_COL_NAME)
+                            ? docset_entry_name(f) : NULL,
+                            docset_entry_name(n))
+             && same_string((columns & DOCSET_COL_TYPE)
+                            ? docset_entry_type_name(f) : NULL,
+                            docset_entry_type_name(n))
+             && same_string((columns & DOCSET_COL_PATH)
+                            ? docset_entry_path(f) : NULL,
+                            docset_entry_path(n));
+    }
+    ok = ok && !docset_cursor_step(narrow);
+
+    if (!ok) {
+        fprintf(stderr, "%s: unexpected result for columns %u\n",
+                docset_name(docset), columns);
+    }
+
+    docset_cursor_dispose(full);
+    docset_cursor_dispose(narrow);
+    return ok;
+}
+
+static int same_column(const DocSetBatch *b, size_t offset, size_t len,
+                       const char *expected)
+{
+    const char *s = b->strings + offset;
+
+    return strlen(s) == len && strcmp(s, expected ? expected : "") == 0;
+}
+
+static int check_batch(DocSet *docset, unsigned columns)
+{
+    DocSetCursor *single = docset_find_ex(docset, "%print%", columns);
+    DocSetCursor *batched = docset_find_ex(docset, "%print%", columns);
+    DocSetBatch batch;
+    DocSetEntry *e;
+    size_t i, n, rows = 0;
+    int ok = 1;
+
+    docset_batch_init(&batch);
+
+    /* A small batch size makes the result span many batches. */
+    while (ok && (n = docset_cursor_fetch_batch(batched, 7, &batch)) > 0) {
+        ok = n == batch.size && n <= 7;
+        for (i = 0; ok && i < n; ++i, ++rows) {
+            ok = docset_cursor_step(single);
+            if (!ok) {
+                break;
+            }
+            e = docset_cursor_entry(single);
+            ok = batch.ids[i] == docset_entry_id(e)
+                 && batch.docsets[i] == docset
+                 && batch.types[i] == docset_entry_type(e)
+                 && same_column(&batch, batch.name_offsets[i],
+                                batch.name_lengths[i], docset_entry_name(e))
+                 && same_column(&batch, batch.type_offsets[i],
+                                batch.type_lengths[i],
+                                docset_entry_type_name(e))
+                 && same_column(&batch, batch.path_offsets[i],
+                                batch.path_lengths[i], docset_entry_path(e));
+        }
+    }
+    ok = ok && rows > 0 && !docset_cursor_step(single);
+
+    if (!ok) {
+        fprintf(stderr, "%s: unexpected batch for columns %u\n",
+                docset_name(docset), columns);
+    }
+
+    docset_batch_destroy(&batch);
+    docset_cursor_dispose(single);
+    docset_cursor_dispose(batched);
+    return ok;
+}
+
+static int check_stats(DocSet *docset)
+{
+    DocSetStats stats;
+    DocSetCursor *c;
+    unsigned long rows = 0;
+    int round;
+
+    docset_get_stats(docset, &stats);
+    if (stats.open_db_seconds <= 0.0) {
+        fprintf(stderr, "%s: open is not timed\n", docset_name(docset));
+        return 0;
+    }
+
+    docset_reset_stats(docset);
+    docset_set_step_timing(docset, 1);
+
+    /* The second round must reuse the statement of the first one. */
+    for (round = 0; round < 2; ++round) {
+        c = docset_find(docset, "%print%");
+        while (docset_cursor_step(c)) {
+            docset_cursor_entry(c);
+            ++rows;
+        }
+        docset_cursor_dispose(c);
+    }
+
+    docset_set_step_timing(docset, 0);
+    docset_get_stats(docset, &stats);
+
+    if (stats.rows_stepped != rows
+        || stats.stmts_prepared != 1
+        || stats.stmts_reused != 1
+        || stats.bytes_copied == 0
+        || stats.step_seconds <= 0.0
+        || stats.open_db_seconds != 0.0) {
+        fprintf(stderr, "%s: unexpected stats\n", docset_name(docset));
+        return 0;
+    }
+    return 1;
+}
+
+static void count_errors(void *ctx, const char *msg)
+{
+    (void)msg;
+    ++*(int *)ctx;
+}
+
+/* Opens the docset from a directory with URI special characters in the
+ * name, the database must be found in the immutable mode. */
+static int check_open_ex(const char *dir)
+{
+    char renamed[FIXTURE_PATH_MAX + 8];
+    DocSetOpenOptions options;
+    DocSet *docset;
+    int ok;
+
+    sprintf(renamed, "%s%%#?", dir);
+    if (rename(dir, renamed) != 0) {
+        return 0;
+    }
+
+    docset_open_options_init(&options);
+    options.flags = DOCSET_OPEN_IMMUTABLE | DOCSET_OPEN_NO_MUTEX;
+    options.mmap_size = 1UL << 20;
+    options.cache_size = -1024;
+    options.temp_store = DOCSET_TEMP_STORE_MEMORY;
+
+    ok = docset_open_ex(&docset, renamed, &options) == DOCSET_OK;
+    if (ok) {
+        ok = docset_count(docset) == 1000;
+        docset_close(docset);
+    }
+
+    if (!ok) {
+        fprintf(stderr, "%s: can't open with options\n", renamed);
+    }
+    return rename(renamed, dir) == 0 && ok;
+}
+
+/* A lazy docset reads metadata only, the database is opened by the first
+ * query. */
+static int check_lazy(DocSetKind kind, const char *dir)
+{
+    char path[FIXTURE_PATH_MAX + 64];
+    DocSetStats stats;
+    DocSet *docset;
+    FILE *f;
+    int errors = 0;
+    int ok;
+
+    if (docset_try_open_flags(&docset, dir, DOCSET_OPEN_LAZY) != DOCSET_OK) {
+        return 0;
+    }
+
+    docset_get_stats(docset, &stats);
+    ok = stats.open_db_seconds == 0.0
+         && docset_name(docset) != NULL
+         && docset_count(docset) == 1000
+         && docset_kind(docset) == kind;
+    docset_close(docset);
+
+    /* A broken database is detected by the first query. */
+    sprintf(path, "%s/Contents/Resources/docSet.dsidx", dir);
+    if (ok && (f = fopen(path, "w"))) {
+        fputs("not a database", f);
+        fclose(f);
+
+        ok = docset_try_open_flags(&docset, dir, DOCSET_OPEN_LAZY)
+             == DOCSET_OK;
+        if (ok) {
+            docset_set_error_handler(docset, count_errors, &errors);
+            ok = docset_find(docset, "printf") == NULL
+                 && docset_kind(docset) == DOCSET_KIND_UNKNOWN
+                 && errors == 2;
+            docset_close(docset);
+        }
+        ok = ok && docset_try_open(&docset, dir) == DOCSET_BAD_DB;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "%s: unexpected lazy open\n", docset_kind_name(kind));
+    }
+    return ok;
+}
+
+static int check_kind(DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *docset;
+    int ok;
+
+    if (!fixture_create(kind, 1000, dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 0;
+    }
+
+    if (docset_try_open(&docset, dir) != DOCSET_OK) {
+        fprintf(stderr, "Can't open fixture\n");
+        fixture_remove(dir);
+        return 0;
+    }
+
+    ok = check_stats(docset)
+         && check_rebind(docset)
+         && check_find_by_ids(docset)
+         && check_find_many_ids(docset)
+         && check_find_typed(docset)
+         && check_columns(docset, DOCSET_COL_NAME)
+         && check_columns(docset, DOCSET_COL_PATH)
+         && check_columns(docset, DOCSET_COL_NAME | DOCSET_COL_TYPE)
+         && check_batch(docset, DOCSET_COL_ALL)
+         && check_batch(docset, DOCSET_COL_NAME | DOCSET_COL_TYPE);
+
+    docset_set_name_index(docset, 1);
+    ok = ok
+         && check_rebind(docset)
+         && check_find_typed(docset)
+         && check_columns(docset, DOCSET_COL_TYPE)
+         && check_batch(docset, DOCSET_COL_PATH);
+
+    ok = ok && docset_count(docset) == 1000 && docset_count(docset) == 1000;
+
+    docset_close(docset);
+    ok = ok && check_open_ex(dir) && check_lazy(kind, dir);
+    fixture_remove(dir);
+    return ok;
+}
+
+int main()
+{
+    return !fixture_check_kinds(check_kind);
+}
@@ -0,0 +1,197 @@
+#define _XOPEN_SOURCE 700
+
+#include "docset.h"
+#include "fixture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Entries of the last fixture file have no document. */
+enum { NUM_ENTRIES = 200, ENTRIES_PER_FILE = 50, NUM_FILES = 3 };
+
+static char tags[NUM_ENTRIES][64];
+
+/* Writes the tag defining the anchor of the entry i to the buffer,
+ * leaves it empty for the anchors missing in the document. */
+static void anchor_tag(unsigned i, char *buf, size_t size)
+{
+    if (i % 3 == 0) {
+        snprintf(buf, size, "<a name=\"anchor%u\">", i);
+    } else if (i % 3 == 1) {
+        snprintf(buf, size, "<h2 class=\"x\" ID='anchor%u'>", i);
+    } else if (i % 5 == 0) {
+        buf[0] = '\0';
+    } else {
+        snprintf(buf, size, "<div\n    id = \"anchor%u\">", i);
+    }
+}
+
+static int write_documents(const char *dir)
+{
+    char path[FIXTURE_PATH_MAX + 64];
+    unsigned f, i;
+    FILE *out;
+
+    for (f = 0; f < NUM_FILES; ++f) {
+        snprintf(path, sizeof(path),
+                 "%s/Contents/Resources/Documents/file%u.html", dir, f);
+        if (!(out = fopen(path, "w"))) {
+            return 0;
+        }
+
+        fprintf(out, "<html><body>\n");
+        for (i = f * ENTRIES_PER_FILE; i < (f + 1) * ENTRIES_PER_FILE; ++i) {
+            /* Neither links nor other attributes define anchors. */
+            fprintf(out, "<a href=\"#anchor%u\">link</a>\n", i);
+            fprintf(out, "<p data-id=\"anchor%u\">text</p>\n", i);
+            anchor_tag(i, tags[i], sizeof(tags[i]));
+            fprintf(out, "%s%s\n", tags[i], tags[i][0] ? "entry" : "");
+        }
+        fprintf(out, "</body></html>\n");
+        fclose(out);
+    }
+    return 1;
+}
+
+static int check_entry(DocSet *docset, DocSetEntry *e)
+{
+    unsigned i = (unsigned)docset_entry_id(e) - 1;
+    int has_anchor = strchr(docset_entry_path(e), '#') && tags[i][0];
+    DocSetDocument doc;
+    DocSetError err;
+    int ok;
+
+    err = docset_open_document(docset, e, &doc);
+    if (i >= NUM_FILES * ENTRIES_PER_FILE) {
+        ok = err == DOCSET_NO_DOCUMENT && doc.data == NULL;
+    } else if (has_anchor) {
+        ok = err == DOCSET_OK
+             && doc.anchor_offset < doc.size
+             && strncmp(doc.data + doc.anchor_offset, tags[i],
+                        strlen(tags[i])) == 0;
+    } else {
+        ok = err == DOCSET_OK && doc.anchor_offset == DOCSET_NO_ANCHOR;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "%s: unexpected document\n", docset_entry_path(e));
+    }
+    docset_close_document(&doc);
+    return ok;
+}
+
+static int check_paths(DocSet *docset)
+{
+    static const char *BAD_PATHS[] = {
+        "", "#anchor1", "/etc/passwd", "../Info.plist", "file0/../../x",
+        "http://example.com/file0.html", "nosuch.html", "<dash_entry"
+    };
+    const char *docs = docset_documents_path(docset);
+    const char *suffix = "/Contents/Resources/Documents/";
+    DocSetDocument doc;
+    size_t i;
+    int ok;
+
+    ok = strlen(docs) > strlen(suffix)
+         && strcmp(docs + strlen(docs) - strlen(suffix), suffix) == 0;
+
+    for (i = 0; ok && i < ARRAY_SIZE(BAD_PATHS); ++i) {
+        ok = docset_open_document_path(docset, BAD_PATHS[i], &doc)
+             == DOCSET_NO_DOCUMENT;
+        if (!ok) {
+            fprintf(stderr, "%s: unexpected document\n", BAD_PATHS[i]);
+        }
+    }
+
+    ok = ok && docset_open_document_path(
+                   docset, "<dash_entry_name=x><dash_entry_menuDescription=y>"
+                   "file0.html?lang=c#anchor3", &doc) == DOCSET_OK
+         && strncmp(doc.data + doc.anchor_offset, tags[3],
+                    strlen(tags[3])) == 0;
+    docset_close_document(&doc);
+    return ok;
+}
+
+static int check_cache(DocSet *docset)
+{
+    DocSetDocument docs[NUM_FILES];
+    char path[32];
+    DocSetStats stats;
+    unsigned f;
+    int round, ok = 1;
+
+    docset_set_document_cache(docset, 0);
+    docset_set_document_cache(docset, 1);
+    docset_reset_stats(docset);
+
+    /* Only the last closed file stays mapped. */
+    for (round = 0; round < 2; ++round) {
+        for (f = 0; f < NUM_FILES; ++f) {
+            snprintf(path, sizeof(path), "file%u.html", f);
+            ok = docset_open_document_path(docset, path, docs + f)
+                 == DOCSET_OK && ok;
+        }
+        for (f = 0; f < NUM_FILES; ++f) {
+            docset_close_document(docs + f);
+        }
+    }
+    docset_get_stats(docset, &stats);
+    ok = ok && stats.document_cache_hits == 1
+         && stats.document_cache_misses == 2 * NUM_FILES - 1;
+    docset_reset_stats(docset);
+
+    /* Documents stay mapped while they are open. */
+    ok = ok && docset_open_document_path(docset, "file0.html", docs)
+               == DOCSET_OK
+         && docset_open_document_path(docset, "file0.html", docs + 1)
+            == DOCSET_OK
+         && docs[0].data == docs[1].data;
+    docset_close_document(docs);
+    docset_close_document(docs + 1);
+
+    docset_get_stats(docset, &stats);
+    ok = ok && stats.document_cache_hits == 1;
+    if (!ok) {
+        fprintf(stderr, "unexpected document cache behavior\n");
+    }
+    return ok;
+}
+
+static int check_kind(DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *docset;
+    DocSetCursor *c;
+    DocSetStats stats;
+    int ok = 1;
+
+    if (!fixture_create(kind, NUM_ENTRIES, dir) || !write_documents(dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 0;
+    }
+    if (docset_try_open(&docset, dir) != DOCSET_OK) {
+        fprintf(stderr, "Can't open %s fixture\n", docset_kind_name(kind));
+        fixture_remove(dir);
+        return 0;
+    }
+
+    c = docset_list_entries(docset);
+    while (ok && docset_cursor_step(c)) {
+        ok = check_entry(docset, docset_cursor_entry(c));
+    }
+    docset_cursor_dispose(c);
+
+    /* Every document is mapped once. */
+    docset_get_stats(docset, &stats);
+    ok = ok && stats.document_cache_misses == NUM_FILES
+         && check_paths(docset) && check_cache(docset);
+
+    docset_close(docset);
+    fixture_remove(dir);
+    return ok;
+}
+
+int main()
+{
+    return !fixture_check_kinds(check_kind);
+}
@@ -0,0 +1,92 @@
+#include <docset.hpp>
+
+extern "C" {
+#include "fixture.h"
+}
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+
+const char *const patterns[] = { "%", "printf", "%Size%", "nosuch" };
+
+bool same_entries(const std::vector<docset::entry> &expected,
+                  const std::vector<docset::entry> &actual,
+                  const char *what, const char *pattern)
+{
+    if (expected.size() != actual.size()) {
+        std::fprintf(stderr, "%s: %s: expected %u entries, got %u\n",
+                     what, pattern, unsigned(expected.size()),
+                     unsigned(actual.size()));
+        return false;
+    }
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i].id() != actual[i].id() || expected[i] != actual[i]) {
+            std::fprintf(stderr, "%s: %s: entry %u differs\n",
+                         what, pattern, unsigned(i));
+            return false;
+        }
+    }
+    return true;
+}
+
+// collect_into() replaces the contents of the vector and leaves the
+// range exhausted.
+bool check_collect(const docset::doc_set &ds, const char *pattern)
+{
+    std::vector<docset::entry> iterated, collected(3), rest(1), by_ids;
+    std::vector<docset::entry::id_type> ids;
+
+    for (const docset::entry &e : ds.find(pattern)) {
+        iterated.push_back(e);
+        ids.push_back(e.id());
+    }
+
+    auto range = ds.find(pattern);
+    range.collect_into(collected);
+    range.collect_into(rest);
+
+    if (!ids.empty()) {
+        ds.find_by_ids(ids).collect_into(by_ids);
+    }
+
+    return same_entries(iterated, collected, "collect_into", pattern)
+        && same_entries(iterated, by_ids, "find_by_ids", pattern)
+        && same_entries({}, rest, "exhausted range", pattern);
+}
+
+bool check_kind(::DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    bool ok = true;
+
+    if (!fixture_create(kind, 2000, dir)) {
+        std::fprintf(stderr, "Can't create fixture\n");
+        return false;
+    }
+
+    try {
+        docset::doc_set ds(dir);
+
+        for (const char *pattern : patterns) {
+            ok = ok && check_collect(ds, pattern);
+        }
+    } catch (const docset::error &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        ok = false;
+    }
+
+    fixture_remove(dir);
+    return ok;
+}
+
+}
+
+int main()
+{
+    return !::fixture_check_kinds([](::DocSetKind kind) -> int {
+        return check_kind(kind);
+    });
+}
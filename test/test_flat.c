@@ -0,0 +1,114 @@
+#include "docset.h"
+#include "fixture.h"
+
+#include <sqlite3.h>
+#include <stdio.h>
+
+static const char *PATTERNS[] = {
+    "printf", "PRINTF", "Print%", "%Size%", "std::vector::%", "nosuch", ""
+};
+
+static int check_same(DocSet *plain, DocSet *flat)
+{
+    static const DocSetEntryId ids[] = { 7, 3, 100, 5000, 42 };
+    size_t i;
+    int ok;
+
+    ok = docset_kind(flat) == DOCSET_KIND_ZDASH
+         && docset_count(flat) == docset_count(plain)
+         && fixture_same_entries(
+                docset_find_by_ids(plain, ids, ARRAY_SIZE(ids)),
+                docset_find_by_ids(flat, ids, ARRAY_SIZE(ids)), "by ids", 0)
+         && fixture_same_entries(
+                docset_find_ex(plain, "%print%", DOCSET_COL_PATH),
+                docset_find_ex(flat, "%print%", DOCSET_COL_PATH),
+                "%print% in paths", 0);
+
+    for (i = 0; ok && i < ARRAY_SIZE(PATTERNS); ++i) {
+        ok = fixture_same_entries(docset_find(plain, PATTERNS[i]),
+                                  docset_find(flat, PATTERNS[i]),
+                                  PATTERNS[i], 0);
+    }
+    return ok;
+}
+
+static int count_exact(const char *dir, const char *name)
+{
+    DocSet *docset;
+    DocSetCursor *c;
+    int n = 0;
+
+    if (docset_try_open(&docset, dir) != DOCSET_OK) {
+        return -1;
+    }
+    docset_set_cache_dir(docset, dir);
+    if (docset_flatten(docset) != DOCSET_OK) {
+        docset_close(docset);
+        return -1;
+    }
+
+    c = docset_find(docset, name);
+    while (docset_cursor_step(c)) {
+        ++n;
+    }
+    docset_cursor_dispose(c);
+    docset_close(docset);
+    return n;
+}
+
+/* The first flattening saves the flat database, later ones reuse it
+ * until the docset database changes. */
+static int check_cache_file(const char *dir)
+{
+    static const char INSERT[] =
+        "insert into ztoken(z_pk, ztokenname, ztokentype, zmetainformation) "
+        "values (1000000, 'brand_new', 1, 1)";
+    char db_path[FIXTURE_PATH_MAX + 64];
+    sqlite3 *db;
+    int ok;
+
+    sprintf(db_path, "%s/Contents/Resources/docSet.dsidx", dir);
+
+    ok = count_exact(dir, "printf") > 0
+         && count_exact(dir, "printf") == count_exact(dir, "PRINTF")
+         && count_exact(dir, "brand_new") == 0;
+
+    ok = ok
+         && sqlite3_open(db_path, &db) == SQLITE_OK
+         && sqlite3_exec(db, INSERT, NULL, NULL, NULL) == SQLITE_OK;
+    sqlite3_close(db);
+
+    ok = ok && count_exact(dir, "brand_new") == 1
+         && count_exact(dir, "Brand_New") == 1;
+
+    if (!ok) {
+        fprintf(stderr, "flat database file is not used properly\n");
+    }
+    return ok;
+}
+
+int main()
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *plain = NULL;
+    DocSet *flat = NULL;
+    int ok;
+
+    if (!fixture_create(DOCSET_KIND_ZDASH, 1000, dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 1;
+    }
+
+    ok = docset_try_open(&plain, dir) == DOCSET_OK
+         && docset_try_open(&flat, dir) == DOCSET_OK
+         && docset_flatten(flat) == DOCSET_OK
+         && docset_flatten(flat) == DOCSET_OK
+         && check_same(plain, flat);
+
+    docset_close(plain);
+    docset_close(flat);
+
+    ok = ok && check_cache_file(dir);
+    fixture_remove(dir);
+    return !ok;
+}
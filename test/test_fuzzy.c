@@ -0,0 +1,106 @@
+#include "docset.h"
+#include "fixture.h"
+
+#include <stdio.h>
+
+#define FOLD(c) (('A' <= (c) && (c) <= 'Z') ? (c) + ('a' - 'A') : (c))
+
+static int is_subsequence(const char *query, const char *name)
+{
+    for (; *name && *query; ++name) {
+        if (FOLD(*name) == FOLD(*query)) {
+            ++query;
+        }
+    }
+    return *query == '\0';
+}
+
+static int same_folded(const char *a, const char *b)
+{
+    for (; *a && FOLD(*a) == FOLD(*b); ++a, ++b) {
+    }
+    return *a == *b;
+}
+
+static size_t count_matches(DocSet *docset, const char *query)
+{
+    DocSetCursor *c = docset_list_entries(docset);
+    size_t n = 0;
+
+    while (docset_cursor_step(c)) {
+        n += is_subsequence(query, docset_entry_name(docset_cursor_entry(c)));
+    }
+    docset_cursor_dispose(c);
+    return n;
+}
+
+/* Checks that the result has the expected size, contains only matching
+ * names and starts with the @p best name (up to case). */
+static int check_query(DocSet *docset, const char *query, size_t k,
+                       const char *best)
+{
+    DocSetCursor *c = docset_fuzzy_find(docset, query, k);
+    size_t expected = count_matches(docset, query);
+    size_t n = 0;
+    int ok = c != NULL;
+
+    if (expected > k) {
+        expected = k;
+    }
+    if (*query == '\0') {
+        expected = 0;
+    }
+
+    while (ok && docset_cursor_step(c)) {
+        DocSetEntry *e = docset_cursor_entry(c);
+
+        ok = is_subsequence(query, docset_entry_name(e))
+             && docset_entry_path(e) != NULL
+             && (n > 0 || !best || same_folded(best, docset_entry_name(e)));
+        ++n;
+    }
+    ok = ok && n == expected;
+
+    if (!ok) {
+        fprintf(stderr, "%s: unexpected result for %s\n",
+                docset_name(docset), query);
+    }
+
+    docset_cursor_dispose(c);
+    return ok;
+}
+
+static int check_kind(DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *docset;
+    int ok;
+
+    if (!fixture_create(kind, 1000, dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 0;
+    }
+
+    if (docset_try_open(&docset, dir) != DOCSET_OK) {
+        fprintf(stderr, "Can't open fixture\n");
+        fixture_remove(dir);
+        return 0;
+    }
+
+    ok = check_query(docset, "vecpb", 5, "std::vector::push_back")
+         && check_query(docset, "VECPB", 2000, "std::vector::push_back")
+         && check_query(docset, "pb", 10, "push_back")
+         && check_query(docset, "printf", 3, "printf")
+         && check_query(docset, "nosuch", 10, NULL)
+         && check_query(docset, "", 10, NULL)
+         && check_query(docset, "s", 0, NULL);
+
+    docset_close(docset);
+    fixture_remove(dir);
+    return ok;
+}
+
+int main()
+{
+    return !fixture_check_kinds(check_kind);
+}
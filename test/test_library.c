@@ -0,0 +1,188 @@
+#include "docset.h"
+#include "fixture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum { NUM_DOCSETS = 3, NUM_ADDED = 32 };
+
+static const char PATTERN[] = "%print%";
+
+static int check_by_docset(DocSetLibrary *library)
+{
+    DocSetCursor *merged = docset_library_find(library, PATTERN,
+                                               DOCSET_ORDER_BY_DOCSET);
+    DocSetCursor *single;
+    unsigned i;
+    int ok = merged != NULL;
+
+    for (i = 0; ok && i < docset_library_size(library); ++i) {
+        DocSet *docset = docset_library_docset(library, i);
+
+        single = docset_find(docset, PATTERN);
+        while (ok && docset_cursor_step(single)) {
+            ok = docset_cursor_step(merged)
+                 && docset_cursor_docset(merged) == docset
+                 && docset_entry_id(docset_cursor_entry(merged))
+                    == docset_entry_id(docset_cursor_entry(single))
+                 && strcmp(docset_entry_path(docset_cursor_entry(merged)),
+                           docset_entry_path(docset_cursor_entry(single)))
+                    == 0;
+        }
+        docset_cursor_dispose(single);
+    }
+
+    ok = ok && !docset_cursor_step(merged);
+    docset_cursor_dispose(merged);
+
+    if (!ok) {
+        fprintf(stderr, "Unexpected results ordered by docset\n");
+    }
+    return ok;
+}
+
+static int check_by_rank(DocSetLibrary *library)
+{
+    DocSetCursor *merged = docset_library_find(library, PATTERN,
+                                               DOCSET_ORDER_BY_RANK);
+    int rows = 0;
+    int seen_substring = 0;
+    int ok = merged != NULL;
+
+    /* Names that start with "print" must go before the others. */
+    while (ok && docset_cursor_step(merged)) {
+        const char *name = docset_entry_name(docset_cursor_entry(merged));
+        int is_prefix = strncmp(name, "print", 5) == 0
+                        || strncmp(name, "Print", 5) == 0
+                        || strncmp(name, "PRINT", 5) == 0;
+        if (!is_prefix) {
+            seen_substring = 1;
+        } else if (seen_substring) {
+            fprintf(stderr, "%s is out of order\n", name);
+            ok = 0;
+        }
+        ++rows;
+    }
+
+    docset_cursor_dispose(merged);
+    return ok && rows > 0 && seen_substring;
+}
+
+/* Cursors keep working while the library grows. */
+static int check_add_while_iterating(DocSetLibrary *library,
+                                     const char    *dir)
+{
+    DocSetCursor *merged = docset_library_find(library, PATTERN,
+                                               DOCSET_ORDER_BY_DOCSET);
+    unsigned n = docset_library_size(library);
+    unsigned i;
+    int rows = 0;
+    int ok = merged != NULL;
+
+    /* Enough docsets to move the library storage. */
+    for (i = 0; ok && i < NUM_ADDED; ++i) {
+        ok = docset_library_add(library, dir) == DOCSET_OK;
+    }
+
+    while (ok && docset_cursor_step(merged)) {
+        DocSet *docset = docset_cursor_docset(merged);
+
+        ok = docset != NULL;
+        for (i = 0; ok && docset_library_docset(library, i) != docset; ++i) {
+            ok = i + 1 < n;
+        }
+        ++rows;
+    }
+    docset_cursor_dispose(merged);
+
+    if (!ok || rows == 0) {
+        fprintf(stderr, "Unexpected results after adding docsets\n");
+    }
+    return ok && rows > 0;
+}
+
+static void count_error(void *ctx, const char *msg)
+{
+    (void)msg;
+    ++*(int *)ctx;
+}
+
+/* A docset that fails to answer doesn't fail the whole search. */
+static int check_broken_docset(const char *good_dir)
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSetLibrary *library = NULL;
+    DocSetCursor *merged = NULL;
+    DocSetCursor *single = NULL;
+    int errors = 0;
+    int ok;
+
+    if (!fixture_create(DOCSET_KIND_DASH, 500, dir)) {
+        return 0;
+    }
+
+    ok = docset_library_create(&library, 2) == DOCSET_OK
+         && docset_library_add(library, dir) == DOCSET_OK
+         && docset_library_add(library, good_dir) == DOCSET_OK
+         && fixture_break(dir);
+
+    if (ok) {
+        docset_set_error_handler(docset_library_docset(library, 0),
+                                 count_error, &errors);
+        merged = docset_library_find(library, PATTERN,
+                                     DOCSET_ORDER_BY_DOCSET);
+        single = docset_find(docset_library_docset(library, 1), PATTERN);
+        ok = merged && single;
+    }
+
+    while (ok && docset_cursor_step(single)) {
+        ok = docset_cursor_step(merged)
+             && docset_cursor_docset(merged)
+                == docset_library_docset(library, 1);
+    }
+    ok = ok && !docset_cursor_step(merged) && errors > 0;
+
+    docset_cursor_dispose(single);
+    docset_cursor_dispose(merged);
+    docset_library_close(library);
+    fixture_remove(dir);
+
+    if (!ok) {
+        fprintf(stderr, "Unexpected results with a broken docset\n");
+    }
+    return ok;
+}
+
+int main()
+{
+    char dirs[NUM_DOCSETS][FIXTURE_PATH_MAX];
+    DocSetLibrary *library = NULL;
+    int ok = 1;
+    int i;
+
+    for (i = 0; i < NUM_DOCSETS; ++i) {
+        ok = ok && fixture_create(i % 2 ? DOCSET_KIND_ZDASH : DOCSET_KIND_DASH,
+                                  500 * (i + 1), dirs[i]);
+    }
+
+    ok = ok && docset_library_create(&library, NUM_DOCSETS) == DOCSET_OK;
+
+    for (i = 0; ok && i < NUM_DOCSETS; ++i) {
+        ok = docset_library_add(library, dirs[i]) == DOCSET_OK;
+    }
+
+    ok = ok
+         && docset_library_size(library) == NUM_DOCSETS
+         && docset_library_add(library, "/nonexistent") != DOCSET_OK
+         && check_by_docset(library)
+         && check_by_rank(library)
+         && check_add_while_iterating(library, dirs[0])
+         && check_broken_docset(dirs[1]);
+
+    docset_library_close(library);
+
+    for (i = 0; i < NUM_DOCSETS; ++i) {
+        fixture_remove(dirs[i]);
+    }
+    return !ok;
+}
@@ -0,0 +1,225 @@
+#define _XOPEN_SOURCE 700
+
+#include "docset.h"
+#include "fixture.h"
+
+#include <dirent.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *PATTERNS[] = {
+    "printf", "PRINTF", "Print%", "print%%", "std::vector::%",
+    "std::vector::push_back1%", "Str_%", "str_%", "p%f", "%printf",
+    "_rintf%", "", "nosuch%", "zz", "zzx%%"
+};
+
+static int total_rows;
+
+static int check_pattern(DocSet *docset, const char *pattern)
+{
+    DocSetCursor *expected;
+    DocSetCursor *actual;
+    DocSetEntry *e, *a;
+    int has_e, has_a;
+    int rows = 0;
+
+    docset_set_name_index(docset, 0);
+    expected = docset_find(docset, pattern);
+    docset_set_name_index(docset, 1);
+    actual = docset_find(docset, pattern);
+
+    for (;;) {
+        has_e = docset_cursor_step(expected);
+        has_a = docset_cursor_step(actual);
+        if (has_e != has_a) {
+            fprintf(stderr, "%s: %s: result sizes differ after %d rows\n",
+                    docset_name(docset), pattern, rows);
+            return 0;
+        }
+        if (!has_e) {
+            break;
+        }
+        e = docset_cursor_entry(expected);
+        a = docset_cursor_entry(actual);
+        if (docset_entry_id(e) != docset_entry_id(a)
+            || strcmp(docset_entry_name(e), docset_entry_name(a)) != 0
+            || strcmp(docset_entry_path(e), docset_entry_path(a)) != 0) {
+            fprintf(stderr, "%s: %s: expected %d (%s), got %d (%s)\n",
+                    docset_name(docset), pattern,
+                    docset_entry_id(e), docset_entry_name(e),
+                    docset_entry_id(a), docset_entry_name(a));
+            return 0;
+        }
+        ++rows;
+    }
+
+    docset_cursor_dispose(expected);
+    docset_cursor_dispose(actual);
+    total_rows += rows;
+    return 1;
+}
+
+static int count_exact(const char *dir, const char *name)
+{
+    DocSet *docset;
+    DocSetCursor *c;
+    int n = 0;
+
+    if (docset_try_open(&docset, dir) != DOCSET_OK) {
+        return -1;
+    }
+    docset_set_cache_dir(docset, dir);
+    docset_set_name_index(docset, 1);
+
+    c = docset_find(docset, name);
+    while (docset_cursor_step(c)) {
+        ++n;
+    }
+    docset_cursor_dispose(c);
+    docset_close(docset);
+    return n;
+}
+
+/* Points the names of all the items of the index file in @p dir past
+ * the names block. The items follow the header and the database path,
+ * the number of items is the fifth header field after the magic. */
+static int corrupt_index(const char *dir)
+{
+    static const char DB_NAME[] = "docSet.dsidx";
+    static const unsigned int BAD_NAME = 0x7fffffffU;
+    const size_t item_size = sizeof(unsigned int) + sizeof(DocSetEntryId);
+    char path[FIXTURE_PATH_MAX + 64];
+    struct dirent *de;
+    DIR *d;
+    FILE *f;
+    char *data = NULL;
+    unsigned long num_items = 0;
+    long size = 0, i;
+    int ok = 0;
+
+    path[0] = '\0';
+    if ((d = opendir(dir))) {
+        while ((de = readdir(d))) {
+            size_t len = strlen(de->d_name);
+
+            if (len > 5 && strcmp(de->d_name + len - 5, ".dsni") == 0) {
+                sprintf(path, "%s/%s", dir, de->d_name);
+            }
+        }
+        closedir(d);
+    }
+
+    if (!path[0] || !(f = fopen(path, "r+b"))) {
+        return 0;
+    }
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0
+        && (data = (char *) malloc((size_t)size))
+        && fseek(f, 0, SEEK_SET) == 0
+        && fread(data, 1, (size_t)size, f) == (size_t)size) {
+        memcpy(&num_items, data + 8 + 4 * sizeof(unsigned long),
+               sizeof(num_items));
+        for (i = 0; i + (long)sizeof(DB_NAME) <= size; ++i) {
+            if (memcmp(data + i, DB_NAME, sizeof(DB_NAME)) == 0) {
+                break;
+            }
+        }
+        i = (i + (long)sizeof(DB_NAME) + 7) & ~7L;
+        ok = num_items > 0 && i + (long)(num_items * item_size) <= size;
+        for (; ok && num_items > 0; --num_items, i += (long)item_size) {
+            memcpy(data + i, &BAD_NAME, sizeof(BAD_NAME));
+        }
+        ok = ok && fseek(f, 0, SEEK_SET) == 0
+             && fwrite(data, 1, (size_t)size, f) == (size_t)size;
+    }
+    free(data);
+    return fclose(f) == 0 && ok;
+}
+
+/* The first open saves the index file, the second one maps it, a change
+ * of the database makes the file stale. */
+static int check_cache_file(DocSetKind kind)
+{
+    static const char *INSERTS[] = {
+        "insert into searchIndex(name, type, path) "
+        "values ('brand_new', 'Function', 'new.html')",
+        "insert into ztoken(z_pk, ztokenname, ztokentype, zmetainformation) "
+        "values (1000000, 'brand_new', 1, 1)"
+    };
+    char dir[FIXTURE_PATH_MAX];
+    char db_path[FIXTURE_PATH_MAX + 64];
+    sqlite3 *db;
+    int n, ok;
+
+    if (!fixture_create(kind, 1000, dir)) {
+        return 0;
+    }
+    sprintf(db_path, "%s/Contents/Resources/docSet.dsidx", dir);
+
+    ok = count_exact(dir, "printf") > 0
+         && count_exact(dir, "printf") == count_exact(dir, "PRINTF")
+         && count_exact(dir, "brand_new") == 0;
+
+    /* A corrupted file is rejected and the index is built again. */
+    n = count_exact(dir, "printf");
+    ok = ok && corrupt_index(dir) && count_exact(dir, "printf") == n;
+
+    ok = ok
+         && sqlite3_open(db_path, &db) == SQLITE_OK
+         && sqlite3_exec(db, INSERTS[kind], NULL, NULL, NULL) == SQLITE_OK;
+    sqlite3_close(db);
+
+    ok = ok && count_exact(dir, "brand_new") == 1
+         && count_exact(dir, "brand_new") == 1;
+
+    if (!ok) {
+        fprintf(stderr, "%s: index file is not used properly\n",
+                docset_kind_name(kind));
+    }
+    fixture_remove(dir);
+    return ok;
+}
+
+static int check_kind(DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *docset;
+    size_t i;
+    int ok = 1;
+
+    if (!fixture_create(kind, 3000, dir)) {
+        fprintf(stderr, "Can't create %s fixture\n", docset_kind_name(kind));
+        return 0;
+    }
+
+    if (docset_try_open(&docset, dir) != DOCSET_OK) {
+        fprintf(stderr, "Can't open %s fixture\n", docset_kind_name(kind));
+        fixture_remove(dir);
+        return 0;
+    }
+
+    total_rows = 0;
+    for (i = 0; ok && i < ARRAY_SIZE(PATTERNS); ++i) {
+        ok = check_pattern(docset, PATTERNS[i]);
+    }
+
+    if (ok && total_rows == 0) {
+        fprintf(stderr, "%s: no entries found\n", docset_kind_name(kind));
+        ok = 0;
+    }
+
+    docset_close(docset);
+    fixture_remove(dir);
+    return ok;
+}
+
+int main()
+{
+    if (!fixture_check_kinds(check_kind)
+        || !check_cache_file(DOCSET_KIND_DASH)
+        || !check_cache_file(DOCSET_KIND_ZDASH)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include "docset.h"
+#include "fixture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char XML_PLIST[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<plist version=\"1.0\">\n"
+    "<dict>\n"
+    "  <key>Nested</key>\n"
+    "  <dict><key>CFBundleName</key><string>Nested</string></dict>\n"
+    "  <key>CFBundleIdentifier</key><string>xml&amp;fixture</string>\n"
+    "  <key>CFBundleName</key><string>Fixture</string>\n"
+    "  <key>isJavaScriptEnabled</key><true/>\n"
+    "  <key>DocSetPlatformFamily</key><string>xml</string>\n"
+    "  <key>isDashDocset</key><false/>\n"
+    "  <key>CFBundleName</key><string>Duplicate</string>\n"
+    "</dict>\n"
+    "</plist>\n";
+
+/* "Café 😀" in UTF-16BE. */
+static const unsigned char UTF16_NAME[] = {
+    0x00, 'C', 0x00, 'a', 0x00, 'f', 0x00, 0xE9, 0x00, ' ',
+    0xD8, 0x3D, 0xDE, 0x00
+};
+
+static const char *BINARY_KEYS[] = {
+    "CFBundleIdentifier", "CFBundleName", "DocSetPlatformFamily",
+    "isDashDocset", "isJavaScriptEnabled", "Extra"
+};
+
+static const char LONG_FAMILY[] = "a-rather-long-platform-family";
+
+static void put_ascii(FILE *f, const char *s)
+{
+    size_t n = strlen(s);
+
+    if (n < 15) {
+        fputc(0x50 | (int)n, f);
+    } else {
+        fputc(0x5F, f);
+        fputc(0x10, f);
+        fputc((int)n, f);
+    }
+    fwrite(s, 1, n, f);
+}
+
+/* Writes a binary property list with a single dictionary, object
+ * references and offsets take one byte. */
+static int write_binary(const char *path, size_t truncate)
+{
+    enum { NUM_KEYS = ARRAY_SIZE(BINARY_KEYS) };
+    unsigned char offsets[1 + 2 * NUM_KEYS];
+    unsigned char trailer[32];
+    size_t i, n = 0;
+    long size;
+    FILE *f;
+
+    if (!(f = fopen(path, "wb"))) {
+        return 0;
+    }
+
+    fputs("bplist00", f);
+
+    offsets[n++] = (unsigned char)ftell(f);
+    fputc(0xD0 | NUM_KEYS, f);
+    for (i = 0; i < 2 * NUM_KEYS; ++i) {
+        fputc((int)(i + 1), f);
+    }
+
+    for (i = 0; i < NUM_KEYS; ++i) {
+        offsets[n++] = (unsigned char)ftell(f);
+        put_ascii(f, BINARY_KEYS[i]);
+    }
+
+    offsets[n++] = (unsigned char)ftell(f);
+    put_ascii(f, "binary.fixture");
+    offsets[n++] = (unsigned char)ftell(f);
+    fputc(0x60 | (int)(sizeof(UTF16_NAME) / 2), f);
+    fwrite(UTF16_NAME, 1, sizeof(UTF16_NAME), f);
+    offsets[n++] = (unsigned char)ftell(f);
+    put_ascii(f, LONG_FAMILY);
+    offsets[n++] = (unsigned char)ftell(f);
+    fputc(0x09, f);
+    offsets[n++] = (unsigned char)ftell(f);
+    fputc(0x08, f);
+    offsets[n++] = (unsigned char)ftell(f);
+    fputc(0x10, f);
+    fputc(42, f);
+
+    size = ftell(f);
+    fwrite(offsets, 1, n, f);
+
+    memset(trailer, 0, sizeof(trailer));
+    trailer[6] = 1;
+    trailer[7] = 1;
+    trailer[15] = (unsigned char)n;
+    trailer[31] = (unsigned char)size;
+    fwrite(trailer, 1, sizeof(trailer) - truncate, f);
+
+    fclose(f);
+    return 1;
+}
+
+static int write_xml(const char *path)
+{
+    FILE *f = fopen(path, "w");
+
+    if (!f) {
+        return 0;
+    }
+    fputs(XML_PLIST, f);
+    fclose(f);
+    return 1;
+}
+
+static int check_open(const char *dir,
+                      const char *bundle_id,
+                      const char *name,
+                      const char *family,
+                      DocSetFlags flags)
+{
+    DocSet *docset;
+    int ok;
+
+    if (docset_try_open(&docset, dir) != DOCSET_OK) {
+        fprintf(stderr, "Can't open %s\n", bundle_id);
+        return 0;
+    }
+
+    ok = strcmp(docset_bundle_identifier(docset), bundle_id) == 0
+         && strcmp(docset_name(docset), name) == 0
+         && strcmp(docset_platform_family(docset), family) == 0
+         && docset_flags(docset) == flags;
+
+    if (!ok) {
+        fprintf(stderr, "%s: unexpected properties\n", bundle_id);
+    }
+    docset_close(docset);
+    return ok;
+}
+
+int main()
+{
+    char dir[FIXTURE_PATH_MAX];
+    char path[FIXTURE_PATH_MAX + 32];
+    DocSet *docset;
+    DocSetError err;
+    int ok;
+
+    if (!fixture_create(DOCSET_KIND_DASH, 10, dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 1;
+    }
+    sprintf(path, "%s/Contents/Info.plist", dir);
+
+    ok = write_xml(path)
+         && check_open(dir, "xml&fixture", "Fixture", "xml",
+                       DOCSET_IS_JS_ENABLED);
+
+    ok = ok
+         && write_binary(path, 0)
+         && check_open(dir, "binary.fixture",
+                       "Caf\xC3\xA9 \xF0\x9F\x98\x80", LONG_FAMILY,
+                       DOCSET_IS_DASH);
+
+    ok = ok && write_binary(path, 1);
+    if (ok && (err = docset_try_open(&docset, dir)) != DOCSET_BAD_XML) {
+        fprintf(stderr, "Truncated binary plist is accepted\n");
+        if (err == DOCSET_OK) {
+            docset_close(docset);
+        }
+        ok = 0;
+    }
+
+    fixture_remove(dir);
+    return !ok;
+}
@@ -0,0 +1,141 @@
+#include "docset.h"
+#include "fixture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define FOLD(c) (('A' <= (c) && (c) <= 'Z') ? (c) + ('a' - 'A') : (c))
+
+enum { MATCH_EXACT, MATCH_PREFIX, MATCH_WORD, MATCH_SUBSTRING };
+
+static int starts_with(const char *s, const char *prefix)
+{
+    for (; *prefix; ++s, ++prefix) {
+        if (FOLD(*s) != FOLD(*prefix)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* A simplified classifier, good enough for the fixture names. */
+static int classify(const char *name, const char *needle)
+{
+    size_t i;
+    int m = MATCH_SUBSTRING;
+
+    if (starts_with(name, needle)) {
+        return strlen(name) == strlen(needle) ? MATCH_EXACT : MATCH_PREFIX;
+    }
+    for (i = 1; name[i]; ++i) {
+        if (starts_with(name + i, needle)
+            && (name[i - 1] == ':' || name[i - 1] == '_')) {
+            m = MATCH_WORD;
+        }
+    }
+    return m;
+}
+
+static size_t count(DocSet *docset, const char *pattern)
+{
+    DocSetCursor *c = docset_find(docset, pattern);
+    size_t n = 0;
+
+    while (docset_cursor_step(c)) {
+        ++n;
+    }
+    docset_cursor_dispose(c);
+    return n;
+}
+
+/* Checks that results are ordered by the match class, then by length. */
+static int check_order(DocSet *docset, const char *pattern,
+                       const char *needle, size_t k)
+{
+    DocSetCursor *c = docset_find_top(docset, pattern, k);
+    size_t expected = count(docset, pattern);
+    size_t n = 0, len, last_len = 0;
+    int m, last_m = MATCH_EXACT;
+    int ok = c != NULL;
+
+    while (ok && docset_cursor_step(c)) {
+        const char *name = docset_entry_name(docset_cursor_entry(c));
+
+        m = classify(name, needle);
+        len = strlen(name);
+        ok = docset_entry_path(docset_cursor_entry(c)) != NULL
+             && (m > last_m || (m == last_m && len >= last_len));
+        last_m = m;
+        last_len = len;
+        ++n;
+    }
+    ok = ok && n == (expected < k ? expected : k) && n > 0;
+
+    if (!ok) {
+        fprintf(stderr, "%s: unexpected order for %s\n",
+                docset_name(docset), pattern);
+    }
+    docset_cursor_dispose(c);
+    return ok;
+}
+
+/* All the results of an exact pattern are equal but their weights. */
+static int check_weights(DocSet *docset)
+{
+    DocSetCursor *c;
+    int seen_heavy = 0;
+    int ok;
+
+    docset_set_type_weight(docset, DOCSET_TYPE_FUNCTION, 10);
+    ok = docset_type_weight(docset, DOCSET_TYPE_FUNCTION) == 10;
+
+    c = docset_find_top(docset, "printf", 100);
+    ok = ok && c != NULL;
+    while (ok && docset_cursor_step(c)) {
+        int heavy = docset_entry_type(docset_cursor_entry(c))
+                    == DOCSET_TYPE_FUNCTION;
+        ok = heavy || !seen_heavy;
+        seen_heavy = seen_heavy || heavy;
+    }
+    docset_cursor_dispose(c);
+    docset_set_type_weight(docset, DOCSET_TYPE_FUNCTION, 0);
+
+    if (!ok || !seen_heavy) {
+        fprintf(stderr, "%s: type weights are ignored\n", docset_name(docset));
+        return 0;
+    }
+    return 1;
+}
+
+static int check_kind(DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *docset;
+    int ok;
+
+    if (!fixture_create(kind, 2000, dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 0;
+    }
+
+    if (docset_try_open(&docset, dir) != DOCSET_OK) {
+        fprintf(stderr, "Can't open fixture\n");
+        fixture_remove(dir);
+        return 0;
+    }
+
+    ok = check_order(docset, "%printf%", "printf", 10)
+         && check_order(docset, "%push_back%", "push_back", 100000)
+         && check_order(docset, "%push_back%", "push_back", 50)
+         && check_order(docset, "std::vector::%", "std::vector::", 3)
+         && check_weights(docset);
+
+    docset_close(docset);
+    fixture_remove(dir);
+    return ok;
+}
+
+int main()
+{
+    return !fixture_check_kinds(check_kind);
+}
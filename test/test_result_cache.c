@@ -0,0 +1,153 @@
+#include "docset.h"
+#include "fixture.h"
+
+#include <stdio.h>
+
+static const char *PATTERNS[] = {
+    "printf", "%Size%", "Print%", "nosuch"
+};
+
+static DocSetStats stats;
+
+static int same_entries(DocSetCursor *expected, DocSetCursor *actual,
+                        const char *pattern)
+{
+    return fixture_same_entries(expected, actual, pattern,
+                                FIXTURE_PATH_PRESENCE);
+}
+
+/* Checks the number of hits and misses since the last call. */
+static int counted(DocSet *docset, unsigned long hits, unsigned long misses)
+{
+    DocSetStats now;
+
+    docset_get_stats(docset, &now);
+    hits -= now.result_cache_hits - stats.result_cache_hits;
+    misses -= now.result_cache_misses - stats.result_cache_misses;
+    stats = now;
+
+    if (hits || misses) {
+        fprintf(stderr, "unexpected number of hits or misses\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int check_queries(DocSet *plain, DocSet *cached)
+{
+    DocSetTypeMask types;
+    size_t i;
+    int round, ok = 1;
+
+    docset_type_mask_clear(&types);
+    docset_type_mask_add(&types, DOCSET_TYPE_FUNCTION);
+
+    for (round = 0; ok && round < 2; ++round) {
+        for (i = 0; ok && i < ARRAY_SIZE(PATTERNS); ++i) {
+            const char *p = PATTERNS[i];
+
+            ok = same_entries(docset_find(plain, p),
+                              docset_find(cached, p), p)
+                 && same_entries(docset_find_ex(plain, p, DOCSET_COL_NAME),
+                                 docset_find_ex(cached, p, DOCSET_COL_NAME),
+                                 p)
+                 && same_entries(docset_find_typed(plain, p, &types),
+                                 docset_find_typed(cached, p, &types), p)
+                 && same_entries(docset_find_top(plain, p, 5),
+                                 docset_find_top(cached, p, 5), p)
+                 && counted(cached, round ? 4 : 0, round ? 0 : 4);
+        }
+    }
+    return ok;
+}
+
+/* Cached cursors can be rebound, they keep their type filter and stay
+ * valid when their results are evicted. */
+static int check_rebind(DocSet *plain, DocSet *cached)
+{
+    DocSetTypeMask types;
+    DocSetCursor *c;
+    size_t i;
+    int ok;
+
+    docset_type_mask_clear(&types);
+    docset_type_mask_add(&types, DOCSET_TYPE_FUNCTION);
+
+    c = docset_find_typed(cached, "nosuch", &types);
+    ok = c != NULL;
+    for (i = 0; ok && i < ARRAY_SIZE(PATTERNS); ++i) {
+        ok = docset_cursor_rebind(c, PATTERNS[i])
+             && same_entries(docset_find_typed(plain, PATTERNS[i], &types),
+                             c, PATTERNS[i])
+             && (c = docset_find_typed(cached, "nosuch", &types)) != NULL;
+    }
+    ok = ok && counted(cached, 1 + ARRAY_SIZE(PATTERNS) * 2, 0);
+
+    ok = ok && docset_cursor_rebind(c, "%Size%");
+    docset_set_type_weight(cached, DOCSET_TYPE_MACRO, 0);
+    ok = ok && same_entries(docset_find_typed(plain, "%Size%", &types),
+                            c, "%Size%");
+    return ok && counted(cached, 1, 0);
+}
+
+static int check_eviction(DocSet *docset)
+{
+    int ok;
+
+    /* The budget fits a single result of the pattern. */
+    ok = docset_set_result_cache(docset, 600) == DOCSET_OK;
+    docset_cursor_dispose(docset_find(docset, "printf"));
+    docset_cursor_dispose(docset_find(docset, "printf"));
+    ok = ok && counted(docset, 1, 1);
+
+    docset_cursor_dispose(docset_find(docset, "fprintf"));
+    docset_cursor_dispose(docset_find(docset, "printf"));
+    docset_cursor_dispose(docset_find(docset, "printf"));
+    ok = ok && counted(docset, 1, 2);
+
+    /* Results larger than the budget are not cached. */
+    docset_cursor_dispose(docset_find(docset, "%"));
+    docset_cursor_dispose(docset_find(docset, "%"));
+    docset_cursor_dispose(docset_find(docset, "printf"));
+    ok = ok && counted(docset, 1, 2);
+
+    docset_set_type_weight(docset, DOCSET_TYPE_MACRO, 1);
+    docset_cursor_dispose(docset_find(docset, "printf"));
+    ok = ok && counted(docset, 0, 1);
+
+    return ok && docset_set_result_cache(docset, 0) == DOCSET_OK;
+}
+
+static int check_kind(DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *plain = NULL;
+    DocSet *cached = NULL;
+    int ok;
+
+    if (!fixture_create(kind, 2000, dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 0;
+    }
+
+    ok = docset_try_open(&plain, dir) == DOCSET_OK
+         && docset_try_open(&cached, dir) == DOCSET_OK
+         && docset_set_result_cache(cached, 1 << 20) == DOCSET_OK;
+    if (!ok) {
+        fprintf(stderr, "Can't open %s fixture\n", docset_kind_name(kind));
+    }
+
+    docset_get_stats(cached, &stats);
+    ok = ok && check_queries(plain, cached) && check_rebind(plain, cached)
+         && check_eviction(cached);
+
+    docset_close(plain);
+    docset_close(cached);
+    fixture_remove(dir);
+    return ok;
+}
+
+int main()
+{
+    return !fixture_check_kinds(check_kind);
+}
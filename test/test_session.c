@@ -0,0 +1,107 @@
+#include "docset.h"
+#include "fixture.h"
+
+#include <stdio.h>
+
+/* Keystrokes of a user, a query is expected for the patterns marked
+ * as fresh. */
+static const struct {
+    const char *pattern;
+    int fresh;
+} KEYS[] = {
+    { "p%", 1 },
+    { "pr%", 0 },
+    { "PRI%", 1 },
+    { "PRIN%", 0 },
+    { "PRINt_%", 0 },
+    { "PRINt_%", 0 },
+    { "PRIN%", 1 },
+    { "%size%", 1 },
+    { "%size%t%", 0 },
+    { "%size%t", 0 },
+    { "%_iz%", 1 },
+    { "%_iz%::%", 0 },
+    { "printf", 1 },
+    { "printf", 0 },
+    { "nosuch%", 1 },
+    { "nosuch_%", 0 }
+};
+
+/* Compares with a plain search of the pattern, the cursor is
+ * disposed. */
+static int same_entries(DocSet *docset, DocSetCursor *actual,
+                        const char *pattern)
+{
+    return fixture_same_entries(docset_find(docset, pattern), actual,
+                                pattern, FIXTURE_SAME_DOCSET);
+}
+
+/* Cursors share the candidates, they outlive later searches and the
+ * session itself. */
+static int check_shared(DocSet *docset)
+{
+    DocSetSearchSession *session;
+    DocSetCursor *first, *refined;
+    int ok;
+
+    if (docset_session_create(&session, docset) != DOCSET_OK) {
+        return 0;
+    }
+    first = docset_session_find(session, "pr%");
+    refined = docset_session_find(session, "pri%");
+    docset_session_close(session);
+
+    ok = same_entries(docset, refined, "pri%");
+    return same_entries(docset, first, "pr%") && ok;
+}
+
+static int check_kind(DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    DocSet *docset;
+    DocSetSearchSession *session;
+    DocSetCursor *cursor;
+    DocSetStats stats;
+    unsigned long queries;
+    size_t i;
+    int ok = 1;
+
+    if (!fixture_create(kind, 3000, dir)) {
+        fprintf(stderr, "Can't create fixture\n");
+        return 0;
+    }
+    if (docset_try_open(&docset, dir) != DOCSET_OK
+        || docset_session_create(&session, docset) != DOCSET_OK) {
+        fprintf(stderr, "Can't open %s fixture\n", docset_kind_name(kind));
+        fixture_remove(dir);
+        return 0;
+    }
+
+    for (i = 0; ok && i < ARRAY_SIZE(KEYS); ++i) {
+        docset_get_stats(docset, &stats);
+        queries = stats.stmts_prepared + stats.stmts_reused;
+
+        cursor = docset_session_find(session, KEYS[i].pattern);
+        docset_get_stats(docset, &stats);
+        queries = stats.stmts_prepared + stats.stmts_reused - queries;
+        if ((queries != 0) != KEYS[i].fresh) {
+            fprintf(stderr, "%s: %s: unexpected %s\n",
+                    docset_kind_name(kind), KEYS[i].pattern,
+                    KEYS[i].fresh ? "refinement" : "query");
+            ok = 0;
+        }
+
+        ok = same_entries(docset, cursor, KEYS[i].pattern) && ok;
+    }
+
+    docset_session_close(session);
+    ok = ok && check_shared(docset);
+    docset_close(docset);
+    fixture_remove(dir);
+    return ok;
+}
+
+int main()
+{
+    return !fixture_check_kinds(check_kind);
+}
@@ -1,8 +1,22 @@
 #include "docset.h"
 #include <stdio.h>
 
+#define ALIAS(name, type) { name, type },
+
+static const struct {
+    const char *name;
+    DocSetEntryType type;
+} ALIASES[] = {
+    DOCSET_TYPE_ALIASES(ALIAS)
+};
+
+static const char *UNKNOWN[] = {
+    "", "function", "Functions", "Unknown", "clmx", "W", "Variable "
+};
+
 int main()
 {
+    size_t i;
     int t;
     DocSetEntryType etype, ftype;
     const char *name;
@@ -20,5 +34,19 @@ int main()
         }
     }
 
+    for (i = 0; i < sizeof(ALIASES) / sizeof(ALIASES[0]); ++i) {
+        if (docset_type_by_name(ALIASES[i].name) != ALIASES[i].type) {
+            fprintf(stderr, "Alias %s is not found\n", ALIASES[i].name);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < sizeof(UNKNOWN) / sizeof(UNKNOWN[0]); ++i) {
+        if (docset_type_by_name(UNKNOWN[i]) != DOCSET_TYPE_UNKNOWN) {
+            fprintf(stderr, "Unknown type %s is found\n", UNKNOWN[i]);
+            return 1;
+        }
+    }
+
     return 0;
 }
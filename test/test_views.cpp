@@ -0,0 +1,111 @@
+#include <docset.hpp>
+
+extern "C" {
+#include "fixture.h"
+}
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const char *const patterns[] = { "%", "printf", "%Size%", "nosuch" };
+
+bool same_entry(const docset::entry &expected, const docset::entry_view &v)
+{
+    return expected.id() == v.id()
+        && v.name() == expected.name()
+        && v.path() == expected.path()
+        && v.type_name() == expected.type_name()
+        && v.canonical_type() == expected.canonical_type()
+        && expected.docset_name() == v.docset_name();
+}
+
+// Views see the same entries as the iterator, entries assigned from
+// views are equal to the iterated ones.
+bool check_views(const docset::doc_set &ds, const char *pattern)
+{
+    std::vector<docset::entry> iterated;
+    docset::entry assigned;
+    std::size_t i = 0;
+
+    for (const docset::entry &e : ds.find(pattern)) {
+        iterated.push_back(e);
+    }
+
+    for (const docset::entry_view &v : ds.find(pattern).views()) {
+        bool ok = i < iterated.size()
+            && same_entry(iterated[i], v)
+            && same_entry(docset::entry(v), v)
+            && same_entry(assigned.assign(v), v)
+            && assigned == iterated[i];
+        if (!ok) {
+            std::fprintf(stderr, "%s: view %u differs\n",
+                         pattern, unsigned(i));
+            return false;
+        }
+        ++i;
+    }
+
+    if (i != iterated.size()) {
+        std::fprintf(stderr, "%s: expected %u views, got %u\n",
+                     pattern, unsigned(iterated.size()), unsigned(i));
+        return false;
+    }
+    return true;
+}
+
+// Columns that are not fetched are empty.
+bool check_columns(const docset::doc_set &ds)
+{
+    auto views = ds.find(std::string("%Size%"), ::DOCSET_COL_NAME).views();
+    auto it = views.begin();
+    unsigned n = 0;
+
+    for (; it != views.end(); ++it, ++n) {
+        if (it->name().empty() || !it->path().empty()
+            || !it->type_name().empty()) {
+            std::fprintf(stderr, "%s: unexpected columns\n",
+                         it->name().str().c_str());
+            return false;
+        }
+    }
+    return n > 0;
+}
+
+bool check_kind(::DocSetKind kind)
+{
+    char dir[FIXTURE_PATH_MAX];
+    bool ok = true;
+
+    if (!fixture_create(kind, 2000, dir)) {
+        std::fprintf(stderr, "Can't create fixture\n");
+        return false;
+    }
+
+    try {
+        docset::doc_set ds(dir);
+
+        for (const char *pattern : patterns) {
+            ok = ok && check_views(ds, pattern);
+        }
+        ok = ok && check_columns(ds);
+    } catch (const docset::error &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        ok = false;
+    }
+
+    fixture_remove(dir);
+    return ok;
+}
+
+}
+
+int main()
+{
+    return !::fixture_check_kinds([](::DocSetKind kind) -> int {
+        return check_kind(kind);
+    });
+}